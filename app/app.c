@@ -1,24 +1,162 @@
+#include <pthread.h>
 #include <sgx_defs.h>
 #include <sgx_eid.h>
 #include <sgx_error.h>
 #include <sgx_urts.h>
+#include <stddef.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "./challenge/challenges.h"
 #include "./error.h"
+#include "./loader.h"
+#include "./parallel.h"
+#include "./stats.h"
+#include "./writer.h"
+#include "app_config.h"
 #include "defines.h"
 #include "enclave_u.h"
 
 /**
- * OCALL called by the enclave to print some text to the terminal.
+ * OCALL called by the enclave to print some text to the terminal. The text is copied and written by the writer
+ * thread, so the enclave doesn't wait for the terminal.
  **/
 void ocall_print_string(const char *NULLABLE str) {
     /* Proxy/Bridge will check the length and null-terminate
      * the input string to prevent buffer overflow.
      */
-    printf("%s", likely(str != NULL) ? str : "<null>");
+    const char *NONNULL text = likely(str != NULL) ? str : "<null>";
+    writer_write(text, strlen(text));
+}
+
+/**
+ * Benchmark OCALL, not used by the challenges.
+ **/
+void ocall_bench_noop(void) {}
+
+/** A challenge solution. */
+typedef sgx_status_t challenge_fn(sgx_enclave_id_t eid);
+
+/** All challenges, in report order. */
+static challenge_fn *NONNULL const CHALLENGES[] = {
+    challenge_1, /* Call the enclave */
+    challenge_2, /* Crack the password */
+    challenge_3, /* Secret Sequence */
+    challenge_4, /* Secret Polynomial */
+    challenge_5, /* Rock, Paper, Scissors */
+};
+/** Number of challenges. */
+static constexpr size_t N_CHALLENGES = sizeof(CHALLENGES) / sizeof(CHALLENGES[0]);
+
+/** Order in which the challenges are started, slowest first, so the others run while it's still going. */
+static constexpr size_t DISPATCH_ORDER[N_CHALLENGES] = {4, 1, 2, 3, 0};
+
+/**
+ * Challenges shared between the runner threads.
+ */
+typedef struct runner {
+    /** Position in `DISPATCH_ORDER` of the next challenge to start. */
+    size_t next;
+    /** Result of each challenge, in report order. */
+    sgx_status_t status[N_CHALLENGES];
+    /** Output of each challenge, held until the previous ones are written. `NULL` once written, or if out of memory. */
+    writer_capture_t *NULLABLE output[N_CHALLENGES];
+    /** Challenges that already finished. */
+    bool finished[N_CHALLENGES];
+    /** Challenges whose output was written, always a prefix of the report order. */
+    size_t written;
+    /** Protects `finished` and `written`. */
+    pthread_mutex_t lock;
+} runner_t;
+
+[[gnu::nonnull(1)]]
+/**
+ * Mark `challenge` as finished, and write the output of all finished challenges that are next in report order.
+ */
+static void runner_finish(runner_t *NONNULL runner, const size_t challenge) {
+    (void) pthread_mutex_lock(&(runner->lock));
+    runner->finished[challenge] = true;
+    while (runner->written < N_CHALLENGES && runner->finished[runner->written]) {
+        writer_capture_release(runner->output[runner->written]);
+        runner->output[runner->written] = NULL;
+        runner->written++;
+    }
+    (void) pthread_mutex_unlock(&(runner->lock));
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(2)]]
+/**
+ * Runner thread: take the next challenge until all of them were started. Results are written to the runner.
+ */
+static sgx_status_t runner_task(
+    const sgx_enclave_id_t eid,
+    void *NONNULL context,
+    const size_t index,
+    const size_t threads
+) {
+    (void) index;
+    (void) threads;
+    runner_t *NONNULL runner = (runner_t *) context;
+
+    while (true) {
+        const size_t position = __atomic_fetch_add(&(runner->next), 1, __ATOMIC_RELAXED);
+        if (position >= N_CHALLENGES) {
+            return SGX_SUCCESS;
+        }
+
+        const size_t challenge = DISPATCH_ORDER[position];
+        writer_capture_set(runner->output[challenge]);
+        runner->status[challenge] = STATS_CHALLENGE(challenge + 1, CHALLENGES[challenge](eid));
+        writer_capture_set(NULL);
+        runner_finish(runner, challenge);
+    }
+}
+
+[[nodiscard("error must be checked")]]
+/**
+ * Run all challenges concurrently, on `APP_THREADS` threads, then report the errors in challenge order. The output of
+ * each challenge, including the enclave banners, is held until the challenges before it are done, so it's also written
+ * in challenge order.
+ *
+ * @return `true` if all challenges succeeded.
+ */
+static bool run_challenges(const sgx_enclave_id_t eid) {
+    runner_t runner = {
+        .next = 0,
+        .status = {},
+        .output = {},
+        .finished = {},
+        .written = 0,
+        .lock = PTHREAD_MUTEX_INITIALIZER,
+    };
+    for (size_t i = 0; i < N_CHALLENGES; i++) {
+        runner.status[i] = SGX_ERROR_UNEXPECTED;
+        runner.output[i] = writer_capture_new();
+    }
+
+    const size_t threads = likely(APP_THREADS < N_CHALLENGES) ? APP_THREADS : N_CHALLENGES;
+    const sgx_status_t status = parallel_run(eid, threads, runner_task, &runner);
+    // challenges that never ran
+    for (size_t i = runner.written; i < N_CHALLENGES; i++) {
+        writer_capture_release(runner.output[i]);
+    }
+    (void) pthread_mutex_destroy(&(runner.lock));
+    if unlikely (status != SGX_SUCCESS) {
+        print_error_message(status);
+        return false;
+    }
+
+    bool ok = true;
+    for (size_t i = 0; i < N_CHALLENGES; i++) {
+        if unlikely (runner.status[i] != SGX_SUCCESS) {
+            writer_printf("Challenge %zu failed:\n", i + 1);
+            print_error_message(runner.status[i]);
+            ok = false;
+        }
+    }
+    return ok;
 }
 
 /* Application entry */
@@ -33,61 +171,37 @@ int SGX_CDECL main(const int argc, const char *restrict NONNULL argv[NONNULL arg
         return EXIT_FAILURE;
     }
 
+    /* Output is written by a separate thread, flushed on exit */
+    const bool async = writer_start();
+    if unlikely (!async) {
+        (void) fprintf(stderr, "Warning: failed to start the writer thread, output is synchronous\n");
+    }
+    /* ECALL statistics, reported at exit when enabled */
+    const bool stats = stats_start();
+    if unlikely (!stats) {
+        (void) fprintf(stderr, "Warning: failed to register the ECALL statistics report\n");
+    }
+
     /* Global EID shared by multiple threads */
     sgx_enclave_id_t global_eid = (sgx_enclave_id_t) -1;
 
     /* Initialize the enclave */
-    /* Debug Support: set 2nd parameter to 1 */
-    sgx_status_t status = sgx_create_enclave(enclave, SGX_DEBUG_FLAG, NULL, NULL, &global_eid, NULL);
+    sgx_status_t status = load_enclave(enclave, &global_eid);
     if unlikely (status != SGX_SUCCESS) {
         print_error_message(status);
         return EXIT_FAILURE;
     }
 
-    bool ok = true;
-
-    /* CHALLENGE 1: Call the enclave */
-    status = challenge_1(global_eid);
-    if unlikely (status != SGX_SUCCESS) {
-        print_error_message(status);
-        ok = false;
-    }
-
-    /* CHALLENGE 2: Crack the password */
-    status = challenge_2(global_eid);
-    if unlikely (status != SGX_SUCCESS) {
-        print_error_message(status);
-        ok = false;
-    }
-
-    /* CHALLENGE 3: Secret Sequence */
-    status = challenge_3(global_eid);
-    if unlikely (status != SGX_SUCCESS) {
-        print_error_message(status);
-        ok = false;
-    }
-
-    /* CHALLENGE 4: Secret Polynomial */
-    status = challenge_4(global_eid);
-    if unlikely (status != SGX_SUCCESS) {
-        print_error_message(status);
-        ok = false;
-    }
-
-    /* CHALLENGE 5: Rock, Paper, Scissors */
-    status = challenge_5(global_eid);
-    if unlikely (status != SGX_SUCCESS) {
-        print_error_message(status);
-        ok = false;
-    }
+    const bool ok = run_challenges(global_eid);
+    stats_enclave(global_eid);
 
     /* Destroy the enclave */
-    status = sgx_destroy_enclave(global_eid);
+    status = STATS_CALL(sgx_destroy_enclave, global_eid);
     if unlikely (status != SGX_SUCCESS) {
         print_error_message(status);
         return EXIT_FAILURE;
     }
 
-    printf("Info: Enclave successfully returned.\n");
+    writer_printf("Info: Enclave successfully returned.\n");
     return likely(ok) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
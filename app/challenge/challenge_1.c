@@ -2,6 +2,9 @@
 #include <sgx_error.h>
 #include <stdio.h>
 
+#include "../parallel.h"
+#include "../stats.h"
+#include "../writer.h"
 #include "./challenges.h"
 #include "defines.h"
 #include "enclave_u.h"
@@ -16,17 +19,17 @@ sgx_status_t challenge_1(sgx_enclave_id_t eid) {
     const char name[] = "Tiago De Paula Alves";
 
 #ifdef DEBUG
-    printf("Challenge 1: name = '%s'\n", name);
+    writer_printf("Challenge 1: name = '%s'\n", name);
 #endif
 
     int rv = -1;
-    const sgx_status_t status = ecall_verificar_aluno(eid, &rv, name);
+    const sgx_status_t status = ECALL_RETRY(STATS_CALL(ecall_verificar_aluno, eid, &rv, name));
     if unlikely (status != SGX_SUCCESS) {
         return status;
     }
 
     if unlikely (rv != 0) {
-        printf("Challenge 1: Valid name not found\n");
+        writer_printf("Challenge 1: Valid name not found\n");
         return SGX_ERROR_UNEXPECTED;
     }
 
@@ -1,37 +1,166 @@
 #include <sgx_eid.h>
 #include <sgx_error.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
+#include "../parallel.h"
+#include "../search.h"
+#include "../stats.h"
+#include "../writer.h"
 #include "./challenges.h"
+#include "app_config.h"
 #include "defines.h"
 #include "enclave_u.h"
 
+/** Smallest possible password. */
+static constexpr unsigned MIN_PASSWORD = 0;
+/** Largest possible password. */
+static constexpr unsigned MAX_PASSWORD = 99'999;
+
+static_assert(0 < PASSWORD_BATCH && PASSWORD_BATCH <= MAX_PASSWORD - MIN_PASSWORD + 1);
+static_assert(APP_THREADS > 0);
+
+/** Oracle result of a wrong password. */
+static constexpr uint32_t WRONG = 1;
+
+[[nodiscard("error must be checked"), gnu::nonnull(3, 5, 6, 7)]]
 /**
- * Challenge 2: Crack the password
- * -------------------------------
- *
- * Brute force all possible passwords, from `0` to `99_999`, and find the correct one. Up to 100 thousand
- * calls to `ecall_verificar_senha` are required.
+ * Check `count` passwords with one call to `ecall_verificar_senha` each. Used for enclaves without
+ * `ecall_verificar_senhas`.
  */
-sgx_status_t challenge_2(sgx_enclave_id_t eid) {
-    static constexpr unsigned MIN_PASSWORD = 0;
-    static constexpr unsigned MAX_PASSWORD = 99'999;
-
-    for (unsigned password = MIN_PASSWORD; password <= MAX_PASSWORD; password++) {
+static sgx_status_t check_single(
+    const sgx_enclave_id_t eid,
+    const unsigned passwords[NONNULL],
+    const size_t count,
+    uint32_t results[NONNULL],
+    size_t *NONNULL accepted,
+    const bool *NONNULL stop
+) {
+    for (size_t i = 0; i < count && !__atomic_load_n(stop, __ATOMIC_ACQUIRE); i++) {
         int rv = -1;
-        const sgx_status_t status = ecall_verificar_senha(eid, &rv, password);
+        const sgx_status_t status = ECALL_RETRY(STATS_CALL(ecall_verificar_senha, eid, &rv, passwords[i]));
         if unlikely (status != SGX_SUCCESS) {
             return status;
         }
 
         if (rv == 0) {
-#ifdef DEBUG
-            printf("Challenge 2: password = %u\n", password);
-#endif
-            return SGX_SUCCESS;
+            *accepted = i;
+            break;
         }
+        results[i] = WRONG;
+    }
+    return SGX_SUCCESS;
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(2, 3, 5, 6, 7)]]
+/**
+ * Password oracle: check all `candidates` with a single `ecall_verificar_senhas`. The first query without it clears
+ * `context`, a `bool`, and all queries then make one `ecall_verificar_senha` per password.
+ */
+static sgx_status_t query_passwords(
+    const sgx_enclave_id_t eid,
+    void *NONNULL context,
+    const void *NONNULL candidates,
+    const size_t count,
+    uint32_t results[NONNULL],
+    size_t *NONNULL accepted,
+    const bool *NONNULL stop
+) {
+    bool *NONNULL batched = (bool *) context;
+    const unsigned *NONNULL passwords = (const unsigned *) candidates;
+
+    if unlikely (!__atomic_load_n(batched, __ATOMIC_RELAXED)) {
+        return check_single(eid, passwords, count, results, accepted, stop);
+    }
+
+    int rv = -1;
+    const sgx_status_t status = ECALL_RETRY(STATS_CALL(ecall_verificar_senhas, eid, &rv, passwords, count));
+    if unlikely (status == SGX_ERROR_INVALID_FUNCTION) {
+        __atomic_store_n(batched, false, __ATOMIC_RELAXED);
+        return check_single(eid, passwords, count, results, accepted, stop);
+    } else if unlikely (status != SGX_SUCCESS) {
+        return status;
+    }
+
+    if (rv >= 0 && (size_t) rv < count) {
+        *accepted = (size_t) rv;
+    } else if unlikely (rv != -1) {
+        writer_printf("Challenge 2: Failed to verify passwords\n");
+        return SGX_ERROR_UNEXPECTED;
+    }
+    for (size_t i = 0; i < count; i++) {
+        results[i] = WRONG;
+    }
+    return SGX_SUCCESS;
+}
+
+[[gnu::nonnull(2)]]
+/**
+ * Candidate `index` is the password `MIN_PASSWORD + index`.
+ */
+static void generate_password(const void *NULLABLE context, const size_t index, void *NONNULL candidate) {
+    (void) context;
+    const unsigned password = MIN_PASSWORD + (unsigned) index;
+    memcpy(candidate, &password, sizeof(unsigned));
+}
+
+/**
+ * Challenge 2: Crack the password, with `threads` concurrent threads
+ * ------------------------------------------------------------------
+ *
+ * Brute force all possible passwords, from `0` to `99_999`, and find the correct one. Passwords are split in work
+ * units of `PASSWORD_BATCH`, each checked with a single `ecall_verificar_senhas`, so only `100_000 / PASSWORD_BATCH`
+ * enclave transitions are needed. The search engine hands the units to the threads in order, and all of them stop
+ * once the password is found.
+ *
+ * If the enclave doesn't support batches, each unit makes one `ecall_verificar_senha` per password.
+ */
+sgx_status_t challenge_2_threads(const sgx_enclave_id_t eid, const size_t threads) {
+    bool batched = true;
+    const search_oracle_t oracle = {
+        .name = "passwords",
+        .query = query_passwords,
+        .context = &batched,
+        .candidate_size = sizeof(unsigned),
+        .batch = PASSWORD_BATCH,
+        .threads = threads,
+        .query_ns = 20'000,
+        .candidate_ns = 100,
+        .thread_safe = true,
+        .memoize = false,
+    };
+
+    search_t *NULLABLE search = search_new(&oracle);
+    if unlikely (search == NULL) {
+        return SGX_ERROR_OUT_OF_MEMORY;
+    }
+
+    static constexpr size_t PASSWORDS = MAX_PASSWORD - MIN_PASSWORD + 1;
+    size_t found = PASSWORDS;
+    const sgx_status_t status = search_run(search, eid, generate_password, NULL, PASSWORDS, NULL, &found);
+    search_free(search);
+    if unlikely (status != SGX_SUCCESS) {
+        return status;
     }
 
-    printf("Challenge 2: Password not found\n");
-    return SGX_ERROR_UNEXPECTED;
+    if unlikely (found >= PASSWORDS) {
+        writer_printf("Challenge 2: Password not found\n");
+        return SGX_ERROR_UNEXPECTED;
+    }
+#ifdef DEBUG
+    writer_printf("Challenge 2: password = %u\n", MIN_PASSWORD + (unsigned) found);
+#endif
+    return SGX_SUCCESS;
+}
+
+/**
+ * Challenge 2: Crack the password
+ * -------------------------------
+ *
+ * Search the password with `APP_THREADS` threads, see `challenge_2_threads`.
+ */
+sgx_status_t challenge_2(sgx_enclave_id_t eid) {
+    return challenge_2_threads(eid, APP_THREADS);
 }
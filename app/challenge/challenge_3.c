@@ -3,9 +3,14 @@
 #include <sgx_eid.h>
 #include <sgx_error.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 
+#include "../parallel.h"
+#include "../search.h"
+#include "../stats.h"
+#include "../writer.h"
 #include "./challenges.h"
 #include "defines.h"
 #include "enclave_u.h"
@@ -13,6 +18,11 @@
 /** Number of characters for the secret word. */
 static constexpr size_t WORD_LEN = 20;
 
+/** Possible letters in the secret word. */
+static constexpr char LETTERS[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+/** Number of possible letters. */
+static constexpr size_t N_LETTERS = sizeof(LETTERS) - 1;
+
 /**
  * A contender for the secret word, not NUL-terminated.
  */
@@ -36,53 +46,269 @@ static word_t make_word(char letter) {
 
 [[gnu::const, nodiscard("pure function"), gnu::hot]]
 /**
- * Replace `secret` with the given `letter` in all positions modified in `guess`, returning the updated `secret`.
+ * Replace `secret` with the given `letter` in all positions missing from `mask`, returning the updated `secret`.
  */
-static word_t update_secret(word_t secret, const word_t guess, const char letter) {
+static word_t update_secret(word_t secret, const uint32_t mask, const char letter) {
     for (size_t i = 0; i < WORD_LEN; i++) {
-        if unlikely (guess.data[i] != secret.data[i]) {
+        if unlikely ((mask & (UINT32_C(1) << i)) == 0) {
             secret.data[i] = letter;
         }
     }
     return secret;
 }
 
+static_assert(WORD_LEN <= 32, "position masks must fit in 32 bits");
+static_assert(sizeof(word_t) == sizeof(palavra_t));
+
+[[nodiscard("error must be checked"), gnu::nonnull(3, 5, 6, 7)]]
+/**
+ * Single word oracle: check each candidate with `ecall_palavra_secreta`. The result is the mask of positions the
+ * enclave kept, i.e. the correct ones.
+ */
+static sgx_status_t query_word(
+    const sgx_enclave_id_t eid,
+    void *NULLABLE context,
+    const void *NONNULL candidates,
+    const size_t count,
+    uint32_t results[NONNULL],
+    size_t *NONNULL accepted,
+    const bool *NONNULL stop
+) {
+    (void) context;
+    (void) stop;
+    const word_t *NONNULL words = (const word_t *) candidates;
+
+    for (size_t i = 0; i < count; i++) {
+        word_t guess = words[i];
+
+        int rv = -1;
+        const sgx_status_t status = ECALL_RETRY(STATS_CALL(ecall_palavra_secreta, eid, &rv, guess.data));
+        if unlikely (status != SGX_SUCCESS) {
+            return status;
+        }
+
+        if (rv == 0) {
+            *accepted = i;
+            break;
+        }
+
+        results[i] = 0;
+        for (size_t j = 0; j < WORD_LEN; j++) {
+            if (guess.data[j] == words[i].data[j]) {
+                results[i] |= UINT32_C(1) << j;
+            }
+        }
+    }
+    return SGX_SUCCESS;
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(3, 5, 6, 7)]]
+/**
+ * Batched word oracle: check all candidates with a single `ecall_palavras_secretas`, which returns the mask of
+ * correct positions for each word.
+ */
+static sgx_status_t query_words(
+    const sgx_enclave_id_t eid,
+    void *NULLABLE context,
+    const void *NONNULL candidates,
+    const size_t count,
+    uint32_t results[NONNULL],
+    size_t *NONNULL accepted,
+    const bool *NONNULL stop
+) {
+    (void) context;
+    (void) stop;
+    const palavra_t *NONNULL probes = (const palavra_t *) candidates;
+
+    int rv = -1;
+    const sgx_status_t status = ECALL_RETRY(STATS_CALL(ecall_palavras_secretas, eid, &rv, probes, results, count));
+    if unlikely (status != SGX_SUCCESS) {
+        return status;
+    }
+
+    if unlikely (rv < -1 || rv >= (int) count) {
+        writer_printf("Challenge 3: Failed to probe letters\n");
+        return SGX_ERROR_UNEXPECTED;
+    } else if unlikely (rv >= 0) {
+        // a single letter word, already confirmed by the enclave
+        *accepted = (size_t) rv;
+    }
+    return SGX_SUCCESS;
+}
+
+/** Single word oracle, one word at a time. */
+static const search_oracle_t WORD_ORACLE = {
+    .name = "ecall_palavra_secreta",
+    .query = query_word,
+    .context = NULL,
+    .candidate_size = sizeof(word_t),
+    .batch = 1,
+    .threads = 1,
+    .query_ns = 20'000,
+    .candidate_ns = 0,
+    .thread_safe = false,
+    .memoize = false,
+};
+
+/** Batched word oracle, all letters at once. */
+static const search_oracle_t WORDS_ORACLE = {
+    .name = "ecall_palavras_secretas",
+    .query = query_words,
+    .context = NULL,
+    .candidate_size = sizeof(palavra_t),
+    .batch = N_LETTERS,
+    .threads = 1,
+    .query_ns = 20'000,
+    .candidate_ns = 100,
+    .thread_safe = false,
+    .memoize = false,
+};
+
+[[gnu::nonnull(1, 3)]]
+/**
+ * The only candidate is the word in `context`.
+ */
+static void generate_word(const void *NONNULL context, const size_t index, void *NONNULL candidate) {
+    assume(index == 0);
+    memcpy(candidate, context, sizeof(word_t));
+}
+
+[[gnu::nonnull(3)]]
+/**
+ * Candidate `index` repeats the `index`-th letter in all positions.
+ */
+static void generate_letter(const void *NULLABLE context, const size_t index, void *NONNULL candidate) {
+    (void) context;
+    assume(index < N_LETTERS);
+    const word_t word = make_word(LETTERS[index]);
+    memcpy(candidate, &word, sizeof(word_t));
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(1, 3, 4)]]
+/**
+ * Check `guess` with a single word query. The mask of its correct positions is written to `mask`, and `solved` is
+ * set if it is the secret.
+ */
+static sgx_status_t check_word(
+    search_t *NONNULL search,
+    const sgx_enclave_id_t eid,
+    const word_t *NONNULL guess,
+    uint32_t *NONNULL mask,
+    bool *NONNULL solved
+) {
+    size_t accepted = 1;
+    const sgx_status_t status = search_run(search, eid, generate_word, guess, 1, mask, &accepted);
+    *solved = accepted == 0;
+    return status;
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(1)]]
 /**
- * Challenge 3: Secret Sequence
- * ----------------------------
- *
  * Test all valid letters in each position, until the correct letter is found. This is similar to brute-force,
  * except that each position is tested independently, allowing for per letter "parallelism". In total, only 26
  * calls to `ecall_palavra_secreta` or less are required.
  */
-sgx_status_t challenge_3(sgx_enclave_id_t eid) {
-    constexpr char LETTERS[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
-    const size_t N_LETTERS = strlen(LETTERS);
-
+static sgx_status_t challenge_3_single(search_t *NONNULL search, const sgx_enclave_id_t eid) {
     word_t secret = make_word(LETTERS[0]);
 
     for (size_t i = 0; i < N_LETTERS; i++) {
         word_t guess = secret;
 
-        int rv = -1;
-        const sgx_status_t status = ecall_palavra_secreta(eid, &rv, guess.data);
+        uint32_t mask = 0;
+        bool solved = false;
+        const sgx_status_t status = check_word(search, eid, &guess, &mask, &solved);
         if unlikely (status != SGX_SUCCESS) {
             return status;
         }
 
-        if (rv == 0) {
+        if (solved) {
 #ifdef DEBUG
             static_assert(WORD_LEN <= INT_MAX);
-            printf("Challenge 3: secret = %.*s\n", (int) WORD_LEN, guess.data);
+            writer_printf("Challenge 3: secret = %.*s\n", (int) WORD_LEN, guess.data);
 #endif
             return SGX_SUCCESS;
         }
 
         if likely (i + 1 < N_LETTERS) {
-            secret = update_secret(secret, guess, LETTERS[i + 1]);
+            secret = update_secret(secret, mask, LETTERS[i + 1]);
         }
     }
 
-    printf("Challenge 3: Secret not found\n");
+    writer_printf("Challenge 3: Secret not found\n");
     return SGX_ERROR_UNEXPECTED;
 }
+
+[[nodiscard("error must be checked"), gnu::nonnull(1)]]
+/**
+ * Probe all letters with the batched oracle and confirm the secret with the single one.
+ *
+ * Returns `SGX_ERROR_INVALID_FUNCTION` if the enclave doesn't support batches.
+ */
+static sgx_status_t challenge_3_batch(search_t *NONNULL search, const sgx_enclave_id_t eid) {
+    search_t *NULLABLE probes = search_new(&WORDS_ORACLE);
+    if unlikely (probes == NULL) {
+        return SGX_ERROR_OUT_OF_MEMORY;
+    }
+
+    uint32_t masks[N_LETTERS] = {};
+    size_t accepted = N_LETTERS;
+    sgx_status_t status = search_run(probes, eid, generate_letter, NULL, N_LETTERS, masks, &accepted);
+    search_free(probes);
+    if unlikely (status != SGX_SUCCESS) {
+        return status;
+    } else if unlikely (accepted < N_LETTERS) {
+        return SGX_SUCCESS;
+    }
+
+    word_t secret = make_word('\0');
+    for (size_t i = 0; i < N_LETTERS; i++) {
+        for (size_t j = 0; j < WORD_LEN; j++) {
+            if (masks[i] & (UINT32_C(1) << j)) {
+                secret.data[j] = LETTERS[i];
+            }
+        }
+    }
+
+    // show the banner, which only `ecall_palavra_secreta` does for a partial probe
+    uint32_t mask = 0;
+    bool solved = false;
+    status = check_word(search, eid, &secret, &mask, &solved);
+    if unlikely (status != SGX_SUCCESS) {
+        return status;
+    }
+
+    if likely (solved) {
+#ifdef DEBUG
+        static_assert(WORD_LEN <= INT_MAX);
+        writer_printf("Challenge 3: secret = %.*s\n", (int) WORD_LEN, secret.data);
+#endif
+        return SGX_SUCCESS;
+    }
+
+    writer_printf("Challenge 3: Secret not found\n");
+    return SGX_ERROR_UNEXPECTED;
+}
+
+/**
+ * Challenge 3: Secret Sequence
+ * ----------------------------
+ *
+ * Probe words made of a single letter, for all 26 letters, in a single call to `ecall_palavras_secretas`. The
+ * returned masks show where each letter is right, so the secret is then confirmed with one `ecall_palavra_secreta`.
+ * Falls back to one `ecall_palavra_secreta` per letter if the enclave doesn't support batches. Both go through the
+ * search engine, as two oracles.
+ */
+sgx_status_t challenge_3(sgx_enclave_id_t eid) {
+    search_t *NULLABLE search = search_new(&WORD_ORACLE);
+    if unlikely (search == NULL) {
+        return SGX_ERROR_OUT_OF_MEMORY;
+    }
+
+    sgx_status_t status = challenge_3_batch(search, eid);
+    if unlikely (status == SGX_ERROR_INVALID_FUNCTION) {
+        status = challenge_3_single(search, eid);
+    }
+
+    search_free(search);
+    return status;
+}
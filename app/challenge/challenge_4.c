@@ -5,89 +5,16 @@
 #include <stdint.h>
 #include <stdio.h>
 
+#include "../field.h"
+#include "../parallel.h"
+#include "../stats.h"
+#include "../writer.h"
 #include "./challenges.h"
 #include "defines.h"
 #include "enclave_u.h"
 
 /**
- * The prime base of the polynomial, used for modular arithmetic.
- *
- * @see https://en.wikipedia.org/wiki/2,147,483,647
- */
-static constexpr const uint32_t P = 2'147'483'647;
-// we assume multiplication P doesn't overflow uint64_t
-static_assert(P <= INT32_MAX);
-
-[[gnu::const, nodiscard("pure function")]]
-/**
- * Convert integer to range [0, P).
- */
-static uint32_t toP(const int n) {
-    static constexpr int64_t Pi = (int64_t) P;
-    const int64_t nn = (int64_t) n;
-    return ((uint32_t) (nn % Pi + Pi)) % P;
-}
-
-[[gnu::const, nodiscard("pure function")]]
-/**
- * Converts a value from the modular field [0, P) to its smallest signed integer representation.
- */
-static int fromP(const uint32_t n) {
-    if likely (n <= P / 2) {
-        return (int) n;
-    }
-    return ((int) (n % P)) - ((int) P);
-}
-
-[[gnu::const, nodiscard("pure function"), gnu::hot]]
-/**
- * Does `(a + b) % P` without overflowing or underflowing.
- */
-static uint32_t addP(const uint32_t a, const uint32_t b) {
-    const uint64_t aa = (uint64_t) a;
-    const uint64_t bb = (uint64_t) b;
-    return (uint32_t) ((aa + bb) % P);
-}
-
-[[gnu::const, nodiscard("pure function"), gnu::hot]]
-/**
- * Does `(a - b) % P` without overflowing or underflowing.
- */
-static uint32_t subP(const uint32_t a, const uint32_t b) {
-    const uint64_t aa = (uint64_t) a;
-    const uint64_t bb = (uint64_t) b % P;
-    return (uint32_t) ((aa + P - bb) % P);
-}
-
-[[gnu::const, nodiscard("pure function"), gnu::hot]]
-/**
- * Does `(a * b) % P` without overflowing or underflowing.
- */
-static uint32_t mulP(const uint32_t a, const uint32_t b) {
-    const uint64_t aa = (uint64_t) a;
-    const uint64_t bb = (uint64_t) b;
-    return (uint32_t) ((aa * bb) % P);
-}
-
-[[gnu::const, nodiscard("pure function")]]
-/**
- * Fast modular exponentiation `(a ** n) % P`.
- */
-static uint32_t expP(const uint32_t a, uint32_t n) {
-    uint32_t base = a;
-    uint32_t result = 1;
-    while (n > 0) {
-        if likely (n % 2 != 0) {
-            result = mulP(result, base);
-        }
-        base = mulP(base, base);
-        n /= 2;
-    }
-    return result;
-}
-
-/**
- * Polynomial coeffiecients for `(a * x**2 + b * x + c) % p`.
+ * Polynomial coeffiecients for `(a * x**2 + b * x + c) % p`, as signed integers.
  */
 struct coefficients {
     /** First coefficient, order 2. */
@@ -98,67 +25,50 @@ struct coefficients {
     int c;
 };
 
-[[gnu::const, nodiscard("pure function")]]
-/*
- * Quadratic interpolation in F_p
- *
- * We have three distinct points `(x1,y1)`, `(x2,y2)`, `(x3,y3)` in the prime field `F_p` with `p = 2_147_483_647`.
- * They must be distinct mod p or `D` collapses to 0 and the system is singular.
- *
- * The parabola y ≡ a·x² + b·x + c (mod p) is unique, so we solve the 3×3 Vandermonde system with Cramer's rule,
- * still mod p:
- *
- *     D  = (x1-x2)(x1-x3)(x2-x3)                         // determinant
- *     D⁻¹ = D^(p-2) mod p                               // Fermat inverse
- *
- *     Na =  x1(y3-y2) + x2(y1-y3) + x3(y2-y1)
- *     Nb =  x1²(y2-y3) + x2²(y3-y1) + x3²(y1-y2)
- *     Nc =  x1²(x2y3-x3y2) + x2²(x3y1-x1y3) + x3²(x1y2-x2y1)
- *
- *     a ≡ Na · D⁻¹  (mod p)
- *     b ≡ Nb · D⁻¹  (mod p)
- *     c ≡ Nc · D⁻¹  (mod p)
+[[gnu::pure, nodiscard("pure function"), gnu::nonnull(1, 2)]]
+/**
+ * Quadratic interpolation in F_p of the points `(x[i], y[i])`, see `fp_interpolate`. The `x` must be distinct mod p.
  *
- * Returned coefficients are canonicalised to signed ints via `fromP()`.
+ * Returned coefficients are canonicalised to signed ints via `fp_to_int()`.
  */
-static struct coefficients solve_polynomial_coefficients(
-    const uint32_t x1,
-    const uint32_t y1,
-    const uint32_t x2,
-    const uint32_t y2,
-    const uint32_t x3,
-    const uint32_t y3
-) {
+static struct coefficients solve_polynomial_coefficients(const int x[NONNULL 3], const int y[NONNULL 3]) {
     // points must be distinct
-    assume(x1 != x2);
-    assume(x2 != x3);
-    assume(x3 != x1);
-
-    const uint32_t D = mulP(mulP(subP(x1, x2), subP(x1, x3)), subP(x2, x3));
-    const uint32_t iD = expP(D, P - 2);
-
-    // first coefficient
-    const uint32_t Na = addP(addP(mulP(x1, subP(y3, y2)), mulP(x2, subP(y1, y3))), mulP(x3, subP(y2, y1)));
-    const uint32_t a = mulP(Na, iD);
-
-    // second coefficient
-    uint32_t Nb = addP(
-        addP(mulP(mulP(x1, x1), subP(y2, y3)), mulP(mulP(x2, x2), subP(y3, y1))),
-        mulP(mulP(x3, x3), subP(y1, y2))
+    assume(x[0] != x[1]);
+    assume(x[1] != x[2]);
+    assume(x[2] != x[0]);
+
+    const fp_quadratic_t poly = fp_interpolate(
+        fp_from_int(x[0]),
+        fp_from_int(y[0]),
+        fp_from_int(x[1]),
+        fp_from_int(y[1]),
+        fp_from_int(x[2]),
+        fp_from_int(y[2])
     );
-    uint32_t b = mulP(Nb, iD);
+    return (struct coefficients) {.a = fp_to_int(poly.a), .b = fp_to_int(poly.b), .c = fp_to_int(poly.c)};
+}
 
-    // last coefficient
-    uint32_t Nc = addP(
-        addP(
-            mulP(mulP(x1, x1), subP(mulP(x2, y3), mulP(x3, y2))),
-            mulP(mulP(x2, x2), subP(mulP(x3, y1), mulP(x1, y3)))
-        ),
-        mulP(mulP(x3, x3), subP(mulP(x1, y2), mulP(x2, y1)))
-    );
-    uint32_t c = mulP(Nc, iD);
+[[nodiscard("error must be checked"), gnu::nonnull(2, 3)]]
+/**
+ * Evaluate the polynomial on `n` points, using a single `ecall_polinomio_secreto_lote` when available.
+ */
+static sgx_status_t evaluate_points(sgx_enclave_id_t eid, const int *NONNULL x, int *NONNULL y, const size_t n) {
+    int rv = -1;
+    const sgx_status_t status = ECALL_RETRY(STATS_CALL(ecall_polinomio_secreto_lote, eid, &rv, x, y, n));
+    if likely (status == SGX_SUCCESS) {
+        return likely(rv == 0) ? SGX_SUCCESS : SGX_ERROR_UNEXPECTED;
+    } else if unlikely (status != SGX_ERROR_INVALID_FUNCTION) {
+        return status;
+    }
 
-    return (struct coefficients) {.a = fromP(a), .b = fromP(b), .c = fromP(c)};
+    // enclave without the batched ECALL
+    for (size_t i = 0; i < n; i++) {
+        const sgx_status_t single_status = ECALL_RETRY(STATS_CALL(ecall_polinomio_secreto, eid, &(y[i]), x[i]));
+        if unlikely (single_status != SGX_SUCCESS) {
+            return single_status;
+        }
+    }
+    return SGX_SUCCESS;
 }
 
 /**
@@ -166,39 +76,39 @@ static struct coefficients solve_polynomial_coefficients(
  * ------------------------------
  *
  * Evaluate the polynomial on `x = 10000`, `x = 22222` and `x = 303030`, then solve the linear equation to find the
- * coefficients for the secret polynomial. Only 3 calls to `ecall_polinomio_secreto` and 1 call to
- * `ecall_verificar_polinomio` are made.
+ * coefficients for the secret polynomial. Only 1 call to `ecall_polinomio_secreto_lote` (or 3 calls to
+ * `ecall_polinomio_secreto`) and 1 call to `ecall_verificar_polinomio` are made.
  */
 sgx_status_t challenge_4(sgx_enclave_id_t eid) {
     const int x[3] = {10'000, 22'222, 303'030};
     int y[3] = {INT_MIN, INT_MIN, INT_MIN};
 
     // collect some points for the linear solution
-    for (size_t i = 0; i < 3; i++) {
-        const sgx_status_t status = ecall_polinomio_secreto(eid, &(y[i]), x[i]);
-        if unlikely (status != SGX_SUCCESS) {
-            return status;
-        }
+    const sgx_status_t status = evaluate_points(eid, x, y, 3);
+    if unlikely (status != SGX_SUCCESS) {
+        return status;
+    }
 #ifdef DEBUG
-        printf("Challenge 4: x%zu = %d, y%zu = %d\n", i + 1, x[i], i + 1, y[i]);
-#endif
+    for (size_t i = 0; i < 3; i++) {
+        writer_printf("Challenge 4: x%zu = %d, y%zu = %d\n", i + 1, x[i], i + 1, y[i]);
     }
+#endif
 
-    const struct coefficients poly =
-        solve_polynomial_coefficients(toP(x[0]), toP(y[0]), toP(x[1]), toP(y[1]), toP(x[2]), toP(y[2]));
+    const struct coefficients poly = solve_polynomial_coefficients(x, y);
 
 #ifdef DEBUG
-    printf("Challenge 4: a = %d, b = %d, c = %d\n", poly.a, poly.b, poly.c);
+    writer_printf("Challenge 4: a = %d, b = %d, c = %d\n", poly.a, poly.b, poly.c);
 #endif
 
     int rv = 0;
-    const sgx_status_t status = ecall_verificar_polinomio(eid, &rv, poly.a, poly.b, poly.c);
-    if unlikely (status != SGX_SUCCESS) {
-        return status;
+    const sgx_status_t verify_status =
+        ECALL_RETRY(STATS_CALL(ecall_verificar_polinomio, eid, &rv, poly.a, poly.b, poly.c));
+    if unlikely (verify_status != SGX_SUCCESS) {
+        return verify_status;
     }
 
     if unlikely (rv == 0) {
-        printf("Challenge 4: Coefficients not found\n");
+        writer_printf("Challenge 4: Coefficients not found\n");
         return SGX_ERROR_UNEXPECTED;
     }
 
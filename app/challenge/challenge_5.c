@@ -3,6 +3,7 @@
 #include <limits.h>
 #include <math.h>
 #include <pcg_basic.h>
+#include <pthread.h>
 #include <sgx_eid.h>
 #include <sgx_error.h>
 #include <stddef.h>
@@ -11,7 +12,13 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "../parallel.h"
+#include "../search.h"
+#include "../stats.h"
+#include "../writer.h"
 #include "./challenges.h"
+#include "./rps_solver.h"
+#include "app_config.h"
 #include "defines.h"
 #include "enclave_u.h"
 
@@ -94,20 +101,60 @@ static double invnorm(const double p) {
 }
 
 /** Pre-defined number of rounds in each Rock, Paper, Scissors game. */
-static constexpr size_t ROUNDS = 20;
+static constexpr size_t ROUNDS = RPS_ROUNDS;
 
 /**
- * Answers for each round in Rock, Paper, Scissors game.
+ * Answers for each round in Rock, Paper, Scissors game, for the game played by the current thread.
  *
- * These values will be returned by `ocall_pedra_papel_tesoura`.
+ * These values will be returned by `ocall_pedra_papel_tesoura`. Regular OCALLs run on the thread that made the
+ * ECALL, so each thread can play its own game.
  */
-static uint8_t answers[ROUNDS] = {0};
+static thread_local uint8_t answers[ROUNDS] = {0};
 
+#if SWITCHLESS
 /**
- * Number of successful calls to `ecall_pedra_papel_tesoura`.
+ * Switchless OCALLs run on untrusted worker threads instead, which can't see the thread-local `answers`. Games that
+ * need `ocall_pedra_papel_tesoura` are then played one at a time, with the answers published here.
+ */
+static const uint8_t *NULLABLE shared_answers = NULL;
+/** Serializes games with OCALLs, for `shared_answers`. */
+static pthread_mutex_t shared_answers_lock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+/**
+ * Number of successful calls to `ecall_pedra_papel_tesoura`, on all threads.
  */
 static size_t games_played = 0;
 
+/**
+ * Results of all games played by both solvers. Every game goes through the search engine, which never plays a game
+ * twice, and is then recorded in the trie of the propagation search, so it starts from every game the stochastic solver
+ * played. Winning games are never recorded, the challenge ends with them.
+ */
+static struct {
+    /** Serializes the threads of the prefix search. */
+    pthread_mutex_t lock;
+    /** Observed games, set for the duration of `challenge_5`. */
+    rps_solver_t *NULLABLE games;
+    /** Searches on the games oracle, set for the duration of `challenge_5`. */
+    search_t *NULLABLE search;
+} results = {.lock = PTHREAD_MUTEX_INITIALIZER, .games = NULL, .search = NULL};
+
+[[nodiscard("error must be checked"), gnu::nonnull(1)]]
+/**
+ * Record that `game` got `wins`, less than `ROUNDS`.
+ *
+ * Returns `false` if out of memory.
+ */
+static bool results_record(const uint8_t game[NONNULL ROUNDS], const uint8_t wins) {
+    assume(wins < ROUNDS);
+    (void) pthread_mutex_lock(&(results.lock));
+    assume(results.games != NULL);
+    const bool ok = rps_solver_observe(results.games, game, wins);
+    (void) pthread_mutex_unlock(&(results.lock));
+    return ok;
+}
+
 /**
  * OCALL that will be invoked `ROUNDS` (20) times by the `ecall_pedra_papel_tesoura`. It receives the current round
  * number as its parameter (1 through `ROUNDS`). This function MUST return `0` (rock), `1` (paper), or `2` (scissors);
@@ -117,10 +164,38 @@ static size_t games_played = 0;
  **/
 unsigned int ocall_pedra_papel_tesoura(unsigned int round) {
     if unlikely (round < 1 || round > ROUNDS) {
-        printf("Challenge 5: Invalid input round = %u\n", round);
+        writer_printf("Challenge 5: Invalid input round = %u\n", round);
         return UINT_MAX;
     }
+
+#if SWITCHLESS
+    const uint8_t *NULLABLE current = __atomic_load_n(&shared_answers, __ATOMIC_ACQUIRE);
+    // regular OCALLs, after falling back
+    if unlikely (current == NULL) {
+        current = answers;
+    }
+    return current[round - 1];
+#else
     return answers[round - 1];
+#endif
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(2, 3)]]
+/**
+ * Call `ecall_pedra_papel_tesoura` with the `answers` of the current thread.
+ */
+static sgx_status_t play_answers(const sgx_enclave_id_t eid, int *NONNULL wins, const uint8_t *NONNULL current) {
+#if SWITCHLESS
+    (void) pthread_mutex_lock(&shared_answers_lock);
+    __atomic_store_n(&shared_answers, current, __ATOMIC_RELEASE);
+    const sgx_status_t status = ECALL_RETRY(STATS_CALL(ecall_pedra_papel_tesoura, eid, wins));
+    __atomic_store_n(&shared_answers, NULL, __ATOMIC_RELEASE);
+    (void) pthread_mutex_unlock(&shared_answers_lock);
+    return status;
+#else
+    (void) current;
+    return ECALL_RETRY(STATS_CALL(ecall_pedra_papel_tesoura, eid, wins));
+#endif
 }
 
 [[nodiscard("error must be checked"), gnu::nonnull(2), gnu::hot]]
@@ -134,22 +209,179 @@ static uint8_t check_answers(const sgx_enclave_id_t eid, sgx_status_t *NONNULL s
     static_assert(ROUNDS <= INT_MAX);
     int wins = INT_MIN;
 
-    sgx_status_t rstatus = ecall_pedra_papel_tesoura(eid, &wins);
+    sgx_status_t rstatus = play_answers(eid, &wins, answers);
     if unlikely (rstatus != SGX_SUCCESS) {
         *status = rstatus;
         return UINT8_MAX;
     } else if unlikely (wins < 0 || wins > (int) ROUNDS) {
-        printf("Challenge 5: Invalid ecall_pedra_papel_tesoura wins = %d\n", wins);
+        writer_printf("Challenge 5: Invalid ecall_pedra_papel_tesoura wins = %d\n", wins);
         *status = SGX_ERROR_UNEXPECTED;
         return UINT8_MAX;
     } else {
         *status = SGX_SUCCESS;
     }
 
-    games_played++;
+    (void) __atomic_fetch_add(&games_played, 1, __ATOMIC_RELAXED);
     return likely(wins != ROUNDS) ? (uint8_t) wins : UINT8_MAX;
 }
 
+/** Maximum number of games in a single `check_games`. */
+static constexpr size_t GAMES_BATCH = 128;
+
+[[nodiscard("error must be checked"), gnu::nonnull(2, 3, 4), gnu::hot]]
+/**
+ * Runs all `games` with a single `ecall_pedra_papel_tesoura_lote`, or with one `ecall_pedra_papel_tesoura` each for
+ * enclaves without it. The number of wins in each game is written to `wins`, up to the winning game.
+ *
+ * Returns the index of the winning game, `count` if none won, or `SIZE_MAX` on errors, with an error code written to
+ * `status`.
+ */
+static size_t check_games(
+    const sgx_enclave_id_t eid,
+    sgx_status_t *NONNULL status,
+    const jogo_t games[NONNULL],
+    uint8_t wins[NONNULL],
+    const size_t count
+) {
+    static_assert(sizeof(games[0].jogadas) == ROUNDS);
+
+    int winner = INT_MIN;
+    const sgx_status_t rstatus =
+        ECALL_RETRY(STATS_CALL(ecall_pedra_papel_tesoura_lote, eid, &winner, games, wins, count));
+    if likely (rstatus == SGX_SUCCESS) {
+        if unlikely (winner < -1 || winner >= (int) count) {
+            writer_printf("Challenge 5: Invalid ecall_pedra_papel_tesoura_lote result = %d\n", winner);
+            *status = SGX_ERROR_UNEXPECTED;
+            return SIZE_MAX;
+        }
+
+        *status = SGX_SUCCESS;
+        const size_t played = likely(winner < 0) ? count : (size_t) winner + 1;
+        (void) __atomic_fetch_add(&games_played, played, __ATOMIC_RELAXED);
+        return likely(winner < 0) ? count : (size_t) winner;
+    } else if unlikely (rstatus != SGX_ERROR_INVALID_FUNCTION) {
+        *status = rstatus;
+        return SIZE_MAX;
+    }
+
+    // enclave without the batched ECALL
+    for (size_t i = 0; i < count; i++) {
+        memcpy(answers, games[i].jogadas, ROUNDS * sizeof(uint8_t));
+
+        wins[i] = check_answers(eid, status);
+        if unlikely (wins[i] == UINT8_MAX) {
+            return likely(*status == SGX_SUCCESS) ? i : SIZE_MAX;
+        }
+    }
+    return count;
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(3, 5, 6, 7), gnu::hot]]
+/**
+ * Games oracle: play all `candidates` with `check_games`. The result is the number of wins of each game, which is also
+ * recorded in the result store.
+ */
+static sgx_status_t query_games(
+    const sgx_enclave_id_t eid,
+    void *NULLABLE context,
+    const void *NONNULL candidates,
+    const size_t count,
+    uint32_t wins[NONNULL],
+    size_t *NONNULL accepted,
+    const bool *NONNULL stop
+) {
+    (void) context;
+    (void) stop;
+    assume(count <= GAMES_BATCH);
+    const jogo_t *NONNULL games = (const jogo_t *) candidates;
+
+    uint8_t played[GAMES_BATCH];
+    sgx_status_t status = SGX_SUCCESS;
+    const size_t winner = check_games(eid, &status, games, played, count);
+    if unlikely (winner == SIZE_MAX) {
+        return status;
+    } else if unlikely (winner < count) {
+        *accepted = winner;
+        return SGX_SUCCESS;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        wins[i] = played[i];
+        if unlikely (!results_record(games[i].jogadas, played[i])) {
+            return SGX_ERROR_OUT_OF_MEMORY;
+        }
+    }
+    return SGX_SUCCESS;
+}
+
+/** Games oracle, with batches of `GAMES_BATCH` and repeated games answered from the memo. */
+static const search_oracle_t GAMES_ORACLE = {
+    .name = "ecall_pedra_papel_tesoura_lote",
+    .query = query_games,
+    .context = NULL,
+    .candidate_size = sizeof(jogo_t),
+    .batch = GAMES_BATCH,
+    .threads = 0,
+    .query_ns = 20'000,
+    .candidate_ns = 1'000,
+    .thread_safe = true,
+    .memoize = true,
+};
+
+[[gnu::nonnull(1, 3)]]
+/**
+ * Candidate `index` is the game `index` of `context`, an array of `jogo_t`.
+ */
+static void generate_game(const void *NONNULL context, const size_t index, void *NONNULL candidate) {
+    const jogo_t *NONNULL games = (const jogo_t *) context;
+    memcpy(candidate, &(games[index]), sizeof(jogo_t));
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(2, 3, 4), gnu::hot]]
+/**
+ * Same as `check_games`, but through the games oracle, which splits the games between threads when worth it, and
+ * doesn't play the games already played again. The number of wins is written for all games, unless some game wins.
+ */
+static size_t check_games_parallel(
+    const sgx_enclave_id_t eid,
+    sgx_status_t *NONNULL status,
+    const jogo_t games[NONNULL],
+    uint8_t wins[NONNULL],
+    const size_t count
+) {
+    assume(count <= GAMES_BATCH);
+    assume(results.search != NULL);
+
+    uint32_t outcomes[GAMES_BATCH];
+    size_t winner = count;
+    *status = search_run(results.search, eid, generate_game, games, count, outcomes, &winner);
+    if unlikely (*status != SGX_SUCCESS) {
+        return SIZE_MAX;
+    } else if unlikely (winner < count) {
+        return winner;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        assume(outcomes[i] < ROUNDS);
+        wins[i] = (uint8_t) outcomes[i];
+    }
+    return count;
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(2)]]
+/**
+ * Same as `check_answers`, but through the games oracle, so the current `answers` are only played if they weren't
+ * already, and recorded in the result store.
+ */
+static uint8_t check_answers_stored(const sgx_enclave_id_t eid, sgx_status_t *NONNULL status) {
+    jogo_t game = {};
+    memcpy(game.jogadas, answers, ROUNDS * sizeof(uint8_t));
+
+    uint8_t wins = UINT8_MAX;
+    const size_t winner = check_games_parallel(eid, status, &game, &wins, 1);
+    return likely(winner == 1) ? wins : UINT8_MAX;
+}
+
 [[gnu::const, nodiscard("pure function")]]
 /**
  * Initialize a PRNG state with pre-defined seeds.
@@ -240,6 +472,30 @@ static size_t sample_size(const double confidence, const double power, const siz
     return unlikely(n <= 0) ? 1 : n;
 }
 
+/** 20% chance of assuming a value is better when all are equal. */
+static constexpr double CONFIDENCE = 0.80;
+/** 30% chance of not picking the best value when there's one. */
+static constexpr double POWER = 0.70;
+
+[[gnu::nonnull(1)]]
+/**
+ * Set `answers[position]` to the value with most `wins`, preferring the lowest one on ties.
+ *
+ * Returns the total number of wins.
+ */
+static uint32_t pick_best(const uint32_t wins[NONNULL 3], const size_t position) {
+    if (wins[0] >= wins[1] && wins[0] >= wins[2]) {
+        answers[position] = 0;
+    } else if (wins[1] >= wins[2]) {
+        answers[position] = 1;
+    } else {
+        answers[position] = 2;
+    }
+
+    return wins[0] + wins[1] + wins[2];
+}
+
+#if RPS_SAMPLING == RPS_SAMPLING_FIXED
 [[nodiscard("error must be checked"), gnu::nonnull(2), gnu::hot]]
 /**
  * Estimate the correct play for position `position` with 80% confidence.
@@ -250,8 +506,8 @@ static size_t sample_size(const double confidence, const double power, const siz
  * aggregate.
  *
  * The sample size `n` is estimated following a two-sided test of `ROUNDS - position - 1` guesses with 1/3 win
- * probability. This value is at most `n = 35`, for `position = 0` and 20% significance value. In total, `3 * n`
- * calls to `ecall_pedra_papel_tesoura` are made.
+ * probability. This value is at most `n = 35`, for `position = 0` and 20% significance value. All `3 * n` games are
+ * checked with a single `check_games_parallel`, split between threads by the search engine.
  *
  * Returns the total number of wins for all checked `answers`, or `UINT32_MAX` if a solution was found. In the case of
  * errors, `UINT32_MAX` is also returned to stop the solution and an error code is written to `status`
@@ -262,37 +518,142 @@ static uint32_t pick_position(
     pcg32_random_t *NONNULL random_state,
     const size_t position
 ) {
-    /** 20% chance of assuming a value is better when all are equal. */
-    static constexpr double CONFIDENCE = 0.80;
-    /** 30% chance of not picking the best value when there's one. */
-    static constexpr double POWER = 0.70;
-
     const size_t n = sample_size(CONFIDENCE, POWER, position + 1);
 
+    jogo_t games[GAMES_BATCH];
+    uint8_t game_wins[GAMES_BATCH];
+
     uint32_t wins[3] = {0, 0, 0};
-    for (uint8_t d = 0; d < 3; d++) {
-        answers[position] = d;
-        for (size_t k = 0; k < n; k++) {
+    // the `3 * n` samples in order, `n` for each value of `d`, split in batches
+    for (size_t first = 0; first < 3 * n; first += GAMES_BATCH) {
+        const size_t count = likely(3 * n - first > GAMES_BATCH) ? GAMES_BATCH : 3 * n - first;
+
+        for (size_t k = 0; k < count; k++) {
+            answers[position] = (uint8_t) ((first + k) / n);
             generate_random_answers_from(random_state, position + 1);
+            memcpy(games[k].jogadas, answers, ROUNDS * sizeof(uint8_t));
+        }
 
-            const uint8_t current_wins = check_answers(eid, status);
-            if unlikely (current_wins == UINT8_MAX) {
-                return UINT32_MAX;
-            }
-            wins[d] += current_wins;
+        const size_t winner = check_games_parallel(eid, status, games, game_wins, count);
+        if unlikely (winner == SIZE_MAX) {
+            return UINT32_MAX;
+        } else if unlikely (winner < count) {
+            memcpy(answers, games[winner].jogadas, ROUNDS * sizeof(uint8_t));
+            return UINT32_MAX;
+        }
+
+        for (size_t k = 0; k < count; k++) {
+            wins[(first + k) / n] += game_wins[k];
         }
     }
 
-    if (wins[0] >= wins[1] && wins[0] >= wins[2]) {
-        answers[position] = 0;
-    } else if (wins[1] >= wins[2]) {
-        answers[position] = 1;
-    } else {
-        answers[position] = 2;
+    return pick_best(wins, position);
+}
+#else
+/** Maximum number of stages in a single `check_games_parallel`, with one game for each value per stage. */
+static constexpr size_t SPRT_STAGES = GAMES_BATCH / 3;
+
+[[gnu::const, nodiscard("pure function")]]
+/**
+ * Variance of the wins of a single game for `position`, when the following rounds are random guesses. The last
+ * position is deterministic, so a single round is assumed instead.
+ */
+static double wins_variance(const size_t position) {
+    /** The probability of winning in a single round. */
+    static constexpr double P = 1.0 / 3.0;
+
+    const size_t rounds = likely(position + 1 < ROUNDS) ? ROUNDS - position - 1 : 1;
+    return (double) rounds * P * (1 - P);
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(2), gnu::hot]]
+/**
+ * Estimate the correct play for position `position` with a sequential test, usually with far fewer games than the
+ * fixed sample size.
+ *
+ * Games are played in stages, each with one random sub-sequence for every value. Under the hypothesis that value `c`
+ * is the correct one (`DELTA` more wins per game, the other two equal), the log-likelihood ratio against value `j`
+ * after `n` stages is `DELTA / σ² × (wins[c] - wins[j])`, whatever the mean of the wrong values. The test stops once
+ * the leader beats the runner-up by Wald's SPRT boundary `log(POWER / α)`.
+ *
+ * The fixed `sample_size` from `CONFIDENCE` and `POWER` is conservative: with `n` games per value, a wrong value wins
+ * the comparison with probability `α = 1 - Φ(DELTA √(n / 2σ²))`, about 2%. The same `α` is used here, so both tests
+ * pick a wrong value about as often. The expected number of stages is about `σ² log(POWER / α) / DELTA²`, for example
+ * 15 instead of 35 on the first position, and around 35% fewer games in total.
+ *
+ * The stages are truncated at the fixed `sample_size`, when the value with most wins is picked, so this never plays
+ * more games than the fixed test. Each `check_games_parallel` plays half of the expected stages, and the test is
+ * checked after each stage in order, so later games in the same batch may be wasted.
+ *
+ * Returns the total number of wins for all counted stages, or `UINT32_MAX` if a solution was found. In the case of
+ * errors, `UINT32_MAX` is also returned to stop the solution and an error code is written to `status`
+ */
+static uint32_t pick_position(
+    const sgx_enclave_id_t eid,
+    sgx_status_t *NONNULL status,
+    pcg32_random_t *NONNULL random_state,
+    const size_t position
+) {
+    /** Correct choice always scores, and drawing or losing never does. So 1 score higher is expected. */
+    static constexpr double DELTA = 1;
+
+    const size_t max_stages = sample_size(CONFIDENCE, POWER, position + 1);
+    const double variance = wins_variance(position);
+    // error rate of the fixed test, for a wrong value against the right one
+    const double alpha = 0.5 * erfc(DELTA * sqrt((double) max_stages / (2 * variance)) / sqrt(2));
+    const double boundary = log(POWER / alpha);
+    // log-likelihood ratio per win of difference
+    const double scale = DELTA / variance;
+
+    const double expected = ceil(boundary / (scale * DELTA));
+    size_t batch_stages = (size_t) ceil(expected / 2);
+    batch_stages = likely(batch_stages < SPRT_STAGES) ? batch_stages : SPRT_STAGES;
+    batch_stages = likely(batch_stages > 0) ? batch_stages : 1;
+
+    jogo_t games[3 * SPRT_STAGES];
+    uint8_t game_wins[3 * SPRT_STAGES];
+
+    uint32_t wins[3] = {0, 0, 0};
+    size_t stages = 0;
+    while (stages < max_stages) {
+        const size_t batch = likely(max_stages - stages > batch_stages) ? batch_stages : max_stages - stages;
+        const size_t count = 3 * batch;
+
+        // interleaved values, so every stage is complete
+        for (size_t k = 0; k < count; k++) {
+            answers[position] = (uint8_t) (k % 3);
+            generate_random_answers_from(random_state, position + 1);
+            memcpy(games[k].jogadas, answers, ROUNDS * sizeof(uint8_t));
+        }
+
+        const size_t winner = check_games_parallel(eid, status, games, game_wins, count);
+        if unlikely (winner == SIZE_MAX) {
+            return UINT32_MAX;
+        } else if unlikely (winner < count) {
+            memcpy(answers, games[winner].jogadas, ROUNDS * sizeof(uint8_t));
+            return UINT32_MAX;
+        }
+
+        for (size_t stage = 0; stage < batch; stage++) {
+            for (size_t value = 0; value < 3; value++) {
+                wins[value] += game_wins[3 * stage + value];
+            }
+            stages++;
+
+            // the leader beats both others once it beats the runner-up
+            const uint32_t high = wins[0] > wins[1] ? wins[0] : wins[1];
+            const uint32_t low = wins[0] > wins[1] ? wins[1] : wins[0];
+            const uint32_t first = wins[2] > high ? wins[2] : high;
+            const uint32_t second = wins[2] > high ? high : (wins[2] > low ? wins[2] : low);
+            if (scale * (double) (first - second) >= boundary) {
+                return pick_best(wins, position);
+            }
+        }
     }
 
-    return wins[0] + wins[1] + wins[2];
+    return pick_best(wins, position);
 }
+#endif
 
 [[nodiscard("error must be checked")]]
 /**
@@ -305,7 +666,7 @@ static uint32_t pick_position(
  * total wins is selected. This is likely to be the correct result, because each correct position will yield more wins
  * then the other two on average, assuming the remaining rounds are indistinguishable from random (i.e. it's a PRNG).
  *
- * In total, up to 1068 calls to `ecall_pedra_papel_tesoura` are made:
+ * In total, up to 1068 games are played, in a single batch of games for each of the 20 positions:
  *
  *     Σ_{i=0}^19 3 sample_size(i) = 3 Σ_{i=0}^19 ⌈(20-i) × 2(z_{1-α}²+z_{1-β}²) σ²/Δ²⌉
  *                                 = 3 Σ_{i=0}^19 ⌈(20-i) × 2(z_{0.8}²+z_{0.7}² 2/9⌉
@@ -314,6 +675,15 @@ static uint32_t pick_position(
  * This solution is stochastic and has a 45.89% chance of finding the correct sequence in 20 rounds. See
  * `docs/probabilities.py` for more details on the probabilities. For my enclave, the solution was found after
  * 1064 games.
+ *
+ * With `RPS_SAMPLING_SPRT`, each position stops as soon as a sequential test picks a value, with the same error rate
+ * as the fixed sample size. The games of a position are then played in several smaller batches, one for each group
+ * of up to `SPRT_STAGES` stages, so the test can stop between them. In simulations, the success rate is about the same
+ * with around 690 games on average.
+ *
+ * Each batch goes through the games oracle, which splits it in `ecall_pedra_papel_tesoura_lote` calls on the threads
+ * left free by the other challenges, and answers the games already played from its memo. So the number of ECALLs
+ * depends on the free threads, not only on the number of batches.
  */
 static sgx_status_t challenge_5_stochastic(const sgx_enclave_id_t eid) {
     pcg32_random_t random_state = seed_random_state();
@@ -327,7 +697,7 @@ static sgx_status_t challenge_5_stochastic(const sgx_enclave_id_t eid) {
         }
 
 #ifdef DEBUG
-        printf(
+        writer_printf(
             "Challenge 5: answers[%zu] = %" PRIu8 ", total wins = %" PRIu32 "\n",
             position,
             answers[position],
@@ -340,48 +710,235 @@ static sgx_status_t challenge_5_stochastic(const sgx_enclave_id_t eid) {
     return SGX_ERROR_UNEXPECTED;
 }
 
-[[nodiscard("error must be checked")]]
+/** Maximum number of branches on the round after the prefix, one for each play. */
+static constexpr size_t EXACT_BRANCHES = 3;
+
 /**
- * Challenge 5: Rock, Paper, Scissors
- * ----------------------------------
- *
- * Uses dynamic programming to find the largest prefix with the correct number of wins. At each iteration, the prefix
- * length is refined to how many wins the current configuration gets, then the next configuration is tested.
+ * Shared state of the prefix search threads.
+ */
+typedef struct exact_search {
+    /** Established plays, and the plays searched on the next round. */
+    rps_prefix_t prefix;
+    /** Plays on the round after the prefix, one for each branch. */
+    uint8_t branches[EXACT_BRANCHES];
+    /** Number of `branches`. */
+    size_t count;
+    /** Set once some branch finds the solution. */
+    bool solved;
+} exact_search_t;
+
+[[nodiscard("error must be checked"), gnu::nonnull(2)]]
+/**
+ * Exact search restricted to the sequences starting with the prefix and `play`. Stops early once `search->solved` is
+ * set, and sets it when the solution is found.
  *
- * This implementation has an upper bound of `2**n - 2` calls to `ecall_pedra_papel_tesoura`, so 1_048_574 for
- * `n = 20`. It should be much better on average, though, assuming a pseudo-random sequence is used. For my enclave,
- * the solution was found after 2807 games.
+ * Returns `SGX_SUCCESS` when the branch is solved, exhausted or stopped, or the error code otherwise.
  */
-static sgx_status_t challenge_5_exact(const sgx_enclave_id_t eid) {
+static sgx_status_t exact_branch(const sgx_enclave_id_t eid, exact_search_t *NONNULL search, const uint8_t play) {
+    const uint8_t length = search->prefix.length;
+    assume(length < ROUNDS && play < 3);
     memset(answers, 0, ROUNDS * sizeof(uint8_t));
+    memcpy(answers, search->prefix.plays, length * sizeof(uint8_t));
+    answers[length] = play;
 
-    while (true) {
+    while (!__atomic_load_n(&(search->solved), __ATOMIC_ACQUIRE)) {
         sgx_status_t status = SGX_SUCCESS;
-        const uint8_t wins = check_answers(eid, &status);
+        const uint8_t wins = check_answers_stored(eid, &status);
         if unlikely (wins == UINT8_MAX) {
+            if likely (status == SGX_SUCCESS) {
+                __atomic_store_n(&(search->solved), true, __ATOMIC_RELEASE);
+            }
             return status;
         }
         assume(wins < ROUNDS);
 
-        // we need all positions to be correct, but since we got `wins < ROUNDS`,
-        // we assume the first `wins` positions are correct, so we update the next position
-        uint8_t i = wins + 1;
-        // if the next position is at maximum (i.e. we tried all values), we reduce the prefix length
-        while (likely(i > 0) && unlikely(answers[i - 1] >= 2)) {
-            i--;
+        // no prefix length matched, the prefix and the branch play are fixed
+        if unlikely (!rps_search_next(answers, wins, length + 1)) {
+            return SGX_SUCCESS;
+        }
+    }
+    return SGX_SUCCESS;
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(2)]]
+/**
+ * Thread `index` searches the branches `index`, `index + threads`, ... of the round after the prefix.
+ */
+static sgx_status_t exact_task(
+    const sgx_enclave_id_t eid,
+    void *NONNULL context,
+    const size_t index,
+    const size_t threads
+) {
+    exact_search_t *NONNULL search = (exact_search_t *) context;
+
+    for (size_t branch = index; branch < search->count; branch += threads) {
+        const sgx_status_t status = exact_branch(eid, search, search->branches[branch]);
+        if unlikely (status != SGX_SUCCESS) {
+            return status;
+        }
+    }
+    return SGX_SUCCESS;
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(2)]]
+/**
+ * Challenge 5: Rock, Paper, Scissors (prefix search)
+ * --------------------------------------------------
+ *
+ * Uses dynamic programming to find the largest prefix with the correct number of wins. At each iteration, the prefix
+ * length is refined to how many wins the current configuration gets, then the next configuration is tested. Each
+ * play on the round after the `k` plays of `prefix` (none, on a fresh search) is a separate branch, searched
+ * concurrently by up to `APP_THREADS` threads, and all of them stop once one finds the solution.
+ *
+ * Each branch has an upper bound of `2**(n - k) - 2` calls to `ecall_pedra_papel_tesoura` (3 when `n - k <= 2`), so
+ * the one with the right play finds the solution within 1_048_574 games for `n = 20` and no established plays. It
+ * should be much better on average, though, assuming a pseudo-random sequence is used. For my enclave, the solution
+ * was found after 2807 games.
+ */
+static sgx_status_t challenge_5_search(const sgx_enclave_id_t eid, const rps_prefix_t *NONNULL prefix) {
+    exact_search_t search = {.prefix = *prefix, .branches = {}, .count = 0, .solved = false};
+    for (uint8_t play = 0; play < EXACT_BRANCHES; play++) {
+        if ((prefix->branches & (1U << play)) != 0) {
+            search.branches[search.count++] = play;
         }
+    }
+    assume(search.count > 0);
+
+    const size_t threads = likely(APP_THREADS < search.count) ? APP_THREADS : search.count;
+    const sgx_status_t status = parallel_run(eid, threads, exact_task, &search);
+    if unlikely (status != SGX_SUCCESS) {
+        return status;
+    }
+
+    // solution not found
+    return likely(search.solved) ? SGX_SUCCESS : SGX_ERROR_UNEXPECTED;
+}
 
-        // no prefix length matched
-        if unlikely (i == 0) {
-            // solution not found
+#if RPS_EXACT == RPS_EXACT_SEARCH
+[[nodiscard("error must be checked")]]
+/**
+ * Exact solver for `challenge_5`, see `challenge_5_search`.
+ */
+static sgx_status_t challenge_5_exact(const sgx_enclave_id_t eid) {
+    return challenge_5_search(eid, &RPS_PREFIX_EMPTY);
+}
+#else
+[[nodiscard("error must be checked")]]
+/**
+ * Challenge 5: Rock, Paper, Scissors (propagation)
+ * ------------------------------------------------
+ *
+ * Constraint propagation over all games played so far. The games form a trie of prefixes, each with an unknown
+ * enclave play, and every game must have its observed number of wins. For each prefix and each number of wins over
+ * it, `rps_solver_t` keeps whether the games below it are still consistent, and how many assignments of enclave plays
+ * are. Only the prefixes of the last game change, so each game is propagated in `O(ROUNDS²)`.
+ *
+ * The next game follows, from the first round, the play that beats the most likely enclave play among the ones still
+ * consistent with all previous rounds being wins, and zeros after the last observed prefix. It's the most likely
+ * solution given the observations, so each game either wins or rules out the plays it assumed. No game is repeated,
+ * and no game that is known to lose is played, which keeps the search exact. Each game depends on all previous ones,
+ * so they are played one at a time, on a single thread.
+ *
+ * This is a greedy choice, not the game that rules out the most assignments: ranking the games by how much they prune
+ * would need the expected outcome of each candidate, and there are `3^20` of them. So there's no proven bound on the
+ * games it plays. After `RPS_PROPAGATION_GAMES` games, it falls back to `challenge_5_search`, starting from the `k`
+ * plays that the trie established and searching only the plays that may still win the next round. Each branch then
+ * plays at most `2**(20 - k) - 2` games, never more than the `2**20 - 2` of the prefix search from scratch, and games
+ * that were already played are answered by the memo.
+ *
+ * The search runs on the trie of the result store, so it starts from all games already played by the stochastic
+ * solver, instead of an empty trie.
+ *
+ * Against simulated enclaves (`bench-rps`), it plays around 170 games on average and under 600 in the worst of 10000
+ * seeds, while the prefix search plays around 2500 and up to 5300, so the fallback is not expected to run.
+ */
+static sgx_status_t challenge_5_exact(const sgx_enclave_id_t eid) {
+    assume(results.games != NULL);
+
+    // single thread, so the store is not locked for reading
+    for (size_t played = 0; played < RPS_PROPAGATION_GAMES; played++) {
+        if unlikely (!rps_solver_next(results.games, answers)) {
+            // no consistent assignment, the enclave is not deterministic
             return SGX_ERROR_UNEXPECTED;
         }
 
-        // when we finally find a prefix with next position open for increment,
-        // we update that and reset all other positions to zero
-        answers[i - 1] = (uint8_t) ((answers[i - 1] + 1) % 3);
-        memset(answers + i, 0, (ROUNDS - i) * sizeof(uint8_t));
+        sgx_status_t status = SGX_SUCCESS;
+        const uint8_t wins = check_answers_stored(eid, &status);
+        if unlikely (wins == UINT8_MAX) {
+            return status;
+        }
     }
+
+    rps_prefix_t prefix = RPS_PREFIX_EMPTY;
+    if unlikely (!rps_solver_prefix(results.games, &prefix)) {
+        return SGX_ERROR_UNEXPECTED;
+    }
+#ifdef DEBUG
+    writer_printf(
+        "Challenge 5: no solution after %zu propagation games, falling back from %" PRIu8 " established plays\n",
+        RPS_PROPAGATION_GAMES,
+        prefix.length
+    );
+#endif
+    return challenge_5_search(eid, &prefix);
+}
+#endif
+
+#ifdef DEBUG
+[[gnu::cold]]
+/**
+ * Show the counters of the enclave cache of RPS plays. Enclaves without the cache are ignored.
+ */
+static void print_cache_stats(const sgx_enclave_id_t eid) {
+    rps_cache_stats_t stats = {};
+    int rv = -1;
+    const sgx_status_t status = STATS_CALL(ecall_rps_cache_stats, eid, &rv, &stats);
+    if unlikely (status != SGX_SUCCESS || rv != 0) {
+        return;
+    }
+
+    writer_printf(
+        "Challenge 5: enclave cache hits = %" PRIu64 ", misses = %" PRIu64 " (%" PRIu64 " plays, %" PRIu32 " rounds)\n",
+        stats.hits,
+        stats.misses,
+        stats.entries,
+        stats.depth
+    );
+}
+#endif
+
+[[nodiscard("error must be checked"), gnu::cold]]
+/**
+ * Start an empty result store for `challenge_5`.
+ *
+ * Returns `false` if out of memory.
+ */
+static bool results_start(void) {
+    results.games = rps_solver_new();
+    results.search = search_new(&GAMES_ORACLE);
+    if unlikely (results.games == NULL || results.search == NULL) {
+        rps_solver_free(results.games);
+        search_free(results.search);
+        results.games = NULL;
+        results.search = NULL;
+        return false;
+    }
+    return true;
+}
+
+[[gnu::cold]]
+/**
+ * Release the result store, showing its size and the oracle statistics on debug builds.
+ */
+static void results_stop(void) {
+#ifdef DEBUG
+    writer_printf("Challenge 5: result store kept %zu prefixes\n", rps_solver_nodes(results.games));
+#endif
+    search_free(results.search);
+    results.search = NULL;
+    rps_solver_free(results.games);
+    results.games = NULL;
 }
 
 /**
@@ -392,31 +949,52 @@ static sgx_status_t challenge_5_exact(const sgx_enclave_id_t eid) {
  * guaranteed to find a solution, but it runs faster. At 2800 calls (the same number as exact implementation), the
  * statistical one has 98% probability of finding the solution. Additionally, the stochastic solution allows
  * for extreme parallelization.
+ *
+ * All games played by both go through the same result store, so the exact solution reuses the stochastic games.
  */
 sgx_status_t challenge_5(sgx_enclave_id_t eid) {
-    games_played = 0;
+    if unlikely (!results_start()) {
+        return SGX_ERROR_OUT_OF_MEMORY;
+    }
+
+    __atomic_store_n(&games_played, 0, __ATOMIC_RELAXED);
     sgx_status_t status = challenge_5_stochastic(eid);
-    const size_t stochastic_games = games_played;
+    const size_t stochastic_games = __atomic_load_n(&games_played, __ATOMIC_RELAXED);
 
     if likely (status == SGX_SUCCESS) {
 #ifdef DEBUG
-        printf("Challenge 5: Stochastic solution successful after %zu games.\n", stochastic_games);
+        writer_printf("Challenge 5: Stochastic solution successful after %zu games.\n", stochastic_games);
 #else
+        results_stop();
         return SGX_SUCCESS;
 #endif
     }
 
-    games_played = 0;
+    __atomic_store_n(&games_played, 0, __ATOMIC_RELAXED);
+#ifdef DEBUG
+    search_stats_t stochastic_stats = {};
+    search_stats(results.search, &stochastic_stats);
+#endif
     status = challenge_5_exact(eid);
-    const size_t exact_games = games_played;
+    const size_t exact_games = __atomic_load_n(&games_played, __ATOMIC_RELAXED);
 
     if likely (status == SGX_SUCCESS) {
 #ifdef DEBUG
-        printf("Challenge 5: Exact solution successful after %zu games.\n", exact_games);
+        search_stats_t exact_stats = {};
+        search_stats(results.search, &exact_stats);
+        writer_printf(
+            "Challenge 5: Exact solution successful after %zu games (%" PRIu64 " answered by the memo, %zu reused).\n",
+            exact_games,
+            exact_stats.memo_hits - stochastic_stats.memo_hits,
+            stochastic_games
+        );
+        print_cache_stats(eid);
 #endif
+        results_stop();
         return SGX_SUCCESS;
     }
 
-    printf("Challenge 5: Winning sequence not found after %zu games.\n", stochastic_games + exact_games);
+    writer_printf("Challenge 5: Winning sequence not found after %zu games.\n", stochastic_games + exact_games);
+    results_stop();
     return status;
 }
@@ -4,6 +4,17 @@
 
 #include <sgx_eid.h>
 #include <sgx_error.h>
+#include <stddef.h>
+
+/** Fixed sample size for each position of the stochastic solver of challenge 5. */
+#define RPS_SAMPLING_FIXED 0
+/** Sequential probability ratio test for each position of the stochastic solver of challenge 5. */
+#define RPS_SAMPLING_SPRT  1
+
+/** Prefix search for the exact solver of challenge 5, using only the wins of the last game. */
+#define RPS_EXACT_SEARCH      0
+/** Constraint propagation over all games for the exact solver of challenge 5. */
+#define RPS_EXACT_PROPAGATION 1
 
 [[nodiscard("error must be checked"), gnu::nothrow, gnu::leaf]]
 /**
@@ -28,6 +39,12 @@ sgx_status_t challenge_1(sgx_enclave_id_t eid);
  */
 sgx_status_t challenge_2(sgx_enclave_id_t eid);
 
+[[nodiscard("error must be checked"), gnu::nothrow]]
+/**
+ * Challenge 2: Crack the password, with `threads` concurrent threads sharing the same enclave.
+ */
+sgx_status_t challenge_2_threads(sgx_enclave_id_t eid, size_t threads);
+
 [[nodiscard("error must be checked"), gnu::nothrow, gnu::leaf]]
 /**
  * Challenge 3: Secret Sequence
@@ -0,0 +1,315 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "./rps_solver.h"
+#include "defines.h"
+
+bool rps_search_next(uint8_t answers[NONNULL RPS_ROUNDS], const uint8_t wins, const uint8_t fixed) {
+    assume(wins < RPS_ROUNDS);
+    assume(0 < fixed && fixed <= RPS_ROUNDS);
+
+    // we need all positions to be correct, but since we got `wins < RPS_ROUNDS`,
+    // we assume the first `wins` positions are correct, so we update the next position
+    uint8_t i = wins + 1;
+    // if the next position is at maximum (i.e. we tried all values), we reduce the prefix length
+    while (likely(i > fixed) && unlikely(answers[i - 1] >= 2)) {
+        i--;
+    }
+
+    // no prefix length matched, the first `fixed` plays can't change
+    if unlikely (i <= fixed) {
+        return false;
+    }
+
+    // when we finally find a prefix with next position open for increment,
+    // we update that and reset all other positions to zero
+    answers[i - 1] = (uint8_t) ((answers[i - 1] + 1) % 3);
+    memset(answers + i, 0, (RPS_ROUNDS - i) * sizeof(uint8_t));
+    return true;
+}
+
+/** Index of the empty prefix, which is never a child, so it also marks missing children. */
+static constexpr uint32_t ROOT = 0;
+/** Initial number of allocated nodes. Each game adds at most `RPS_ROUNDS`. */
+static constexpr size_t INITIAL_CAPACITY = 1024;
+
+static_assert(RPS_ROUNDS < 32, "prefix sums must fit in a 32-bit mask");
+
+/**
+ * A prefix of some observed game. Its enclave play, unknown, decides the wins of the next round for each child.
+ *
+ * For each number of wins `s` over the prefix, the node keeps whether some assignment of the plays on its subtree
+ * matches all observed games below it (`feasible`), and how many do (`weight`). The bits are exact, and the only
+ * thing used to rule plays out. The weights are scaled to at most `1` on each node and only rank the plays.
+ */
+typedef struct rps_node {
+    /** Subtree after each app play, or `ROOT` if not observed. */
+    uint32_t children[3];
+    /** Node of the prefix without the last play. */
+    uint32_t parent;
+    /** Length of the prefix. Nodes with `RPS_ROUNDS` plays are the observed games. */
+    uint8_t depth;
+    /** Bit `s` is set when the subtree is consistent with `s` wins over the prefix. */
+    uint32_t feasible;
+    /** Relative number of consistent assignments of the subtree, for `s` wins over the prefix. */
+    double weight[RPS_ROUNDS + 1];
+} rps_node_t;
+
+struct rps_solver {
+    /** Trie of all observed games, with the empty prefix at `ROOT`. */
+    rps_node_t *NONNULL nodes;
+    /** Nodes in use. */
+    size_t count;
+    /** Allocated nodes. */
+    size_t capacity;
+};
+
+[[nodiscard("useless call"), gnu::const, gnu::always_inline]]
+/**
+ * Play that wins against `enclave_play`.
+ */
+static inline uint8_t winning_play(const uint8_t enclave_play) {
+    return (uint8_t) ((enclave_play + 1) % 3);
+}
+
+[[gnu::nonnull(1)]]
+/**
+ * Reset `node` to a prefix without observations below it, where any number of wins is possible.
+ */
+static void node_init(rps_node_t *NONNULL node, const uint32_t parent, const uint8_t depth) {
+    *node = (rps_node_t) {.children = {ROOT, ROOT, ROOT}, .parent = parent, .depth = depth, .feasible = UINT32_MAX};
+    for (size_t s = 0; s <= RPS_ROUNDS; s++) {
+        node->weight[s] = 1.0;
+    }
+}
+
+rps_solver_t *NULLABLE rps_solver_new(void) {
+    rps_solver_t *solver = malloc(sizeof(rps_solver_t));
+    if unlikely (solver == NULL) {
+        return NULL;
+    }
+
+    rps_node_t *nodes = malloc(INITIAL_CAPACITY * sizeof(rps_node_t));
+    if unlikely (nodes == NULL) {
+        free(solver);
+        return NULL;
+    }
+
+    node_init(&nodes[ROOT], ROOT, 0);
+    *solver = (rps_solver_t) {.nodes = nodes, .count = 1, .capacity = INITIAL_CAPACITY};
+    return solver;
+}
+
+void rps_solver_free(rps_solver_t *NULLABLE solver) {
+    if likely (solver != NULL) {
+        free(solver->nodes);
+        free(solver);
+    }
+}
+
+size_t rps_solver_nodes(const rps_solver_t *NONNULL solver) {
+    return solver->count;
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(1)]]
+/**
+ * Add a node for `play` after `parent`, growing the trie when needed.
+ *
+ * @return The index of the new node, or `ROOT` if out of memory.
+ */
+static uint32_t push_node(rps_solver_t *NONNULL solver, const uint32_t parent, const uint8_t play) {
+    if unlikely (solver->count >= solver->capacity) {
+        const size_t capacity = 2 * solver->capacity;
+        if unlikely (capacity > UINT32_MAX) {
+            return ROOT;
+        }
+        rps_node_t *nodes = realloc(solver->nodes, capacity * sizeof(rps_node_t));
+        if unlikely (nodes == NULL) {
+            return ROOT;
+        }
+        solver->nodes = nodes;
+        solver->capacity = capacity;
+    }
+
+    const uint32_t index = (uint32_t) solver->count++;
+    node_init(&(solver->nodes[index]), parent, solver->nodes[parent].depth + 1);
+    solver->nodes[parent].children[play] = index;
+    return index;
+}
+
+[[gnu::nonnull(1, 2, 5)]]
+/**
+ * Whether the observations below `node` allow `enclave_play` on it, with `wins` on the prefix, and the product of the
+ * child weights in that case, written to `weight`.
+ */
+static bool play_weight(
+    const rps_solver_t *NONNULL solver,
+    const rps_node_t *NONNULL node,
+    const uint8_t enclave_play,
+    const uint8_t wins,
+    double *NONNULL weight
+) {
+    double product = 1.0;
+    for (uint8_t play = 0; play < 3; play++) {
+        const uint32_t child = node->children[play];
+        if (child == ROOT) {
+            continue;
+        }
+
+        const uint8_t total = (uint8_t) (wins + (play == winning_play(enclave_play)));
+        const rps_node_t *NONNULL next = &(solver->nodes[child]);
+        if ((next->feasible & (UINT32_C(1) << total)) == 0) {
+            return false;
+        }
+        product *= next->weight[total];
+    }
+    *weight = product;
+    return true;
+}
+
+[[gnu::nonnull(1, 2)]]
+/**
+ * Recompute `node` from its children: a number of wins is feasible when some enclave play is feasible for all
+ * children, and the weight adds the product of the children weights over each play.
+ */
+static void update_node(const rps_solver_t *NONNULL solver, rps_node_t *NONNULL node) {
+    assume(node->depth < RPS_ROUNDS);
+
+    uint32_t feasible = 0;
+    double weight[RPS_ROUNDS + 1] = {};
+    double scale = 0.0;
+    for (uint8_t wins = 0; wins <= node->depth; wins++) {
+        for (uint8_t enclave_play = 0; enclave_play < 3; enclave_play++) {
+            double product = 0.0;
+            if (play_weight(solver, node, enclave_play, wins, &product)) {
+                feasible |= UINT32_C(1) << wins;
+                weight[wins] += product;
+            }
+        }
+        scale = likely(weight[wins] <= scale) ? scale : weight[wins];
+    }
+
+    node->feasible = feasible;
+    for (uint8_t wins = 0; wins <= RPS_ROUNDS; wins++) {
+        // weights that underflow still have their feasible bit set
+        node->weight[wins] = likely(scale > 0.0) ? weight[wins] / scale : 0.0;
+    }
+}
+
+bool rps_solver_observe(rps_solver_t *NONNULL solver, const uint8_t query[NONNULL RPS_ROUNDS], const uint8_t wins) {
+    assume(wins <= RPS_ROUNDS);
+
+    uint32_t index = ROOT;
+    for (size_t round = 0; round < RPS_ROUNDS; round++) {
+        const uint8_t play = query[round];
+        assume(play < 3);
+
+        uint32_t child = solver->nodes[index].children[play];
+        if (child == ROOT) {
+            child = push_node(solver, index, play);
+            if unlikely (child == ROOT) {
+                return false;
+            }
+        }
+        index = child;
+    }
+
+    // the game itself: only `wins` is possible, and a repeated game with a different result rules out everything
+    rps_node_t *NONNULL game = &(solver->nodes[index]);
+    game->feasible &= UINT32_C(1) << wins;
+    for (uint8_t s = 0; s <= RPS_ROUNDS; s++) {
+        game->weight[s] = likely(s == wins) ? game->weight[s] : 0.0;
+    }
+
+    // only the prefixes of the game changed
+    do {
+        index = solver->nodes[index].parent;
+        update_node(solver, &(solver->nodes[index]));
+    } while (index != ROOT);
+    return true;
+}
+
+[[nodiscard("useless call"), gnu::nonnull(1, 2)]]
+/**
+ * Plays that may win the round after `node`, as a bitmask, given that all previous rounds are wins.
+ */
+static uint8_t winning_plays(const rps_solver_t *NONNULL solver, const rps_node_t *NONNULL node) {
+    uint8_t plays = 0;
+    for (uint8_t enclave_play = 0; enclave_play < 3; enclave_play++) {
+        double weight = 0.0;
+        if (play_weight(solver, node, enclave_play, node->depth, &weight)) {
+            plays |= (uint8_t) (1U << winning_play(enclave_play));
+        }
+    }
+    return plays;
+}
+
+bool rps_solver_prefix(const rps_solver_t *NONNULL solver, rps_prefix_t *NONNULL prefix) {
+    *prefix = RPS_PREFIX_EMPTY;
+
+    // the enclave play of the solution is always feasible on its own path, so a single feasible play is established
+    uint32_t index = ROOT;
+    while (true) {
+        const rps_node_t *NONNULL node = &(solver->nodes[index]);
+        const uint8_t plays = winning_plays(solver, node);
+        if unlikely (plays == 0) {
+            return false;
+        }
+
+        // the last round is always left as a branch, so the search plays at least one game
+        const bool single = (plays & (plays - 1)) == 0;
+        if (!single || (size_t) node->depth + 1 >= RPS_ROUNDS) {
+            prefix->branches = plays;
+            return true;
+        }
+
+        const uint8_t play = (uint8_t) __builtin_ctz(plays);
+        prefix->plays[prefix->length++] = play;
+
+        index = node->children[play];
+        // nothing is known after the observed prefix, so any play may win the next round
+        if (index == ROOT) {
+            return true;
+        }
+    }
+}
+
+bool rps_solver_next(const rps_solver_t *NONNULL solver, uint8_t query[NONNULL RPS_ROUNDS]) {
+    uint32_t index = ROOT;
+    size_t round = 0;
+
+    // on observed prefixes, the next play beats the most likely enclave play, given that all previous rounds are wins
+    while (round < RPS_ROUNDS) {
+        const rps_node_t *NONNULL node = &(solver->nodes[index]);
+        assume(node->depth == round);
+
+        bool found = false;
+        uint8_t best_play = 0;
+        double best_weight = -1.0;
+        for (uint8_t enclave_play = 0; enclave_play < 3; enclave_play++) {
+            double weight = 0.0;
+            if (play_weight(solver, node, enclave_play, (uint8_t) round, &weight) && weight > best_weight) {
+                found = true;
+                best_play = enclave_play;
+                best_weight = weight;
+            }
+        }
+        if unlikely (!found) {
+            return false;
+        }
+
+        const uint8_t play = winning_play(best_play);
+        query[round++] = play;
+
+        index = node->children[play];
+        if (index == ROOT) {
+            break;
+        }
+    }
+
+    // nothing is known after the observed prefix, every play is as good as any other
+    memset(query + round, 0, (RPS_ROUNDS - round) * sizeof(uint8_t));
+    return true;
+}
@@ -0,0 +1,105 @@
+#ifndef APP_RPS_SOLVER_H
+/** Exact searches for challenge 5, independent of the enclave. */
+#define APP_RPS_SOLVER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "defines.h"
+
+/** Pre-defined number of rounds in each Rock, Paper, Scissors game. */
+static constexpr size_t RPS_ROUNDS = 20;
+
+[[nodiscard("useless call"), gnu::nonnull(1), gnu::nothrow, gnu::leaf]]
+/**
+ * Next sequence of the prefix search, after `answers` got `wins` (less than `RPS_ROUNDS`).
+ *
+ * The first `wins` plays are assumed correct, so the play after them is incremented, or the one before it when it
+ * already tried all values, and all following plays are reset to zero. The first `fixed` plays are never changed.
+ *
+ * When the first `fixed - 1` plays are known to win, it behaves like the search over the last `RPS_ROUNDS - fixed + 1`
+ * rounds, so it tries at most `2**(RPS_ROUNDS - fixed + 1) - 2` sequences (3 for the last two rounds).
+ *
+ * @return `false` when all sequences with the same first `fixed` plays were tried.
+ */
+bool rps_search_next(uint8_t answers[NONNULL RPS_ROUNDS], uint8_t wins, uint8_t fixed);
+
+/**
+ * Start of the prefix search, from the plays established by the observed games.
+ */
+typedef struct rps_prefix {
+    /** Plays that win the first `length` rounds in every assignment consistent with the observations. */
+    uint8_t plays[RPS_ROUNDS];
+    /** Number of established plays, always less than `RPS_ROUNDS`. */
+    uint8_t length;
+    /** Bit `p` is set when play `p` may still win the round after the prefix. Never empty. */
+    uint8_t branches;
+} rps_prefix_t;
+
+/** Prefix search without observations, with all plays on the first round. */
+static constexpr rps_prefix_t RPS_PREFIX_EMPTY = {.plays = {0}, .length = 0, .branches = 0b111};
+
+/**
+ * Games played by the propagation search before falling back to the prefix search. It has no proven bound of its own,
+ * so the fallback starts from the `k` plays established by the games so far, and each of its branches plays at most
+ * `2**(20 - k) - 2` games, never more than the `2**20 - 2` of the prefix search alone. Simulations never needed more
+ * than 600.
+ */
+static constexpr size_t RPS_PROPAGATION_GAMES = 4'096;
+
+/**
+ * Observed games of the propagation search, and the enclave plays that are still consistent with them.
+ */
+typedef struct rps_solver rps_solver_t;
+
+[[nodiscard("leaks memory"), gnu::malloc, gnu::cold, gnu::nothrow]]
+/**
+ * Start a propagation search, without observations.
+ *
+ * @return `NULL` if out of memory.
+ */
+rps_solver_t *NULLABLE rps_solver_new(void);
+
+[[gnu::cold, gnu::nothrow]]
+/**
+ * Release a search created by `rps_solver_new`.
+ */
+void rps_solver_free(rps_solver_t *NULLABLE solver);
+
+[[nodiscard("error must be checked"), gnu::nonnull(1, 2), gnu::nothrow, gnu::leaf]]
+/**
+ * Write the next sequence to play into `query`. It is a sequence that wins all rounds in the most likely assignment
+ * of enclave plays consistent with the observations, so it's never repeated and never known to lose.
+ *
+ * This is a heuristic: it's not the sequence whose outcome rules out the most assignments, and the number of games
+ * until a win is only bounded by the `3^20` sequences. See `RPS_PROPAGATION_GAMES`.
+ *
+ * @return `false` if no assignment is consistent with the observations, i.e. the enclave is not deterministic.
+ */
+bool rps_solver_next(const rps_solver_t *NONNULL solver, uint8_t query[NONNULL RPS_ROUNDS]);
+
+[[nodiscard("error must be checked"), gnu::nonnull(1, 2), gnu::nothrow, gnu::leaf]]
+/**
+ * Record that `query` got `wins` (at most `RPS_ROUNDS`), and propagate it to all prefixes of `query`.
+ *
+ * @return `false` if out of memory.
+ */
+bool rps_solver_observe(rps_solver_t *NONNULL solver, const uint8_t query[NONNULL RPS_ROUNDS], uint8_t wins);
+
+[[nodiscard("error must be checked"), gnu::nonnull(1, 2), gnu::nothrow, gnu::leaf]]
+/**
+ * Write to `prefix` the longest prefix of the solution established by the observations: each of its plays is the only
+ * one that may win its round, given that all previous rounds are wins. The plays that may win the next round are the
+ * branches of the prefix search, and the solution starts with the prefix and one of them.
+ *
+ * @return `false` if no assignment is consistent with the observations, i.e. the enclave is not deterministic.
+ */
+bool rps_solver_prefix(const rps_solver_t *NONNULL solver, rps_prefix_t *NONNULL prefix);
+
+[[nodiscard("useless call"), gnu::nonnull(1), gnu::pure, gnu::nothrow]]
+/**
+ * Number of prefixes (trie nodes) kept by `solver`, including the empty one.
+ */
+size_t rps_solver_nodes(const rps_solver_t *NONNULL solver);
+
+#endif  // APP_RPS_SOLVER_H
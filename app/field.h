@@ -0,0 +1,600 @@
+#ifndef APP_FIELD_H
+/** Arithmetic in the prime field `F_p`, with `p = 2^31 - 1`, for single values and for batches of them. */
+#define APP_FIELD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "defines.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#    include <immintrin.h>
+/** Batches can run on the AVX2 and AVX-512 backends, when the CPU supports them. */
+#    define FP_X86 1
+#else
+/** Batches always run on the scalar backend. */
+#    define FP_X86 0
+#endif
+
+/**
+ * The Mersenne prime `2^31 - 1`. All values are kept in the range `[0, FP_P)`.
+ *
+ * @see https://en.wikipedia.org/wiki/2,147,483,647
+ */
+static constexpr uint32_t FP_P = 2'147'483'647;
+static_assert(FP_P == (UINT32_C(1) << 31) - 1);
+
+[[gnu::const, nodiscard("pure function"), gnu::always_inline, gnu::hot]]
+/**
+ * Same as `value % FP_P`, for `value < 2^62`, without divisions.
+ *
+ * Since `2^31 ≡ 1 (mod p)`, adding the high bits to the low 31 bits keeps the residue. The first fold leaves less
+ * than `2^32`, the second at most `p + 1`.
+ */
+static inline uint32_t fp_reduce(uint64_t value) {
+    value = (value & FP_P) + (value >> 31);
+    value = (value & FP_P) + (value >> 31);
+    return (uint32_t) (value >= FP_P ? value - FP_P : value);
+}
+
+[[gnu::const, nodiscard("pure function"), gnu::always_inline]]
+/**
+ * Convert any integer to the range `[0, FP_P)`.
+ */
+static inline uint32_t fp_from_int(const int n) {
+    return fp_reduce((uint64_t) ((int64_t) n + 2 * (int64_t) FP_P));
+}
+
+[[gnu::const, nodiscard("pure function"), gnu::always_inline]]
+/**
+ * Converts a value in `[0, FP_P)` to its smallest signed integer representation.
+ */
+static inline int fp_to_int(const uint32_t n) {
+    static_assert(FP_P <= INT32_MAX);
+    return likely(n <= FP_P / 2) ? (int) n : (int) n - (int) FP_P;
+}
+
+[[gnu::const, nodiscard("pure function"), gnu::always_inline, gnu::hot]]
+/**
+ * Does `(a + b) % FP_P`. The sum is less than `2p`, so a single subtraction reduces it.
+ */
+static inline uint32_t fp_add(const uint32_t a, const uint32_t b) {
+    const uint32_t sum = a + b;
+    return sum >= FP_P ? sum - FP_P : sum;
+}
+
+[[gnu::const, nodiscard("pure function"), gnu::always_inline, gnu::hot]]
+/**
+ * Does `(a - b) % FP_P`, without underflowing.
+ */
+static inline uint32_t fp_sub(const uint32_t a, const uint32_t b) {
+    return a >= b ? a - b : a + FP_P - b;
+}
+
+[[gnu::const, nodiscard("pure function"), gnu::always_inline, gnu::hot]]
+/**
+ * Does `(a * b) % FP_P`. The product is less than `2^62`, see `fp_reduce`.
+ */
+static inline uint32_t fp_mul(const uint32_t a, const uint32_t b) {
+    return fp_reduce((uint64_t) a * (uint64_t) b);
+}
+
+[[gnu::const, nodiscard("pure function")]]
+/**
+ * Fast modular exponentiation `(a ** n) % FP_P`.
+ */
+static inline uint32_t fp_pow(const uint32_t a, uint32_t n) {
+    uint32_t base = a;
+    uint32_t result = 1;
+    while (n > 0) {
+        if likely (n % 2 != 0) {
+            result = fp_mul(result, base);
+        }
+        base = fp_mul(base, base);
+        n /= 2;
+    }
+    return result;
+}
+
+[[gnu::const, nodiscard("pure function")]]
+/**
+ * Fermat inverse `a^(p-2)`, so `fp_mul(a, fp_inv(a)) == 1` for any `a != 0`. Zero has no inverse, and `0` is returned.
+ */
+static inline uint32_t fp_inv(const uint32_t a) {
+    return fp_pow(a, FP_P - 2);
+}
+
+/**
+ * Coefficients of `a·x² + b·x + c (mod p)`, in `[0, FP_P)`.
+ */
+typedef struct fp_quadratic {
+    /** First coefficient, order 2. */
+    uint32_t a;
+    /** Second coefficient, order 1. */
+    uint32_t b;
+    /** Last coefficient, order 0. */
+    uint32_t c;
+} fp_quadratic_t;
+
+[[gnu::const, nodiscard("pure function")]]
+/**
+ * Quadratic interpolation in F_p
+ *
+ * We have three points `(x1,y1)`, `(x2,y2)`, `(x3,y3)`, with distinct `x` mod p, or `D` collapses to 0 and the system
+ * is singular.
+ *
+ * The parabola y ≡ a·x² + b·x + c (mod p) is unique, so we solve the 3×3 Vandermonde system with Cramer's rule,
+ * still mod p:
+ *
+ *     D  = (x1-x2)(x1-x3)(x2-x3)                         // determinant
+ *     D⁻¹ = D^(p-2) mod p                               // Fermat inverse
+ *
+ *     Na =  x1(y3-y2) + x2(y1-y3) + x3(y2-y1)
+ *     Nb =  x1²(y2-y3) + x2²(y3-y1) + x3²(y1-y2)
+ *     Nc =  x1²(x2y3-x3y2) + x2²(x3y1-x1y3) + x3²(x1y2-x2y1)
+ *
+ *     a ≡ Na · D⁻¹  (mod p)
+ *     b ≡ Nb · D⁻¹  (mod p)
+ *     c ≡ Nc · D⁻¹  (mod p)
+ */
+static inline fp_quadratic_t fp_interpolate(
+    const uint32_t x1,
+    const uint32_t y1,
+    const uint32_t x2,
+    const uint32_t y2,
+    const uint32_t x3,
+    const uint32_t y3
+) {
+    const uint32_t D = fp_mul(fp_mul(fp_sub(x1, x2), fp_sub(x1, x3)), fp_sub(x2, x3));
+    const uint32_t iD = fp_inv(D);
+
+    const uint32_t x1x1 = fp_mul(x1, x1);
+    const uint32_t x2x2 = fp_mul(x2, x2);
+    const uint32_t x3x3 = fp_mul(x3, x3);
+
+    const uint32_t Na =
+        fp_add(fp_add(fp_mul(x1, fp_sub(y3, y2)), fp_mul(x2, fp_sub(y1, y3))), fp_mul(x3, fp_sub(y2, y1)));
+    const uint32_t Nb =
+        fp_add(fp_add(fp_mul(x1x1, fp_sub(y2, y3)), fp_mul(x2x2, fp_sub(y3, y1))), fp_mul(x3x3, fp_sub(y1, y2)));
+    const uint32_t Nc = fp_add(
+        fp_add(
+            fp_mul(x1x1, fp_sub(fp_mul(x2, y3), fp_mul(x3, y2))),
+            fp_mul(x2x2, fp_sub(fp_mul(x3, y1), fp_mul(x1, y3)))
+        ),
+        fp_mul(x3x3, fp_sub(fp_mul(x1, y2), fp_mul(x2, y1)))
+    );
+
+    return (fp_quadratic_t) {.a = fp_mul(Na, iD), .b = fp_mul(Nb, iD), .c = fp_mul(Nc, iD)};
+}
+
+/**
+ * Implementations of the batch operations. All of them give the same results.
+ */
+typedef enum [[gnu::packed]] fp_backend {
+    /** Portable loops over the scalar operations, which the compiler may still vectorize. */
+    FP_BACKEND_SCALAR = 0,
+    /** 8 values per vector, with AVX2. */
+    FP_BACKEND_AVX2 = 1,
+    /** 16 values per vector, with AVX-512F. */
+    FP_BACKEND_AVX512 = 2,
+} fp_backend_t;
+
+/** Number of batch backends. */
+#define FP_BACKENDS 3
+
+[[nodiscard("useless call")]]
+/**
+ * If `backend` can run on this CPU.
+ */
+static inline bool fp_backend_supported(const fp_backend_t backend) {
+    switch (backend) {
+        case FP_BACKEND_SCALAR:
+            return true;
+#if FP_X86
+        case FP_BACKEND_AVX2:
+            return __builtin_cpu_supports("avx2");
+        case FP_BACKEND_AVX512:
+            return __builtin_cpu_supports("avx512f");
+#endif
+        default:
+            return false;
+    }
+}
+
+[[nodiscard("useless call")]]
+/**
+ * The widest backend supported by this CPU.
+ */
+static inline fp_backend_t fp_backend_best(void) {
+    if (fp_backend_supported(FP_BACKEND_AVX512)) {
+        return FP_BACKEND_AVX512;
+    } else if (fp_backend_supported(FP_BACKEND_AVX2)) {
+        return FP_BACKEND_AVX2;
+    }
+    return FP_BACKEND_SCALAR;
+}
+
+[[gnu::nonnull(1, 2, 3), gnu::hot]]
+/**
+ * `out[i] = (a[i] + b[i]) % FP_P`, one value at a time.
+ */
+static inline void fp_add_batch_scalar(
+    uint32_t out[NONNULL],
+    const uint32_t a[NONNULL],
+    const uint32_t b[NONNULL],
+    const size_t n
+) {
+    for (size_t i = 0; i < n; i++) {
+        out[i] = fp_add(a[i], b[i]);
+    }
+}
+
+[[gnu::nonnull(1, 2, 3), gnu::hot]]
+/**
+ * `out[i] = (a[i] - b[i]) % FP_P`, one value at a time.
+ */
+static inline void fp_sub_batch_scalar(
+    uint32_t out[NONNULL],
+    const uint32_t a[NONNULL],
+    const uint32_t b[NONNULL],
+    const size_t n
+) {
+    for (size_t i = 0; i < n; i++) {
+        out[i] = fp_sub(a[i], b[i]);
+    }
+}
+
+[[gnu::nonnull(1, 2, 3), gnu::hot]]
+/**
+ * `out[i] = (a[i] * b[i]) % FP_P`, one value at a time.
+ */
+static inline void fp_mul_batch_scalar(
+    uint32_t out[NONNULL],
+    const uint32_t a[NONNULL],
+    const uint32_t b[NONNULL],
+    const size_t n
+) {
+    for (size_t i = 0; i < n; i++) {
+        out[i] = fp_mul(a[i], b[i]);
+    }
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(1, 2), gnu::hot]]
+/**
+ * Montgomery's batch inversion: `out[i] = fp_inv(in[i])` with a single exponentiation and `3(n - 1)` multiplications.
+ *
+ * The prefix products `in[0] · ... · in[i]` are written to `out`, and the inverse of the full product is then
+ * multiplied by the previous prefix and by `in[i]`, from the last value to the first.
+ *
+ * @return `false` if any value is zero, leaving `out` unspecified.
+ */
+static inline bool fp_inv_batch_scalar(uint32_t *restrict NONNULL out, const uint32_t *restrict NONNULL in, size_t n) {
+    if unlikely (n == 0) {
+        return true;
+    }
+
+    uint32_t product = 1;
+    for (size_t i = 0; i < n; i++) {
+        product = fp_mul(product, in[i]);
+        out[i] = product;
+    }
+    if unlikely (product == 0) {
+        return false;
+    }
+
+    uint32_t inverse = fp_inv(product);
+    for (size_t i = n - 1; i > 0; i--) {
+        out[i] = fp_mul(inverse, out[i - 1]);
+        inverse = fp_mul(inverse, in[i]);
+    }
+    out[0] = inverse;
+    return true;
+}
+
+#if FP_X86
+[[gnu::const, nodiscard("pure function"), gnu::always_inline, gnu::target("avx2")]]
+/**
+ * Same as `fp_add`, on 8 lanes. The sum fits in 32 bits, and `min(s, s - p)` picks `s - p` unless it wrapped around.
+ */
+static inline __m256i fp_add_avx2(const __m256i a, const __m256i b) {
+    const __m256i sum = _mm256_add_epi32(a, b);
+    return _mm256_min_epu32(sum, _mm256_sub_epi32(sum, _mm256_set1_epi32((int) FP_P)));
+}
+
+[[gnu::const, nodiscard("pure function"), gnu::always_inline, gnu::target("avx2")]]
+/**
+ * Same as `fp_sub`, on 8 lanes. `min(d, d + p)` picks `d + p` only when `a - b` wrapped around.
+ */
+static inline __m256i fp_sub_avx2(const __m256i a, const __m256i b) {
+    const __m256i difference = _mm256_sub_epi32(a, b);
+    return _mm256_min_epu32(difference, _mm256_add_epi32(difference, _mm256_set1_epi32((int) FP_P)));
+}
+
+[[gnu::const, nodiscard("pure function"), gnu::always_inline, gnu::target("avx2")]]
+/**
+ * Same as `fp_mul`, on 8 lanes. `vpmuludq` multiplies the even lanes, and the odd lanes after a shift. A single fold
+ * of each product is less than `2p`, so it fits back in 32 bits and is reduced like `fp_add_avx2`.
+ */
+static inline __m256i fp_mul_avx2(const __m256i a, const __m256i b) {
+    const __m256i mask = _mm256_set1_epi64x((long long) FP_P);
+    const __m256i even = _mm256_mul_epu32(a, b);
+    const __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(a, 32), _mm256_srli_epi64(b, 32));
+
+    const __m256i even_fold = _mm256_add_epi64(_mm256_and_si256(even, mask), _mm256_srli_epi64(even, 31));
+    const __m256i odd_fold = _mm256_add_epi64(_mm256_and_si256(odd, mask), _mm256_srli_epi64(odd, 31));
+    const __m256i fold = _mm256_blend_epi32(even_fold, _mm256_slli_epi64(odd_fold, 32), 0xAA);
+    return _mm256_min_epu32(fold, _mm256_sub_epi32(fold, _mm256_set1_epi32((int) FP_P)));
+}
+
+[[gnu::const, nodiscard("pure function"), gnu::always_inline, gnu::target("avx512f")]]
+/**
+ * Same as `fp_add_avx2`, on 16 lanes.
+ */
+static inline __m512i fp_add_avx512(const __m512i a, const __m512i b) {
+    const __m512i sum = _mm512_add_epi32(a, b);
+    return _mm512_min_epu32(sum, _mm512_sub_epi32(sum, _mm512_set1_epi32((int) FP_P)));
+}
+
+[[gnu::const, nodiscard("pure function"), gnu::always_inline, gnu::target("avx512f")]]
+/**
+ * Same as `fp_sub_avx2`, on 16 lanes.
+ */
+static inline __m512i fp_sub_avx512(const __m512i a, const __m512i b) {
+    const __m512i difference = _mm512_sub_epi32(a, b);
+    return _mm512_min_epu32(difference, _mm512_add_epi32(difference, _mm512_set1_epi32((int) FP_P)));
+}
+
+[[gnu::const, nodiscard("pure function"), gnu::always_inline, gnu::target("avx512f")]]
+/**
+ * Same as `fp_mul_avx2`, on 16 lanes.
+ */
+static inline __m512i fp_mul_avx512(const __m512i a, const __m512i b) {
+    const __m512i mask = _mm512_set1_epi64((long long) FP_P);
+    const __m512i even = _mm512_mul_epu32(a, b);
+    const __m512i odd = _mm512_mul_epu32(_mm512_srli_epi64(a, 32), _mm512_srli_epi64(b, 32));
+
+    const __m512i even_fold = _mm512_add_epi64(_mm512_and_si512(even, mask), _mm512_srli_epi64(even, 31));
+    const __m512i odd_fold = _mm512_add_epi64(_mm512_and_si512(odd, mask), _mm512_srli_epi64(odd, 31));
+    const __m512i fold = _mm512_mask_blend_epi32(0xAAAA, even_fold, _mm512_slli_epi64(odd_fold, 32));
+    return _mm512_min_epu32(fold, _mm512_sub_epi32(fold, _mm512_set1_epi32((int) FP_P)));
+}
+
+/**
+ * Define `fp_OP_batch_BACKEND`, which applies the vector `fp_OP_BACKEND` to `lanes` values at a time, and the scalar
+ * `fp_OP` to the tail.
+ */
+#    define FP_DEFINE_BATCH(op, backend, isa, vector, lanes, load, store)         \
+        [[gnu::nonnull(1, 2, 3), gnu::hot, gnu::target(isa)]]                     \
+        static inline void fp_##op##_batch_##backend(                             \
+            uint32_t out[NONNULL],                                                \
+            const uint32_t a[NONNULL],                                            \
+            const uint32_t b[NONNULL],                                            \
+            const size_t n                                                        \
+        ) {                                                                       \
+            size_t i = 0;                                                         \
+            for (; i + (lanes) <= n; i += (lanes)) {                              \
+                const vector va = load((const vector *) &a[i]);                   \
+                const vector vb = load((const vector *) &b[i]);                   \
+                store((vector *) &out[i], fp_##op##_##backend(va, vb));           \
+            }                                                                     \
+            for (; i < n; i++) {                                                  \
+                out[i] = fp_##op(a[i], b[i]);                                     \
+            }                                                                     \
+        }
+
+/**
+ * Define `fp_inv_batch_BACKEND`, Montgomery's batch inversion on `lanes` independent chains.
+ *
+ * Lane `j` multiplies `in[j]`, `in[j + lanes]`, ... so each row of `lanes` values costs one vector multiplication on
+ * the way forward and two on the way back. The lane products and the tail are inverted together by
+ * `fp_inv_batch_scalar`, which makes the only exponentiation.
+ */
+#    define FP_DEFINE_INV_BATCH(backend, isa, vector, lanes, load, store, set1)                                \
+        [[nodiscard("error must be checked"), gnu::nonnull(1, 2), gnu::hot, gnu::target(isa)]]                 \
+        static inline bool fp_inv_batch_##backend(                                                             \
+            uint32_t *restrict NONNULL out,                                                                    \
+            const uint32_t *restrict NONNULL in,                                                               \
+            const size_t n                                                                                     \
+        ) {                                                                                                    \
+            const size_t tail = n % (lanes);                                                                   \
+            const size_t head = n - tail;                                                                      \
+            const vector one = set1(1);                                                                        \
+                                                                                                               \
+            vector product = one;                                                                              \
+            for (size_t i = 0; i < head; i += (lanes)) {                                                       \
+                product = fp_mul_##backend(product, load((const vector *) &in[i]));                            \
+                store((vector *) &out[i], product);                                                            \
+            }                                                                                                  \
+                                                                                                               \
+            uint32_t rest[2 * (lanes)];                                                                        \
+            uint32_t rest_inverse[2 * (lanes)];                                                                \
+            store((vector *) rest, product);                                                                   \
+            memcpy(&rest[(lanes)], &in[head], tail * sizeof(uint32_t));                                        \
+            if unlikely (!fp_inv_batch_scalar(rest_inverse, rest, (lanes) + tail)) {                           \
+                return false;                                                                                  \
+            }                                                                                                  \
+            memcpy(&out[head], &rest_inverse[(lanes)], tail * sizeof(uint32_t));                               \
+                                                                                                               \
+            vector inverse = load((const vector *) rest_inverse);                                              \
+            for (size_t i = head; i > 0; i -= (lanes)) {                                                       \
+                const size_t row = i - (lanes);                                                                \
+                const vector previous = likely(row > 0) ? load((const vector *) &out[row - (lanes)]) : one;    \
+                const vector value = load((const vector *) &in[row]);                                          \
+                store((vector *) &out[row], fp_mul_##backend(inverse, previous));                              \
+                inverse = fp_mul_##backend(inverse, value);                                                    \
+            }                                                                                                  \
+            return true;                                                                                       \
+        }
+
+FP_DEFINE_BATCH(add, avx2, "avx2", __m256i, 8, _mm256_loadu_si256, _mm256_storeu_si256)
+FP_DEFINE_BATCH(sub, avx2, "avx2", __m256i, 8, _mm256_loadu_si256, _mm256_storeu_si256)
+FP_DEFINE_BATCH(mul, avx2, "avx2", __m256i, 8, _mm256_loadu_si256, _mm256_storeu_si256)
+FP_DEFINE_INV_BATCH(avx2, "avx2", __m256i, 8, _mm256_loadu_si256, _mm256_storeu_si256, _mm256_set1_epi32)
+
+FP_DEFINE_BATCH(add, avx512, "avx512f", __m512i, 16, _mm512_loadu_si512, _mm512_storeu_si512)
+FP_DEFINE_BATCH(sub, avx512, "avx512f", __m512i, 16, _mm512_loadu_si512, _mm512_storeu_si512)
+FP_DEFINE_BATCH(mul, avx512, "avx512f", __m512i, 16, _mm512_loadu_si512, _mm512_storeu_si512)
+FP_DEFINE_INV_BATCH(avx512, "avx512f", __m512i, 16, _mm512_loadu_si512, _mm512_storeu_si512, _mm512_set1_epi32)
+
+#    undef FP_DEFINE_BATCH
+#    undef FP_DEFINE_INV_BATCH
+
+/** Call `function_BACKEND` with the given arguments. */
+#    define FP_DISPATCH(backend, function, ...)                                     \
+        ((backend) == FP_BACKEND_AVX512 ? function##_avx512(__VA_ARGS__)            \
+         : (backend) == FP_BACKEND_AVX2 ? function##_avx2(__VA_ARGS__)              \
+                                        : function##_scalar(__VA_ARGS__))
+#else
+/** Call `function_BACKEND` with the given arguments. */
+#    define FP_DISPATCH(backend, function, ...) ((void) (backend), function##_scalar(__VA_ARGS__))
+#endif
+
+[[gnu::nonnull(2, 3, 4), gnu::hot]]
+/**
+ * `out[i] = (a[i] + b[i]) % FP_P` on `backend`, which must be supported. `out` may be the same array as `a` or `b`.
+ */
+static inline void fp_add_batch(
+    const fp_backend_t backend,
+    uint32_t out[NONNULL],
+    const uint32_t a[NONNULL],
+    const uint32_t b[NONNULL],
+    const size_t n
+) {
+    FP_DISPATCH(backend, fp_add_batch, out, a, b, n);
+}
+
+[[gnu::nonnull(2, 3, 4), gnu::hot]]
+/**
+ * `out[i] = (a[i] - b[i]) % FP_P` on `backend`, which must be supported. `out` may be the same array as `a` or `b`.
+ */
+static inline void fp_sub_batch(
+    const fp_backend_t backend,
+    uint32_t out[NONNULL],
+    const uint32_t a[NONNULL],
+    const uint32_t b[NONNULL],
+    const size_t n
+) {
+    FP_DISPATCH(backend, fp_sub_batch, out, a, b, n);
+}
+
+[[gnu::nonnull(2, 3, 4), gnu::hot]]
+/**
+ * `out[i] = (a[i] * b[i]) % FP_P` on `backend`, which must be supported. `out` may be the same array as `a` or `b`.
+ */
+static inline void fp_mul_batch(
+    const fp_backend_t backend,
+    uint32_t out[NONNULL],
+    const uint32_t a[NONNULL],
+    const uint32_t b[NONNULL],
+    const size_t n
+) {
+    FP_DISPATCH(backend, fp_mul_batch, out, a, b, n);
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(2, 3), gnu::hot]]
+/**
+ * `out[i] = fp_inv(in[i])` on `backend`, which must be supported, with Montgomery's batch inversion. `out` and `in`
+ * must not overlap.
+ *
+ * @return `false` if any value is zero, leaving `out` unspecified.
+ */
+static inline bool fp_inv_batch(
+    const fp_backend_t backend,
+    uint32_t *restrict NONNULL out,
+    const uint32_t *restrict NONNULL in,
+    const size_t n
+) {
+    return FP_DISPATCH(backend, fp_inv_batch, out, in, n);
+}
+
+/** Interpolations solved together by `fp_interpolate_batch`, sized for its temporaries to stay in L1. */
+static constexpr size_t FP_CHUNK = 256;
+
+[[nodiscard("error must be checked"), gnu::nonnull(2, 3, 4), gnu::hot]]
+/**
+ * Same as `fp_interpolate` for `n` problems at once, with the batch operations of `backend`, which must be supported.
+ *
+ * The columns are `x[k][i]` and `y[k][i]` for point `k` of problem `i`, and the coefficients `a`, `b` and `c` of
+ * problem `i` are written to `coefficients[0][i]`, `coefficients[1][i]` and `coefficients[2][i]`, which must not
+ * overlap the points. All determinants of a chunk of `FP_CHUNK` problems are inverted with a single `fp_inv_batch`.
+ *
+ * @return `false` if some problem has repeated `x`, leaving the coefficients unspecified.
+ */
+static inline bool fp_interpolate_batch(
+    const fp_backend_t backend,
+    uint32_t *const NONNULL coefficients[NONNULL 3],
+    const uint32_t *const NONNULL x[NONNULL 3],
+    const uint32_t *const NONNULL y[NONNULL 3],
+    const size_t n
+) {
+    uint32_t D[FP_CHUNK], iD[FP_CHUNK];
+    uint32_t x1x1[FP_CHUNK], x2x2[FP_CHUNK], x3x3[FP_CHUNK];
+    uint32_t sum[FP_CHUNK], t[FP_CHUNK], u[FP_CHUNK];
+
+    for (size_t first = 0; first < n; first += FP_CHUNK) {
+        const size_t m = likely(n - first > FP_CHUNK) ? FP_CHUNK : n - first;
+        const uint32_t *NONNULL x1 = &x[0][first];
+        const uint32_t *NONNULL x2 = &x[1][first];
+        const uint32_t *NONNULL x3 = &x[2][first];
+        const uint32_t *NONNULL y1 = &y[0][first];
+        const uint32_t *NONNULL y2 = &y[1][first];
+        const uint32_t *NONNULL y3 = &y[2][first];
+
+        // D = (x1-x2)(x1-x3)(x2-x3)
+        fp_sub_batch(backend, t, x1, x2, m);
+        fp_sub_batch(backend, u, x1, x3, m);
+        fp_mul_batch(backend, D, t, u, m);
+        fp_sub_batch(backend, t, x2, x3, m);
+        fp_mul_batch(backend, D, D, t, m);
+        if unlikely (!fp_inv_batch(backend, iD, D, m)) {
+            return false;
+        }
+
+        fp_mul_batch(backend, x1x1, x1, x1, m);
+        fp_mul_batch(backend, x2x2, x2, x2, m);
+        fp_mul_batch(backend, x3x3, x3, x3, m);
+
+        // Na = x1(y3-y2) + x2(y1-y3) + x3(y2-y1)
+        fp_sub_batch(backend, t, y3, y2, m);
+        fp_mul_batch(backend, sum, x1, t, m);
+        fp_sub_batch(backend, t, y1, y3, m);
+        fp_mul_batch(backend, t, x2, t, m);
+        fp_add_batch(backend, sum, sum, t, m);
+        fp_sub_batch(backend, t, y2, y1, m);
+        fp_mul_batch(backend, t, x3, t, m);
+        fp_add_batch(backend, sum, sum, t, m);
+        fp_mul_batch(backend, &coefficients[0][first], sum, iD, m);
+
+        // Nb = x1²(y2-y3) + x2²(y3-y1) + x3²(y1-y2)
+        fp_sub_batch(backend, t, y2, y3, m);
+        fp_mul_batch(backend, sum, x1x1, t, m);
+        fp_sub_batch(backend, t, y3, y1, m);
+        fp_mul_batch(backend, t, x2x2, t, m);
+        fp_add_batch(backend, sum, sum, t, m);
+        fp_sub_batch(backend, t, y1, y2, m);
+        fp_mul_batch(backend, t, x3x3, t, m);
+        fp_add_batch(backend, sum, sum, t, m);
+        fp_mul_batch(backend, &coefficients[1][first], sum, iD, m);
+
+        // Nc = x1²(x2y3-x3y2) + x2²(x3y1-x1y3) + x3²(x1y2-x2y1)
+        fp_mul_batch(backend, t, x2, y3, m);
+        fp_mul_batch(backend, u, x3, y2, m);
+        fp_sub_batch(backend, t, t, u, m);
+        fp_mul_batch(backend, sum, x1x1, t, m);
+        fp_mul_batch(backend, t, x3, y1, m);
+        fp_mul_batch(backend, u, x1, y3, m);
+        fp_sub_batch(backend, t, t, u, m);
+        fp_mul_batch(backend, t, x2x2, t, m);
+        fp_add_batch(backend, sum, sum, t, m);
+        fp_mul_batch(backend, t, x1, y2, m);
+        fp_mul_batch(backend, u, x2, y1, m);
+        fp_sub_batch(backend, t, t, u, m);
+        fp_mul_batch(backend, t, x3x3, t, m);
+        fp_add_batch(backend, sum, sum, t, m);
+        fp_mul_batch(backend, &coefficients[2][first], sum, iD, m);
+    }
+    return true;
+}
+
+#endif  // APP_FIELD_H
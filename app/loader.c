@@ -0,0 +1,63 @@
+#include <sgx_eid.h>
+#include <sgx_error.h>
+#include <sgx_urts.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "./loader.h"
+#include "./stats.h"
+#include "./writer.h"
+#include "app_config.h"
+#include "defines.h"
+
+#if SWITCHLESS
+#    include <sgx_uswitchless.h>
+
+[[nodiscard("error must be checked"), gnu::nonnull(1, 2), gnu::cold]]
+/**
+ * Load the enclave with `SWITCHLESS_WORKERS` untrusted threads serving OCALLs marked `transition_using_threads`.
+ * No trusted workers are started, since all ECALLs are regular ones.
+ */
+static sgx_status_t load_switchless(const char *NONNULL file, sgx_enclave_id_t *NONNULL eid) {
+    sgx_uswitchless_config_t config = SGX_USWITCHLESS_CONFIG_INITIALIZER;
+    config.num_uworkers = SWITCHLESS_WORKERS;
+    config.num_tworkers = 0;
+    config.retries_before_fallback = SWITCHLESS_RETRIES_BEFORE_FALLBACK;
+    config.retries_before_sleep = SWITCHLESS_RETRIES_BEFORE_SLEEP;
+
+    const void *features[32] = {};
+    features[SGX_CREATE_ENCLAVE_EX_SWITCHLESS_BIT_IDX] = &config;
+
+    return STATS_CALL(
+        sgx_create_enclave_ex,
+        file,
+        SGX_DEBUG_FLAG,
+        NULL,
+        NULL,
+        eid,
+        NULL,
+        SGX_CREATE_ENCLAVE_EX_SWITCHLESS,
+        features
+    );
+}
+#endif
+
+/**
+ * Load the signed enclave in `file` into `eid`, with switchless OCALLs when `SWITCHLESS` is enabled.
+ *
+ * Enclaves that can't initialize switchless calls, like the pre-compiled one, are loaded without them.
+ */
+sgx_status_t load_enclave(const char *NONNULL file, sgx_enclave_id_t *NONNULL eid) {
+#if SWITCHLESS
+    const sgx_status_t status = load_switchless(file, eid);
+    if likely (status == SGX_SUCCESS) {
+        return SGX_SUCCESS;
+    }
+#    ifdef DEBUG
+    writer_printf("[DEBUG] load_enclave: switchless calls unavailable, status=0x%04x\n", status);
+#    endif
+#endif
+
+    /* Debug Support: set 2nd parameter to 1 */
+    return STATS_CALL(sgx_create_enclave, file, SGX_DEBUG_FLAG, NULL, NULL, eid, NULL);
+}
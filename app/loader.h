@@ -0,0 +1,18 @@
+#ifndef APP_LOADER_H
+/** Enclave creation, with the configured SGX extensions. */
+#define APP_LOADER_H
+
+#include <sgx_eid.h>
+#include <sgx_error.h>
+
+#include "defines.h"
+
+[[nodiscard("error must be checked"), gnu::nonnull(1, 2), gnu::cold]]
+/**
+ * Load the signed enclave in `file` into `eid`, with switchless OCALLs when `SWITCHLESS` is enabled.
+ *
+ * Enclaves that can't initialize switchless calls, like the pre-compiled one, are loaded without them.
+ */
+sgx_status_t load_enclave(const char *NONNULL file, sgx_enclave_id_t *NONNULL eid);
+
+#endif  // APP_LOADER_H
@@ -0,0 +1,267 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "./writer.h"
+#include "defines.h"
+#include "enclave_u.h"
+#include "log_format.h"
+
+/** Format string of each `log_format_id_t`. */
+static const char *NONNULL const FORMATS[LOG_FORMAT_COUNT] = {
+#define LOG_FORMAT_STRING(name, format) [LOG_##name] = format,
+    LOG_FORMATS(LOG_FORMAT_STRING)
+#undef LOG_FORMAT_STRING
+};
+
+/**
+ * Reader for the packed bytes of a record.
+ */
+typedef struct reader {
+    /** Next byte to read. */
+    const uint8_t *NONNULL pos;
+    /** End of the record. */
+    const uint8_t *NONNULL end;
+} reader_t;
+
+[[nodiscard("error must be checked"), gnu::nonnull(1, 2)]]
+/**
+ * Copy the next `size` bytes of the record into `output`.
+ *
+ * @return `false` if the record is too short.
+ */
+static bool read_bytes(reader_t *NONNULL reader, void *NONNULL output, const size_t size) {
+    if unlikely ((size_t) (reader->end - reader->pos) < size) {
+        return false;
+    }
+    memcpy(output, reader->pos, size);
+    reader->pos += size;
+    return true;
+}
+
+/**
+ * A formatted line, limited to `BUFSIZ` bytes.
+ */
+typedef struct line {
+    /** Bytes written to `text`, without the NUL terminator. */
+    size_t len;
+    /** NUL-terminated output. */
+    char text[BUFSIZ];
+} line_t;
+
+[[gnu::nonnull(1, 2)]]
+/**
+ * Append a `printf`-like conversion to the line, truncating on overflow.
+ */
+static void line_printf(line_t *NONNULL line, const char *NONNULL fmt, ...) {
+    if unlikely (line->len >= BUFSIZ - 1) {
+        return;
+    }
+
+    va_list ap;
+    va_start(ap, fmt);
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+    const int written = vsnprintf(&(line->text[line->len]), BUFSIZ - line->len, fmt, ap);
+#pragma GCC diagnostic pop
+    va_end(ap);
+
+    if likely (written > 0) {
+        line->len += (size_t) written;
+        if unlikely (line->len >= BUFSIZ - 1) {
+            line->len = BUFSIZ - 1;
+        }
+    }
+}
+
+/** Maximum length of a single conversion specification. */
+static constexpr size_t MAX_SPEC = 32;
+
+[[nodiscard("error must be checked"), gnu::nonnull(1, 2, 3)]]
+/**
+ * Format the conversion at `*fmt` (just after the `%`) with the next argument of the record, advancing `*fmt`.
+ *
+ * Length modifiers are replaced according to the stored argument kind, so any integer width can be printed.
+ *
+ * @return `false` if the conversion is invalid or doesn't match the record.
+ */
+static bool format_conversion(line_t *NONNULL line, const char *NONNULL *NONNULL fmt, reader_t *NONNULL reader) {
+    // '%', the prefix, up to two length modifiers, the conversion and the NUL
+    char spec[1 + MAX_SPEC + 2 + 1 + 1] = "%";
+    size_t len = 1;
+
+    const char *NONNULL pos = *fmt;
+    const size_t flags = strspn(pos, "-+ #0");
+    const size_t width = strspn(&(pos[flags]), "0123456789");
+    size_t precision = 0;
+    if (pos[flags + width] == '.') {
+        precision = 1 + strspn(&(pos[flags + width + 1]), "0123456789");
+    }
+    const size_t prefix = flags + width + precision;
+    if unlikely (prefix > MAX_SPEC) {
+        return false;
+    }
+    memcpy(&(spec[len]), pos, prefix);
+    len += prefix;
+    pos += prefix;
+
+    // drop the original length modifier
+    pos += strspn(pos, "hlLqjzt");
+    const char conversion = *pos;
+    if unlikely (conversion == '\0') {
+        return false;
+    }
+    *fmt = pos + 1;
+
+    log_arg_kind_t kind = 0;
+    if unlikely (!read_bytes(reader, &kind, sizeof(kind))) {
+        return false;
+    }
+
+    if (kind == LOG_ARG_STRING) {
+        if unlikely (conversion != 's') {
+            return false;
+        }
+        uint16_t length = 0;
+        char str[LOG_STRING_MAX + 1] = "";
+        if unlikely (!read_bytes(reader, &length, sizeof(length)) || length > LOG_STRING_MAX) {
+            return false;
+        }
+        if unlikely (!read_bytes(reader, str, length)) {
+            return false;
+        }
+        str[length] = '\0';
+
+        spec[len++] = 's';
+        spec[len] = '\0';
+        line_printf(line, spec, str);
+        return true;
+    }
+
+    uint64_t value = 0;
+    if unlikely (!read_bytes(reader, &value, sizeof(value))) {
+        return false;
+    }
+
+    switch (conversion) {
+        case 'd':
+        case 'i':
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+            if unlikely (kind != LOG_ARG_INT && kind != LOG_ARG_UINT) {
+                return false;
+            }
+            spec[len++] = 'l';
+            spec[len++] = 'l';
+            spec[len++] = conversion;
+            spec[len] = '\0';
+            if (conversion == 'd' || conversion == 'i') {
+                line_printf(line, spec, (long long) (int64_t) value);
+            } else {
+                line_printf(line, spec, (unsigned long long) value);
+            }
+            return true;
+        case 'c':
+            if unlikely (kind != LOG_ARG_INT && kind != LOG_ARG_UINT) {
+                return false;
+            }
+            spec[len++] = 'c';
+            spec[len] = '\0';
+            line_printf(line, spec, (int) (unsigned char) value);
+            return true;
+        case 'f':
+        case 'F':
+        case 'e':
+        case 'E':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            if unlikely (kind != LOG_ARG_DOUBLE) {
+                return false;
+            } else {
+                double number = 0.0;
+                memcpy(&number, &value, sizeof(number));
+                spec[len++] = conversion;
+                spec[len] = '\0';
+                line_printf(line, spec, number);
+                return true;
+            }
+        default:
+            return false;
+    }
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(1, 2)]]
+/**
+ * Format a single record into `line`, using the app side format string.
+ *
+ * @return `false` if the record is invalid.
+ */
+static bool format_record(line_t *NONNULL line, reader_t *NONNULL reader, const uint16_t format) {
+    if unlikely (format >= LOG_FORMAT_COUNT) {
+        return false;
+    }
+
+    const char *NONNULL fmt = FORMATS[format];
+    while (*fmt != '\0') {
+        const char *NULLABLE next = strchr(fmt, '%');
+        if (next == NULL) {
+            line_printf(line, "%s", fmt);
+            break;
+        }
+        line_printf(line, "%.*s", (int) (next - fmt), fmt);
+
+        fmt = next + 1;
+        if (*fmt == '%') {
+            line_printf(line, "%%");
+            fmt++;
+            continue;
+        }
+
+        const bool ok = format_conversion(line, &fmt, reader);
+        if unlikely (!ok) {
+            return false;
+        }
+    }
+    // unused arguments mean the format doesn't match the record
+    return reader->pos == reader->end;
+}
+
+/**
+ * OCALL called by the enclave with packed log records, which are formatted and printed to the terminal.
+ **/
+void ocall_log_flush(const uint8_t *NULLABLE records, const size_t len) {
+    if unlikely (records == NULL) {
+        return;
+    }
+
+    const uint8_t *NONNULL pos = records;
+    const uint8_t *NONNULL const end = &(records[len]);
+    while (pos < end) {
+        log_record_header_t header = {0};
+        if unlikely ((size_t) (end - pos) < sizeof(header)) {
+            (void) fprintf(stderr, "[LOG] truncated record\n");
+            return;
+        }
+        memcpy(&header, pos, sizeof(header));
+        if unlikely (header.size < sizeof(header) || header.size > (size_t) (end - pos)) {
+            (void) fprintf(stderr, "[LOG] invalid record size: %u\n", (unsigned) header.size);
+            return;
+        }
+
+        reader_t reader = {.pos = &(pos[sizeof(header)]), .end = &(pos[header.size])};
+        line_t line = {.len = 0, .text = ""};
+        const bool ok = format_record(&line, &reader, header.format);
+        if likely (ok) {
+            writer_write(line.text, line.len);
+        } else {
+            (void) fprintf(stderr, "[LOG] invalid record for format %u\n", (unsigned) header.format);
+        }
+        pos += header.size;
+    }
+}
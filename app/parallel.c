@@ -0,0 +1,154 @@
+#include <pthread.h>
+#include <sgx_eid.h>
+#include <sgx_error.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "./parallel.h"
+#include "./writer.h"
+#include "app_config.h"
+#include "defines.h"
+
+/** Threads that may be inside the enclave at the same time, never more than its TCS. */
+static constexpr size_t ECALL_SLOTS = APP_THREADS < TCS_NUM ? APP_THREADS : TCS_NUM;
+static_assert(ECALL_SLOTS > 0);
+
+/**
+ * Slots not taken by any thread. The main thread holds one, and each thread started by `parallel_run` holds another
+ * until its task returns, so nested runs only start threads that the outer ones left free.
+ */
+static size_t free_slots = ECALL_SLOTS - 1;
+
+[[nodiscard("slot must be released")]]
+/**
+ * Take a free slot for a new thread, if there is any.
+ */
+static bool slot_acquire(void) {
+    size_t current = __atomic_load_n(&free_slots, __ATOMIC_RELAXED);
+    while (current > 0) {
+        if (__atomic_compare_exchange_n(&free_slots, &current, current - 1, true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Return a slot taken by `slot_acquire`.
+ */
+static void slot_release(void) {
+    (void) __atomic_fetch_add(&free_slots, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Arguments and result for a single `parallel_run` thread.
+ */
+typedef struct worker {
+    /** Shared enclave. */
+    sgx_enclave_id_t eid;
+    /** Shared task. */
+    parallel_task_fn *NONNULL task;
+    /** Shared task context. */
+    void *NULLABLE context;
+    /** Index of this thread. */
+    size_t index;
+    /** Total number of threads. */
+    size_t threads;
+    /** Result of the task. */
+    sgx_status_t status;
+    /** If the thread was started and must be joined. */
+    bool started;
+    /** If the thread holds an ECALL slot, released when its task returns. */
+    bool slot;
+    /** Output capture of the calling thread, shared by the worker. */
+    writer_capture_t *NULLABLE capture;
+} worker_t;
+
+[[gnu::nonnull(1)]]
+/**
+ * Thread entry: run the task for a single worker.
+ */
+static void *NULLABLE worker_run(void *NONNULL arg) {
+    worker_t *NONNULL worker = (worker_t *) arg;
+    writer_capture_set(worker->capture);
+    worker->status = worker->task(worker->eid, worker->context, worker->index, worker->threads);
+    if (worker->slot) {
+        slot_release();
+    }
+    return NULL;
+}
+
+/**
+ * Run `task` on `threads` concurrent threads, all sharing `eid` and `context`. The calling thread runs index 0, and
+ * indices without a free ECALL slot, or whose thread could not be started, also run on the calling thread, after the
+ * others.
+ *
+ * @return `SGX_SUCCESS` if all tasks succeeded, or the error of the task with the smallest index.
+ */
+sgx_status_t parallel_run(
+    const sgx_enclave_id_t eid,
+    const size_t threads,
+    parallel_task_fn *NONNULL task,
+    void *NULLABLE context
+) {
+    if unlikely (threads <= 1) {
+        return task(eid, context, 0, 1);
+    }
+
+    worker_t *NULLABLE workers = calloc(threads, sizeof(worker_t));
+    pthread_t *NULLABLE handles = calloc(threads, sizeof(pthread_t));
+    if unlikely (workers == NULL || handles == NULL) {
+        free(workers);
+        free(handles);
+        return SGX_ERROR_OUT_OF_MEMORY;
+    }
+
+    writer_capture_t *NULLABLE capture = writer_capture_get();
+    for (size_t i = 0; i < threads; i++) {
+        workers[i] = (worker_t) {
+            .eid = eid,
+            .task = task,
+            .context = context,
+            .index = i,
+            .threads = threads,
+            .status = SGX_ERROR_UNEXPECTED,
+            .started = false,
+            .slot = false,
+            .capture = capture,
+        };
+    }
+    for (size_t i = 1; i < threads && slot_acquire(); i++) {
+        workers[i].slot = true;
+        workers[i].started = pthread_create(&handles[i], NULL, worker_run, &workers[i]) == 0;
+        if unlikely (!workers[i].started) {
+            // the task runs inline, on the slot of the calling thread
+            workers[i].slot = false;
+            slot_release();
+#ifdef DEBUG
+            writer_printf("[DEBUG] parallel_run: failed to start thread %zu, running it inline\n", i);
+#endif
+        }
+    }
+
+    (void) worker_run(&workers[0]);
+    for (size_t i = 1; i < threads; i++) {
+        if likely (workers[i].started) {
+            (void) pthread_join(handles[i], NULL);
+        } else {
+            (void) worker_run(&workers[i]);
+        }
+    }
+
+    sgx_status_t status = SGX_SUCCESS;
+    for (size_t i = 0; i < threads; i++) {
+        if unlikely (workers[i].status != SGX_SUCCESS) {
+            status = workers[i].status;
+            break;
+        }
+    }
+
+    free(workers);
+    free(handles);
+    return status;
+}
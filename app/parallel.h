@@ -0,0 +1,45 @@
+#ifndef APP_PARALLEL_H
+/** Concurrent ECALLs from multiple app threads, sharing the same enclave. */
+#define APP_PARALLEL_H
+
+#include <sched.h>
+#include <sgx_eid.h>
+#include <sgx_error.h>
+#include <stddef.h>
+
+#include "defines.h"
+
+/**
+ * Repeat an ECALL while all enclave threads (TCS) are busy, yielding between attempts. Evaluates to the final status.
+ * `parallel_run` keeps the app threads within the TCS, so this is only a fallback.
+ */
+#define ECALL_RETRY(call)                                              \
+    ({                                                                 \
+        sgx_status_t ecall_retry_status_ = (call);                     \
+        while unlikely (ecall_retry_status_ == SGX_ERROR_OUT_OF_TCS) { \
+            (void) sched_yield();                                      \
+            ecall_retry_status_ = (call);                              \
+        }                                                              \
+        ecall_retry_status_;                                           \
+    })
+
+/**
+ * Work for thread `index` (from 0) of `threads` concurrent threads.
+ */
+typedef sgx_status_t parallel_task_fn(sgx_enclave_id_t eid, void *NULLABLE context, size_t index, size_t threads);
+
+[[nodiscard("error must be checked"), gnu::nonnull(3)]]
+/**
+ * Run `task` on `threads` concurrent threads, all sharing `eid` and `context`. The calling thread runs index 0, and
+ * indices without a free ECALL slot, or whose thread could not be started, also run on the calling thread, after the
+ * others.
+ *
+ * All runs share a budget of `min(APP_THREADS, TCS_NUM)` threads, including the main one, and a thread is only started
+ * when the budget has room for it. Nested runs get the slots that the outer ones left free, so the concurrent ECALLs
+ * never exceed the TCS of the enclave. The started threads share the output capture of the calling thread.
+ *
+ * @return `SGX_SUCCESS` if all tasks succeeded, or the error of the task with the smallest index.
+ */
+sgx_status_t parallel_run(sgx_enclave_id_t eid, size_t threads, parallel_task_fn *NONNULL task, void *NULLABLE context);
+
+#endif  // APP_PARALLEL_H
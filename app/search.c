@@ -0,0 +1,447 @@
+#include <inttypes.h>
+#include <pthread.h>
+#include <sgx_eid.h>
+#include <sgx_error.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "./parallel.h"
+#include "./search.h"
+#include "./writer.h"
+#include "app_config.h"
+#include "defines.h"
+
+/** Estimated cost of starting and joining a thread, in nanoseconds. Less work than this is not split. */
+static constexpr uint64_t THREAD_NS = 50'000;
+/** Initial number of memo slots. */
+static constexpr size_t MEMO_INITIAL_CAPACITY = 1024;
+/** Marks used memo slots, so a zero hash is an empty slot. */
+static constexpr uint64_t MEMO_USED = UINT64_C(1) << 63;
+
+/**
+ * Open addressing hash table from candidates to their results, with linear probing.
+ */
+typedef struct search_memo {
+    /** Serializes all threads. */
+    pthread_mutex_t lock;
+    /** Hash of each slot, with `MEMO_USED` set, or `0` if empty. */
+    uint64_t *NULLABLE hashes;
+    /** Result of each slot. */
+    uint32_t *NULLABLE results;
+    /** Candidate of each slot, `candidate_size` bytes each. */
+    uint8_t *NULLABLE keys;
+    /** Number of slots, a power of two. */
+    size_t capacity;
+    /** Used slots. */
+    size_t count;
+} search_memo_t;
+
+struct search {
+    /** The oracle, owned by the caller. */
+    const search_oracle_t *NONNULL oracle;
+    /** Counters, updated with relaxed atomics. */
+    search_stats_t stats;
+    /** Results of rejected candidates, if `oracle->memoize`. */
+    search_memo_t memo;
+};
+
+search_t *NULLABLE search_new(const search_oracle_t *NONNULL oracle) {
+    assume(oracle->candidate_size > 0 && oracle->batch > 0);
+
+    search_t *NULLABLE search = malloc(sizeof(search_t));
+    if unlikely (search == NULL) {
+        return NULL;
+    }
+
+    *search = (search_t) {
+        .oracle = oracle,
+        .stats = {},
+        .memo = {.lock = PTHREAD_MUTEX_INITIALIZER, .hashes = NULL, .results = NULL, .keys = NULL},
+    };
+    return search;
+}
+
+void search_free(search_t *NULLABLE search) {
+    if unlikely (search == NULL) {
+        return;
+    }
+
+#ifdef DEBUG
+    search_stats_t stats = {};
+    search_stats(search, &stats);
+    writer_printf(
+        "[DEBUG] search %s: %" PRIu64 " runs, %" PRIu64 " queries, %" PRIu64 " candidates, %" PRIu64
+        " memo hits, %" PRIu64 " cancelled, %" PRIu64 " accepted, %.3f ms in the oracle\n",
+        search->oracle->name,
+        stats.runs,
+        stats.queries,
+        stats.candidates,
+        stats.memo_hits,
+        stats.cancelled,
+        stats.accepted,
+        (double) stats.query_ns / 1e6
+    );
+#endif
+
+    free(search->memo.hashes);
+    free(search->memo.results);
+    free(search->memo.keys);
+    (void) pthread_mutex_destroy(&(search->memo.lock));
+    free(search);
+}
+
+void search_stats(const search_t *NONNULL search, search_stats_t *NONNULL stats) {
+#define SEARCH_LOAD(field) .field = __atomic_load_n(&(search->stats.field), __ATOMIC_RELAXED)
+    *stats = (search_stats_t) {
+        SEARCH_LOAD(runs),
+        SEARCH_LOAD(queries),
+        SEARCH_LOAD(candidates),
+        SEARCH_LOAD(memo_hits),
+        SEARCH_LOAD(cancelled),
+        SEARCH_LOAD(accepted),
+        SEARCH_LOAD(query_ns),
+    };
+#undef SEARCH_LOAD
+}
+
+/** Add `n` to a counter of `search`. */
+#define SEARCH_COUNT(search, field, n) \
+    ((void) __atomic_fetch_add(&((search)->stats.field), (n), __ATOMIC_RELAXED))
+
+[[nodiscard("useless call"), gnu::pure, gnu::nonnull(1)]]
+/**
+ * FNV-1a hash of `size` bytes of `key`, with `MEMO_USED` set.
+ */
+static uint64_t memo_hash(const uint8_t *NONNULL key, const size_t size) {
+    uint64_t hash = UINT64_C(0xCBF29CE484222325);
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ key[i]) * UINT64_C(0x100000001B3);
+    }
+    return hash | MEMO_USED;
+}
+
+[[nodiscard("useless call"), gnu::pure, gnu::nonnull(1, 3)]]
+/**
+ * Slot of `key` in `memo`, or the empty slot where it would be inserted. `memo` must be locked and allocated.
+ */
+static size_t memo_slot(
+    const search_memo_t *NONNULL memo,
+    const uint64_t hash,
+    const uint8_t *NONNULL key,
+    const size_t size
+) {
+    const size_t mask = memo->capacity - 1;
+    size_t slot = (size_t) hash & mask;
+    while (memo->hashes[slot] != 0) {
+        if (memo->hashes[slot] == hash && memcmp(&(memo->keys[slot * size]), key, size) == 0) {
+            break;
+        }
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+[[nodiscard("useless call"), gnu::nonnull(1, 2, 3)]]
+/**
+ * Result of `candidate`, if it was memoized, written to `result`.
+ */
+static bool memo_lookup(search_t *NONNULL search, const uint8_t *NONNULL candidate, uint32_t *NONNULL result) {
+    const size_t size = search->oracle->candidate_size;
+    const uint64_t hash = memo_hash(candidate, size);
+    search_memo_t *NONNULL memo = &(search->memo);
+
+    bool found = false;
+    (void) pthread_mutex_lock(&(memo->lock));
+    if likely (memo->count > 0) {
+        const size_t slot = memo_slot(memo, hash, candidate, size);
+        if (memo->hashes[slot] != 0) {
+            *result = memo->results[slot];
+            found = true;
+        }
+    }
+    (void) pthread_mutex_unlock(&(memo->lock));
+    return found;
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(1)]]
+/**
+ * Double the slots of `memo`, or allocate the initial ones. `memo` must be locked.
+ *
+ * @return `false` if out of memory, leaving `memo` unchanged.
+ */
+static bool memo_grow(search_memo_t *NONNULL memo, const size_t size) {
+    const size_t capacity = likely(memo->capacity > 0) ? 2 * memo->capacity : MEMO_INITIAL_CAPACITY;
+    search_memo_t grown = {
+        .hashes = calloc(capacity, sizeof(uint64_t)),
+        .results = calloc(capacity, sizeof(uint32_t)),
+        .keys = calloc(capacity, size),
+        .capacity = capacity,
+        .count = memo->count,
+    };
+    if unlikely (grown.hashes == NULL || grown.results == NULL || grown.keys == NULL) {
+        free(grown.hashes);
+        free(grown.results);
+        free(grown.keys);
+        return false;
+    }
+
+    for (size_t i = 0; i < memo->capacity; i++) {
+        if (memo->hashes[i] != 0) {
+            const size_t slot = memo_slot(&grown, memo->hashes[i], &(memo->keys[i * size]), size);
+            grown.hashes[slot] = memo->hashes[i];
+            grown.results[slot] = memo->results[i];
+            memcpy(&(grown.keys[slot * size]), &(memo->keys[i * size]), size);
+        }
+    }
+
+    free(memo->hashes);
+    free(memo->results);
+    free(memo->keys);
+    memo->hashes = grown.hashes;
+    memo->results = grown.results;
+    memo->keys = grown.keys;
+    memo->capacity = grown.capacity;
+    return true;
+}
+
+[[gnu::nonnull(1, 2)]]
+/**
+ * Memoize the `result` of `candidate`. Skipped when out of memory, the memo only saves queries.
+ */
+static void memo_insert(search_t *NONNULL search, const uint8_t *NONNULL candidate, const uint32_t result) {
+    const size_t size = search->oracle->candidate_size;
+    const uint64_t hash = memo_hash(candidate, size);
+    search_memo_t *NONNULL memo = &(search->memo);
+
+    (void) pthread_mutex_lock(&(memo->lock));
+    // at most half full
+    if likely (2 * (memo->count + 1) <= memo->capacity || memo_grow(memo, size)) {
+        const size_t slot = memo_slot(memo, hash, candidate, size);
+        if likely (memo->hashes[slot] == 0) {
+            memo->hashes[slot] = hash;
+            memo->results[slot] = result;
+            memcpy(&(memo->keys[slot * size]), candidate, size);
+            memo->count++;
+        }
+    }
+    (void) pthread_mutex_unlock(&(memo->lock));
+}
+
+[[nodiscard("useless call")]]
+/**
+ * Monotonic time, in nanoseconds.
+ */
+static uint64_t now_ns(void) {
+    struct timespec now = {};
+    (void) clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1'000'000'000 + (uint64_t) now.tv_nsec;
+}
+
+/**
+ * State of a single `search_run`, shared by its threads.
+ */
+typedef struct search_run_state {
+    /** Oracle, memo and statistics. */
+    search_t *NONNULL search;
+    /** Candidate generator. */
+    search_generate_fn *NONNULL generate;
+    /** Context of `generate`. */
+    const void *NULLABLE context;
+    /** Results of each candidate, if requested. */
+    uint32_t *NULLABLE results;
+    /** Total candidates. */
+    size_t count;
+    /** Candidates in each chunk (the last one may be smaller). */
+    size_t chunk;
+    /** Number of chunks. */
+    size_t chunks;
+    /** Next chunk to be taken by some thread. */
+    size_t next;
+    /** Candidates generated so far. */
+    size_t generated;
+    /** Smallest accepted index, or `count`. */
+    size_t accepted;
+    /** Set once a candidate is accepted or a query fails, stops all threads. */
+    bool stop;
+} search_run_t;
+
+[[gnu::nonnull(1)]]
+/**
+ * Lower the accepted index of `run` to `index`, and stop all threads.
+ */
+static void run_accept(search_run_t *NONNULL run, const size_t index) {
+    size_t current = __atomic_load_n(&(run->accepted), __ATOMIC_RELAXED);
+    while (index < current) {
+        if (__atomic_compare_exchange_n(&(run->accepted), &current, index, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            break;
+        }
+    }
+    __atomic_store_n(&(run->stop), true, __ATOMIC_RELEASE);
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(1, 3, 4, 5)]]
+/**
+ * Query the chunk starting at `first`, with `n` candidates, skipping the memoized ones. `candidates`, `answers` and
+ * `positions` are buffers for a whole chunk.
+ */
+static sgx_status_t run_chunk(
+    search_run_t *NONNULL run,
+    const sgx_enclave_id_t eid,
+    uint8_t *NONNULL candidates,
+    uint32_t *NONNULL answers,
+    size_t *NONNULL positions,
+    const size_t first,
+    const size_t n
+) {
+    search_t *NONNULL search = run->search;
+    const search_oracle_t *NONNULL oracle = search->oracle;
+    const size_t size = oracle->candidate_size;
+
+    size_t missing = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint8_t *NONNULL candidate = &(candidates[missing * size]);
+        run->generate(run->context, first + i, candidate);
+
+        uint32_t result = 0;
+        if (oracle->memoize && memo_lookup(search, candidate, &result)) {
+            SEARCH_COUNT(search, memo_hits, 1);
+            if (run->results != NULL) {
+                run->results[first + i] = result;
+            }
+        } else {
+            positions[missing++] = first + i;
+        }
+    }
+    (void) __atomic_fetch_add(&(run->generated), n, __ATOMIC_RELAXED);
+    if unlikely (missing == 0) {
+        return SGX_SUCCESS;
+    }
+
+    size_t found = missing;
+    const uint64_t start = now_ns();
+    const sgx_status_t status = oracle->query(eid, oracle->context, candidates, missing, answers, &found, &(run->stop));
+    SEARCH_COUNT(search, query_ns, now_ns() - start);
+    SEARCH_COUNT(search, queries, 1);
+    SEARCH_COUNT(search, candidates, missing);
+    if unlikely (status != SGX_SUCCESS) {
+        __atomic_store_n(&(run->stop), true, __ATOMIC_RELEASE);
+        return status;
+    } else if (found < missing) {
+        SEARCH_COUNT(search, accepted, 1);
+        run_accept(run, positions[found]);
+        return SGX_SUCCESS;
+    }
+
+    for (size_t k = 0; k < missing; k++) {
+        if (run->results != NULL) {
+            run->results[positions[k]] = answers[k];
+        }
+        if (oracle->memoize) {
+            memo_insert(search, &(candidates[k * size]), answers[k]);
+        }
+    }
+    return SGX_SUCCESS;
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(2)]]
+/**
+ * Thread `index` takes the next chunk of `run` until all are taken or the run is stopped.
+ */
+static sgx_status_t run_task(
+    const sgx_enclave_id_t eid,
+    void *NONNULL context,
+    const size_t index,
+    const size_t threads
+) {
+    (void) index;
+    (void) threads;
+    search_run_t *NONNULL run = (search_run_t *) context;
+
+    uint8_t *NULLABLE candidates = malloc(run->chunk * run->search->oracle->candidate_size);
+    uint32_t *NULLABLE answers = malloc(run->chunk * sizeof(uint32_t));
+    size_t *NULLABLE positions = malloc(run->chunk * sizeof(size_t));
+
+    sgx_status_t status = SGX_SUCCESS;
+    if unlikely (candidates == NULL || answers == NULL || positions == NULL) {
+        __atomic_store_n(&(run->stop), true, __ATOMIC_RELEASE);
+        status = SGX_ERROR_OUT_OF_MEMORY;
+    }
+
+    while (status == SGX_SUCCESS && !__atomic_load_n(&(run->stop), __ATOMIC_ACQUIRE)) {
+        const size_t chunk = __atomic_fetch_add(&(run->next), 1, __ATOMIC_RELAXED);
+        if unlikely (chunk >= run->chunks) {
+            break;
+        }
+
+        const size_t first = chunk * run->chunk;
+        const size_t n = likely(run->count - first > run->chunk) ? run->chunk : run->count - first;
+        status = run_chunk(run, eid, candidates, answers, positions, first, n);
+    }
+
+    free(candidates);
+    free(answers);
+    free(positions);
+    return status;
+}
+
+[[nodiscard("useless call"), gnu::pure, gnu::nonnull(1)]]
+/**
+ * Threads worth starting for `count` candidates on `oracle`, from its cost hints.
+ */
+static size_t run_threads(const search_oracle_t *NONNULL oracle, const size_t count) {
+    if (!oracle->thread_safe) {
+        return 1;
+    }
+    const size_t max_threads = likely(oracle->threads > 0) ? oracle->threads : APP_THREADS;
+
+    const uint64_t queries = (count + oracle->batch - 1) / oracle->batch;
+    const uint64_t work = queries * oracle->query_ns + count * oracle->candidate_ns;
+    const uint64_t worth = likely(work > THREAD_NS) ? work / THREAD_NS : 1;
+
+    size_t threads = likely(worth < max_threads) ? (size_t) worth : max_threads;
+    threads = likely(threads < count) ? threads : count;
+    return likely(threads > 0) ? threads : 1;
+}
+
+sgx_status_t search_run(
+    search_t *NONNULL search,
+    const sgx_enclave_id_t eid,
+    search_generate_fn *NONNULL generate,
+    const void *NULLABLE context,
+    const size_t count,
+    uint32_t *NULLABLE results,
+    size_t *NONNULL accepted
+) {
+    SEARCH_COUNT(search, runs, 1);
+    *accepted = count;
+    if unlikely (count == 0) {
+        return SGX_SUCCESS;
+    }
+
+    // smaller queries when a full batch would leave threads idle
+    const size_t threads = run_threads(search->oracle, count);
+    const size_t even = (count + threads - 1) / threads;
+    const size_t chunk = likely(even < search->oracle->batch) ? even : search->oracle->batch;
+
+    search_run_t run = {
+        .search = search,
+        .generate = generate,
+        .context = context,
+        .results = results,
+        .count = count,
+        .chunk = chunk,
+        .chunks = (count + chunk - 1) / chunk,
+        .next = 0,
+        .generated = 0,
+        .accepted = count,
+        .stop = false,
+    };
+    const sgx_status_t status = parallel_run(eid, threads, run_task, &run);
+
+    SEARCH_COUNT(search, cancelled, count - run.generated);
+    *accepted = run.accepted;
+    return status;
+}
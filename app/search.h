@@ -0,0 +1,125 @@
+#ifndef APP_SEARCH_H
+/** Searches that query an enclave oracle until it accepts a candidate. */
+#define APP_SEARCH_H
+
+#include <sgx_eid.h>
+#include <sgx_error.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "defines.h"
+
+/**
+ * Query `count` contiguous `candidates`, writing one result for each into `results`. If the oracle accepts one of
+ * them, its index is written to `accepted` and the following results may be left unset, otherwise `accepted` is set to
+ * `count`. Long queries may poll `stop`, set when another thread had a candidate accepted.
+ */
+typedef sgx_status_t search_query_fn(
+    sgx_enclave_id_t eid,
+    void *NULLABLE context,
+    const void *NONNULL candidates,
+    size_t count,
+    uint32_t results[NONNULL],
+    size_t *NONNULL accepted,
+    const bool *NONNULL stop
+);
+
+/**
+ * Write candidate `index` of a search into `candidate`. Called concurrently for distinct indices.
+ */
+typedef void search_generate_fn(const void *NULLABLE context, size_t index, void *NONNULL candidate);
+
+/**
+ * Description of an oracle, usually an ECALL or a group of ECALLs with fallbacks.
+ */
+typedef struct search_oracle {
+    /** Name in the statistics. */
+    const char *NONNULL name;
+    /** The oracle itself. */
+    search_query_fn *NONNULL query;
+    /** Shared by all queries. */
+    void *NULLABLE context;
+    /** Bytes of each candidate. */
+    size_t candidate_size;
+    /** Maximum candidates in a single query. */
+    size_t batch;
+    /** Maximum concurrent queries, or `0` for `APP_THREADS`. Ignored unless `thread_safe`. */
+    size_t threads;
+    /** Estimated cost of each query, in nanoseconds. */
+    uint64_t query_ns;
+    /** Estimated cost of each candidate in a query, in nanoseconds. */
+    uint64_t candidate_ns;
+    /** Queries can run on concurrent threads. */
+    bool thread_safe;
+    /** Keep the results of all rejected candidates, so they are never queried again. */
+    bool memoize;
+} search_oracle_t;
+
+/**
+ * Counters of all searches on the same oracle.
+ */
+typedef struct search_stats {
+    /** Calls to `search_run`. */
+    uint64_t runs;
+    /** Calls to the oracle. */
+    uint64_t queries;
+    /** Candidates sent to the oracle. */
+    uint64_t candidates;
+    /** Candidates answered from the memo, without a query. */
+    uint64_t memo_hits;
+    /** Candidates never generated, because another one was accepted first. */
+    uint64_t cancelled;
+    /** Accepted candidates. */
+    uint64_t accepted;
+    /** Time spent in the oracle, summed over all threads, in nanoseconds. */
+    uint64_t query_ns;
+} search_stats_t;
+
+/**
+ * Memo and statistics of an oracle, shared by all its searches.
+ */
+typedef struct search search_t;
+
+[[nodiscard("leaks memory"), gnu::nonnull(1), gnu::malloc, gnu::cold, gnu::nothrow]]
+/**
+ * Start searches on `oracle`, which must outlive them.
+ *
+ * @return `NULL` if out of memory.
+ */
+search_t *NULLABLE search_new(const search_oracle_t *NONNULL oracle);
+
+[[gnu::cold, gnu::nothrow]]
+/**
+ * Release `search`, showing its statistics on debug builds.
+ */
+void search_free(search_t *NULLABLE search);
+
+[[nodiscard("error must be checked"), gnu::nonnull(1, 3, 7)]]
+/**
+ * Query the candidates `0 .. count` from `generate` until the oracle accepts one.
+ *
+ * Candidates are split in queries of at most `batch`, fewer when that leaves threads idle, and the queries are taken
+ * in order by up to `threads` threads, as many as the cost hints justify. Memoized candidates are answered without
+ * a query. Once a candidate is accepted, no further queries start. Multiple threads may call this concurrently on the
+ * same `search`.
+ *
+ * The result of each candidate is written to `results`, if not `NULL`, unless some candidate was accepted. The
+ * accepted index is written to `accepted`, or `count` if none was.
+ */
+sgx_status_t search_run(
+    search_t *NONNULL search,
+    sgx_enclave_id_t eid,
+    search_generate_fn *NONNULL generate,
+    const void *NULLABLE context,
+    size_t count,
+    uint32_t *NULLABLE results,
+    size_t *NONNULL accepted
+);
+
+[[gnu::nonnull(1, 2), gnu::nothrow]]
+/**
+ * Current counters of `search`.
+ */
+void search_stats(const search_t *NONNULL search, search_stats_t *NONNULL stats);
+
+#endif  // APP_SEARCH_H
@@ -0,0 +1,364 @@
+#include <inttypes.h>
+#include <sgx_eid.h>
+#include <sgx_error.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "./stats.h"
+#include "app_config.h"
+#include "defines.h"
+#include "enclave_stats.h"
+#include "enclave_u.h"
+
+#if APP_STATS != STATS_OFF
+
+/** Latency buckets: bucket `i > 0` counts latencies in `[2^(i-1), 2^i)` ns, and bucket 0 counts zeros. */
+static constexpr size_t BUCKETS = 65;
+
+/**
+ * Counters of an instrumented call, updated with relaxed atomics.
+ */
+typedef struct stats_entry {
+    /** Calls that returned `SGX_SUCCESS`. */
+    uint64_t calls;
+    /** Calls that returned any other error, except `SGX_ERROR_OUT_OF_TCS`. */
+    uint64_t errors;
+    /** Calls that failed with `SGX_ERROR_OUT_OF_TCS`, retried by the caller. */
+    uint64_t retries;
+    /** Total latency of `calls` and `errors`. */
+    uint64_t total_ns;
+    /** Largest latency of `calls` and `errors`. */
+    uint64_t max_ns;
+    /** Log-bucketed latency histogram. */
+    uint64_t buckets[BUCKETS];
+} stats_entry_t;
+
+/** Name of each instrumented call. */
+static const char *NONNULL const NAMES[STATS_CALL_COUNT] = {
+#    define STATS_CALL_NAME(name, challenge) [STATS_##name] = #name,
+    STATS_CALLS(STATS_CALL_NAME)
+#    undef STATS_CALL_NAME
+};
+
+/** Challenge of each instrumented call. */
+static const uint8_t CHALLENGE[STATS_CALL_COUNT] = {
+#    define STATS_CALL_CHALLENGE(name, challenge) [STATS_##name] = challenge,
+    STATS_CALLS(STATS_CALL_CHALLENGE)
+#    undef STATS_CALL_CHALLENGE
+};
+
+/** Counters of every call. */
+static stats_entry_t entries[STATS_CALL_COUNT] = {};
+/** Wall time of each challenge solver. */
+static uint64_t challenge_ns[STATS_GROUPS] = {};
+/** Enclave counters, read before the enclave is destroyed. */
+static enclave_stats_t enclave_stats = {};
+/** If `enclave_stats` was read. */
+static bool has_enclave_stats = false;
+
+[[nodiscard("pure function"), gnu::const, gnu::always_inline]]
+/**
+ * Histogram bucket for a latency of `ns`.
+ */
+static inline size_t bucket_of(const uint64_t ns) {
+    return likely(ns > 0) ? (size_t) (64 - __builtin_clzll(ns)) : 0;
+}
+
+[[nodiscard("pure function"), gnu::const]]
+/**
+ * Largest latency counted in `bucket`.
+ */
+static uint64_t bucket_limit(const size_t bucket) {
+    if unlikely (bucket >= 64) {
+        return UINT64_MAX;
+    }
+    return (UINT64_C(1) << bucket) - 1;
+}
+
+/**
+ * Record a call to `id` started at `start`.
+ */
+void stats_record(const stats_call_id_t id, const uint64_t start, const sgx_status_t status) {
+    const uint64_t elapsed = stats_now() - start;
+    stats_entry_t *NONNULL entry = &(entries[id]);
+
+    if unlikely (status == SGX_ERROR_OUT_OF_TCS) {
+        __atomic_fetch_add(&(entry->retries), 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    if likely (status == SGX_SUCCESS) {
+        __atomic_fetch_add(&(entry->calls), 1, __ATOMIC_RELAXED);
+    } else {
+        __atomic_fetch_add(&(entry->errors), 1, __ATOMIC_RELAXED);
+    }
+    __atomic_fetch_add(&(entry->total_ns), elapsed, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&(entry->buckets[bucket_of(elapsed)]), 1, __ATOMIC_RELAXED);
+
+    uint64_t max = __atomic_load_n(&(entry->max_ns), __ATOMIC_RELAXED);
+    while (elapsed > max) {
+        const bool swapped =
+            __atomic_compare_exchange_n(&(entry->max_ns), &max, elapsed, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+        if likely (swapped) {
+            break;
+        }
+    }
+}
+
+/**
+ * Record the wall time of `challenge`.
+ */
+void stats_challenge(const size_t challenge, const uint64_t start) {
+    if unlikely (challenge >= STATS_GROUPS) {
+        return;
+    }
+    __atomic_fetch_add(&(challenge_ns[challenge]), stats_now() - start, __ATOMIC_RELAXED);
+}
+
+/**
+ * Read the enclave counters.
+ */
+void stats_enclave(const sgx_enclave_id_t eid) {
+    int rv = -1;
+    const sgx_status_t status = ecall_get_stats(eid, &rv, &enclave_stats);
+    has_enclave_stats = status == SGX_SUCCESS && rv == 0;
+}
+
+/**
+ * Snapshot of an entry, after all threads finished.
+ */
+typedef struct stats_snapshot {
+    /** Copied counters. */
+    stats_entry_t entry;
+    /** `calls + errors`, the calls with latency. */
+    uint64_t completed;
+} stats_snapshot_t;
+
+[[gnu::nonnull(1)]]
+/**
+ * Copy the counters of `id` into `snapshot`.
+ */
+static void snapshot_of(stats_snapshot_t *NONNULL snapshot, const stats_call_id_t id) {
+    const stats_entry_t *NONNULL entry = &(entries[id]);
+
+    snapshot->entry.calls = __atomic_load_n(&(entry->calls), __ATOMIC_RELAXED);
+    snapshot->entry.errors = __atomic_load_n(&(entry->errors), __ATOMIC_RELAXED);
+    snapshot->entry.retries = __atomic_load_n(&(entry->retries), __ATOMIC_RELAXED);
+    snapshot->entry.total_ns = __atomic_load_n(&(entry->total_ns), __ATOMIC_RELAXED);
+    snapshot->entry.max_ns = __atomic_load_n(&(entry->max_ns), __ATOMIC_RELAXED);
+    for (size_t i = 0; i < BUCKETS; i++) {
+        snapshot->entry.buckets[i] = __atomic_load_n(&(entry->buckets[i]), __ATOMIC_RELAXED);
+    }
+    snapshot->completed = snapshot->entry.calls + snapshot->entry.errors;
+}
+
+#    if APP_STATS == STATS_TABLE
+[[nodiscard("pure function"), gnu::pure, gnu::nonnull(1)]]
+/**
+ * Upper bound of the `quantile` latency, from the histogram. Exact up to a factor of 2.
+ */
+static uint64_t percentile(const stats_snapshot_t *NONNULL snapshot, const double quantile) {
+    if unlikely (snapshot->completed == 0) {
+        return 0;
+    }
+
+    const uint64_t rank = (uint64_t) (quantile * (double) (snapshot->completed - 1)) + 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; i++) {
+        seen += snapshot->entry.buckets[i];
+        if (seen >= rank) {
+            const uint64_t limit = bucket_limit(i);
+            return likely(limit < snapshot->entry.max_ns) ? limit : snapshot->entry.max_ns;
+        }
+    }
+    return snapshot->entry.max_ns;
+}
+
+/** Microseconds in a nanosecond. */
+static constexpr double US = 1e-3;
+/** Milliseconds in a nanosecond. */
+static constexpr double MS = 1e-6;
+
+[[gnu::cold]]
+/**
+ * Print the counters as a table, with the histogram of each call below its row.
+ */
+static void stats_report(void) {
+    uint64_t ecall_ns[STATS_GROUPS] = {};
+    uint64_t ecall_calls[STATS_GROUPS] = {};
+
+    (void) fprintf(
+        stderr,
+        "\n%-32s %9s %10s %7s %7s %12s %10s %10s %10s %10s\n",
+        "call",
+        "challenge",
+        "calls",
+        "errors",
+        "retries",
+        "total (ms)",
+        "mean (us)",
+        "p50 (us)",
+        "p99 (us)",
+        "max (us)"
+    );
+
+    for (size_t id = 0; id < STATS_CALL_COUNT; id++) {
+        stats_snapshot_t snapshot = {};
+        snapshot_of(&snapshot, (stats_call_id_t) id);
+        if (snapshot.completed == 0 && snapshot.entry.retries == 0) {
+            continue;
+        }
+        ecall_ns[CHALLENGE[id]] += snapshot.entry.total_ns;
+        ecall_calls[CHALLENGE[id]] += snapshot.completed;
+
+        const double mean = likely(snapshot.completed > 0)
+            ? (double) snapshot.entry.total_ns / (double) snapshot.completed
+            : 0.0;
+        (void) fprintf(
+            stderr,
+            "%-32s %9u %10" PRIu64 " %7" PRIu64 " %7" PRIu64 " %12.3f %10.3f %10.3f %10.3f %10.3f\n",
+            NAMES[id],
+            (unsigned) CHALLENGE[id],
+            snapshot.entry.calls,
+            snapshot.entry.errors,
+            snapshot.entry.retries,
+            (double) snapshot.entry.total_ns * MS,
+            mean * US,
+            (double) percentile(&snapshot, 0.50) * US,
+            (double) percentile(&snapshot, 0.99) * US,
+            (double) snapshot.entry.max_ns * US
+        );
+
+        if (snapshot.completed == 0) {
+            continue;
+        }
+        (void) fprintf(stderr, "    latency <");
+        for (size_t i = 0; i < BUCKETS; i++) {
+            if (snapshot.entry.buckets[i] > 0) {
+                const double limit = (double) bucket_limit(i) + 1.0;
+                (void) fprintf(stderr, " %.3gus:%" PRIu64, limit * US, snapshot.entry.buckets[i]);
+            }
+        }
+        (void) fprintf(stderr, "\n");
+    }
+
+    (void) fprintf(stderr, "\n%-9s %10s %12s %12s\n", "challenge", "calls", "calls (ms)", "wall (ms)");
+    for (size_t challenge = 0; challenge < STATS_GROUPS; challenge++) {
+        const uint64_t wall = __atomic_load_n(&(challenge_ns[challenge]), __ATOMIC_RELAXED);
+        if (ecall_calls[challenge] == 0 && wall == 0) {
+            continue;
+        }
+        (void) fprintf(
+            stderr,
+            "%-9zu %10" PRIu64 " %12.3f %12.3f\n",
+            challenge,
+            ecall_calls[challenge],
+            (double) ecall_ns[challenge] * MS,
+            (double) wall * MS
+        );
+    }
+
+    if (has_enclave_stats) {
+        (void) fprintf(stderr, "\n%-56s %14s\n", "enclave counter", "value");
+#    define STATS_PRINT_COUNTER(name, description) \
+        (void) fprintf(stderr, "%-56s %14" PRIu64 "\n", description, enclave_stats.name);
+        ENCLAVE_COUNTERS(STATS_PRINT_COUNTER)
+#    undef STATS_PRINT_COUNTER
+    }
+}
+
+#    else
+[[gnu::cold]]
+/**
+ * Print the counters as a single JSON object, with the full histograms.
+ */
+static void stats_report(void) {
+    uint64_t ecall_ns[STATS_GROUPS] = {};
+    uint64_t ecall_calls[STATS_GROUPS] = {};
+
+    (void) fprintf(stderr, "{\"calls\":[");
+    bool first = true;
+    for (size_t id = 0; id < STATS_CALL_COUNT; id++) {
+        stats_snapshot_t snapshot = {};
+        snapshot_of(&snapshot, (stats_call_id_t) id);
+        if (snapshot.completed == 0 && snapshot.entry.retries == 0) {
+            continue;
+        }
+        ecall_ns[CHALLENGE[id]] += snapshot.entry.total_ns;
+        ecall_calls[CHALLENGE[id]] += snapshot.completed;
+
+        (void) fprintf(
+            stderr,
+            "%s{\"name\":\"%s\",\"challenge\":%u,\"calls\":%" PRIu64 ",\"errors\":%" PRIu64 ",\"retries\":%" PRIu64
+            ",\"total_ns\":%" PRIu64 ",\"max_ns\":%" PRIu64 ",\"histogram\":[",
+            first ? "" : ",",
+            NAMES[id],
+            (unsigned) CHALLENGE[id],
+            snapshot.entry.calls,
+            snapshot.entry.errors,
+            snapshot.entry.retries,
+            snapshot.entry.total_ns,
+            snapshot.entry.max_ns
+        );
+        first = false;
+
+        bool first_bucket = true;
+        for (size_t i = 0; i < BUCKETS; i++) {
+            if (snapshot.entry.buckets[i] > 0) {
+                (void) fprintf(
+                    stderr,
+                    "%s{\"le_ns\":%" PRIu64 ",\"count\":%" PRIu64 "}",
+                    first_bucket ? "" : ",",
+                    bucket_limit(i),
+                    snapshot.entry.buckets[i]
+                );
+                first_bucket = false;
+            }
+        }
+        (void) fprintf(stderr, "]}");
+    }
+
+    (void) fprintf(stderr, "],\"challenges\":[");
+    first = true;
+    for (size_t challenge = 0; challenge < STATS_GROUPS; challenge++) {
+        const uint64_t wall = __atomic_load_n(&(challenge_ns[challenge]), __ATOMIC_RELAXED);
+        if (ecall_calls[challenge] == 0 && wall == 0) {
+            continue;
+        }
+        (void) fprintf(
+            stderr,
+            "%s{\"challenge\":%zu,\"calls\":%" PRIu64 ",\"calls_ns\":%" PRIu64 ",\"wall_ns\":%" PRIu64 "}",
+            first ? "" : ",",
+            challenge,
+            ecall_calls[challenge],
+            ecall_ns[challenge],
+            wall
+        );
+        first = false;
+    }
+    (void) fprintf(stderr, "]");
+
+    if (has_enclave_stats) {
+        (void) fprintf(stderr, ",\"enclave\":{");
+        first = true;
+#    define STATS_PRINT_COUNTER(name, description)                                              \
+        (void) fprintf(stderr, "%s\"" #name "\":%" PRIu64, first ? "" : ",", enclave_stats.name); \
+        first = false;
+        ENCLAVE_COUNTERS(STATS_PRINT_COUNTER)
+#    undef STATS_PRINT_COUNTER
+        (void) fprintf(stderr, "}");
+    }
+    (void) fprintf(stderr, "}\n");
+}
+#    endif
+
+/**
+ * Register the report with `atexit`.
+ */
+bool stats_start(void) {
+    return atexit(stats_report) == 0;
+}
+
+#endif
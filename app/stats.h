@@ -0,0 +1,141 @@
+#ifndef APP_STATS_H
+/** Optional latency and call count instrumentation for the ECALLs and the enclave setup. */
+#define APP_STATS_H
+
+#include <sgx_eid.h>
+#include <sgx_error.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "app_config.h"
+#include "defines.h"
+
+/** No instrumentation, every call is made directly. */
+#define STATS_OFF 0
+/** Report a table to stderr at exit. */
+#define STATS_TABLE 1
+/** Report a JSON object to stderr at exit. */
+#define STATS_JSON 2
+
+/**
+ * Instrumented calls, with the challenge that makes them. Challenge 0 is the enclave setup.
+ */
+#define STATS_CALLS(X)                    \
+    X(sgx_create_enclave, 0)              \
+    X(sgx_create_enclave_ex, 0)           \
+    X(sgx_destroy_enclave, 0)             \
+    X(ecall_verificar_aluno, 1)           \
+    X(ecall_verificar_senha, 2)           \
+    X(ecall_verificar_senhas, 2)          \
+    X(ecall_palavra_secreta, 3)           \
+    X(ecall_palavras_secretas, 3)         \
+    X(ecall_polinomio_secreto, 4)         \
+    X(ecall_polinomio_secreto_lote, 4)    \
+    X(ecall_verificar_polinomio, 4)       \
+    X(ecall_pedra_papel_tesoura, 5)       \
+    X(ecall_pedra_papel_tesoura_lote, 5)  \
+    X(ecall_rps_cache_stats, 5)
+
+/**
+ * Identifier of an instrumented call.
+ */
+typedef enum [[gnu::packed]] stats_call_id {
+#define STATS_CALL_ID(name, challenge) STATS_##name,
+    STATS_CALLS(STATS_CALL_ID)
+#undef STATS_CALL_ID
+    /** Number of instrumented calls. */
+    STATS_CALL_COUNT,
+} stats_call_id_t;
+
+/** Challenges with separate totals, including the setup as challenge 0. */
+#define STATS_GROUPS 6
+
+#if APP_STATS != STATS_OFF
+
+[[nodiscard("useless call"), gnu::always_inline, gnu::nothrow]]
+/**
+ * Monotonic time, in nanoseconds.
+ */
+static inline uint64_t stats_now(void) {
+    struct timespec now = {};
+    (void) clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1'000'000'000 + (uint64_t) now.tv_nsec;
+}
+
+[[gnu::nothrow, gnu::leaf]]
+/**
+ * Record a call to `id` started at `start`. Calls that failed with `SGX_ERROR_OUT_OF_TCS` are only counted as
+ * retries, without latency. Thread-safe.
+ */
+void stats_record(stats_call_id_t id, uint64_t start, sgx_status_t status);
+
+[[gnu::nothrow, gnu::leaf]]
+/**
+ * Record the wall time of `challenge` (from 1), started at `start`. Thread-safe.
+ */
+void stats_challenge(size_t challenge, uint64_t start);
+
+[[gnu::cold]]
+/**
+ * Read the enclave counters with `ecall_get_stats`, to be shown in the report. Enclaves without the ECALL, like the
+ * pre-compiled one, are ignored.
+ */
+void stats_enclave(sgx_enclave_id_t eid);
+
+[[nodiscard("error must be checked"), gnu::cold]]
+/**
+ * Print the report at exit, as a table or JSON depending on `APP_STATS`.
+ *
+ * @return `false` if the report could not be registered.
+ */
+bool stats_start(void);
+
+/**
+ * Call `name(...)`, an SGX function returning `sgx_status_t`, and record its latency and status.
+ */
+#    define STATS_CALL(name, ...)                                               \
+        ({                                                                      \
+            const uint64_t stats_start_ = stats_now();                          \
+            const sgx_status_t stats_status_ = name(__VA_ARGS__);               \
+            stats_record(STATS_##name, stats_start_, stats_status_);            \
+            stats_status_;                                                      \
+        })
+
+/**
+ * Evaluate `call`, the solver of `challenge` (from 1), and record its wall time.
+ */
+#    define STATS_CHALLENGE(challenge, call)                                    \
+        ({                                                                      \
+            const uint64_t stats_start_ = stats_now();                          \
+            const sgx_status_t stats_status_ = (call);                          \
+            stats_challenge((challenge), stats_start_);                         \
+            stats_status_;                                                      \
+        })
+
+#else
+
+[[nodiscard("error must be checked"), gnu::always_inline, gnu::const]]
+/**
+ * Nothing to report without instrumentation.
+ */
+static inline bool stats_start(void) {
+    return true;
+}
+
+[[gnu::always_inline]]
+/**
+ * No enclave counters without instrumentation.
+ */
+static inline void stats_enclave(const sgx_enclave_id_t eid) {
+    (void) eid;
+}
+
+/** Direct call, without instrumentation. */
+#    define STATS_CALL(name, ...) name(__VA_ARGS__)
+/** Direct call, without instrumentation. */
+#    define STATS_CHALLENGE(challenge, call) (call)
+
+#endif
+
+#endif  // APP_STATS_H
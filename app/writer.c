@@ -0,0 +1,375 @@
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "./writer.h"
+#include "app_config.h"
+#include "defines.h"
+
+/**
+ * A queued message.
+ */
+typedef struct writer_node {
+    /** Next message in queue order, written by the producer after the node is published. */
+    struct writer_node *NULLABLE next;
+    /** Bytes in `data`. */
+    size_t len;
+    /** Message contents, not NUL-terminated. */
+    char data[];
+} writer_node_t;
+
+/** Bytes collected before each `write(2)`. */
+static constexpr size_t BATCH_SIZE = 64 * 1024;
+
+/** Placeholder node, so the queue is never empty. */
+static writer_node_t stub = {.next = NULL, .len = 0};
+
+/**
+ * Intrusive MPSC queue (Vyukov). Producers only exchange `head`, and only the writer thread touches `tail`.
+ */
+static struct {
+    /** Last pushed node. */
+    writer_node_t *NONNULL head;
+    /** Next node to pop, owned by the writer thread. */
+    writer_node_t *NONNULL tail;
+    /** Bytes waiting in the queue, for backpressure. */
+    size_t pending;
+    /** Posted once for every push and on stop. */
+    sem_t ready;
+    /** Writer thread. */
+    pthread_t thread;
+    /** If the writer thread is draining the queue. */
+    bool running;
+    /** Set by `writer_stop`, so the thread exits after the queue is empty. */
+    bool stopping;
+} queue = {
+    .head = &stub,
+    .tail = &stub,
+    .pending = 0,
+    .running = false,
+    .stopping = false,
+};
+
+[[gnu::nonnull(1), gnu::hot]]
+/**
+ * Publish `node` at the end of the queue. Wait-free.
+ */
+static void queue_push(writer_node_t *NONNULL node) {
+    __atomic_store_n(&(node->next), NULL, __ATOMIC_RELAXED);
+    writer_node_t *NONNULL prev = __atomic_exchange_n(&(queue.head), node, __ATOMIC_ACQ_REL);
+    // the queue is briefly disconnected here, and the consumer waits for the link
+    __atomic_store_n(&(prev->next), node, __ATOMIC_RELEASE);
+}
+
+[[nodiscard("node must be freed"), gnu::hot]]
+/**
+ * Take the oldest node of the queue, from the writer thread only.
+ *
+ * @return The node, or `NULL` if the queue is empty or a push is still in progress.
+ */
+static writer_node_t *NULLABLE queue_pop(void) {
+    writer_node_t *NONNULL tail = queue.tail;
+    writer_node_t *NULLABLE next = __atomic_load_n(&(tail->next), __ATOMIC_ACQUIRE);
+
+    if (tail == &stub) {
+        if (next == NULL) {
+            return NULL;
+        }
+        queue.tail = next;
+        tail = next;
+        next = __atomic_load_n(&(next->next), __ATOMIC_ACQUIRE);
+    }
+
+    if likely (next != NULL) {
+        queue.tail = next;
+        return tail;
+    }
+
+    if (tail != __atomic_load_n(&(queue.head), __ATOMIC_ACQUIRE)) {
+        return NULL;
+    }
+
+    // last node: push the stub back so the node can be detached
+    queue_push(&stub);
+    next = __atomic_load_n(&(tail->next), __ATOMIC_ACQUIRE);
+    if (next != NULL) {
+        queue.tail = next;
+        return tail;
+    }
+    return NULL;
+}
+
+[[gnu::nonnull(1)]]
+/**
+ * Write all `len` bytes of `data` to stdout, retrying on partial writes and interrupts.
+ */
+static void write_all(const char *NONNULL data, size_t len) {
+    while (len > 0) {
+        const ssize_t written = write(STDOUT_FILENO, data, len);
+        if unlikely (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        data += written;
+        len -= (size_t) written;
+    }
+}
+
+[[gnu::nonnull(1)]]
+/**
+ * Drain the queue into `batch`, writing it whenever it's full and once the queue is empty.
+ */
+static void writer_drain(char batch[NONNULL BATCH_SIZE]) {
+    size_t used = 0;
+
+    writer_node_t *NULLABLE node = NULL;
+    while ((node = queue_pop()) != NULL) {
+        if (used + node->len > BATCH_SIZE) {
+            write_all(batch, used);
+            used = 0;
+        }
+
+        if unlikely (node->len > BATCH_SIZE) {
+            write_all(node->data, node->len);
+        } else {
+            memcpy(&(batch[used]), node->data, node->len);
+            used += node->len;
+        }
+
+        __atomic_fetch_sub(&(queue.pending), node->len, __ATOMIC_RELEASE);
+        free(node);
+    }
+
+    write_all(batch, used);
+}
+
+/**
+ * Writer thread: drain the queue whenever something is pushed, until stopped.
+ */
+static void *NULLABLE writer_run(void *NULLABLE arg) {
+    (void) arg;
+
+    static char batch[BATCH_SIZE];
+    while (true) {
+        while (sem_wait(&(queue.ready)) != 0 && errno == EINTR) {
+        }
+
+        writer_drain(batch);
+        if unlikely (__atomic_load_n(&(queue.stopping), __ATOMIC_ACQUIRE)) {
+            // a push may still be linking its node
+            while (__atomic_load_n(&(queue.pending), __ATOMIC_ACQUIRE) > 0) {
+                sched_yield();
+                writer_drain(batch);
+            }
+            return NULL;
+        }
+    }
+}
+
+/**
+ * Start the writer thread, if not running.
+ */
+bool writer_start(void) {
+    if (queue.running) {
+        return true;
+    }
+
+    int rv = sem_init(&(queue.ready), 0, 0);
+    if unlikely (rv != 0) {
+        return false;
+    }
+
+    // messages written before this are still in the stdio buffer
+    (void) fflush(stdout);
+
+    rv = pthread_create(&(queue.thread), NULL, writer_run, NULL);
+    if unlikely (rv != 0) {
+        (void) sem_destroy(&(queue.ready));
+        return false;
+    }
+
+    __atomic_store_n(&(queue.running), true, __ATOMIC_RELEASE);
+    rv = atexit(writer_stop);
+    if unlikely (rv != 0) {
+        // no flush on exit, so write synchronously instead
+        writer_stop();
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Flush the queue and join the writer thread.
+ */
+void writer_stop(void) {
+    if (!__atomic_load_n(&(queue.running), __ATOMIC_ACQUIRE)) {
+        return;
+    }
+
+    __atomic_store_n(&(queue.stopping), true, __ATOMIC_RELEASE);
+    (void) sem_post(&(queue.ready));
+    (void) pthread_join(queue.thread, NULL);
+    (void) sem_destroy(&(queue.ready));
+
+    __atomic_store_n(&(queue.running), false, __ATOMIC_RELEASE);
+    __atomic_store_n(&(queue.stopping), false, __ATOMIC_RELAXED);
+}
+
+[[gnu::nonnull(1)]]
+/**
+ * Queue a message for the writer thread, or write it directly without one.
+ */
+static void writer_queue(const char *NONNULL data, const size_t len) {
+    if unlikely (!__atomic_load_n(&(queue.running), __ATOMIC_ACQUIRE)) {
+        (void) fwrite(data, 1, len, stdout);
+        return;
+    }
+
+    // bounded memory: wait for the writer when the queue is full, unless it's empty (for huge messages)
+    size_t pending = __atomic_load_n(&(queue.pending), __ATOMIC_ACQUIRE);
+    while unlikely (pending > 0 && pending + len > WRITER_QUEUE_BYTES) {
+        sched_yield();
+        pending = __atomic_load_n(&(queue.pending), __ATOMIC_ACQUIRE);
+    }
+
+    writer_node_t *NULLABLE node = malloc(sizeof(writer_node_t) + len);
+    if unlikely (node == NULL) {
+        // keep the output, even if out of order
+        write_all(data, len);
+        return;
+    }
+    node->len = len;
+    memcpy(node->data, data, len);
+
+    __atomic_fetch_add(&(queue.pending), len, __ATOMIC_RELAXED);
+    queue_push(node);
+    (void) sem_post(&(queue.ready));
+}
+
+/**
+ * Output held back for a group of threads.
+ */
+struct writer_capture {
+    /** Serializes the threads sharing the capture. */
+    pthread_mutex_t lock;
+    /** Captured bytes, not NUL-terminated. */
+    char *NULLABLE data;
+    /** Bytes in `data`. */
+    size_t len;
+    /** Allocated bytes of `data`. */
+    size_t capacity;
+};
+
+/** Initial allocation of a capture, doubled when full. */
+static constexpr size_t CAPTURE_INITIAL_CAPACITY = 1024;
+
+/** Capture of the current thread, if any. */
+static thread_local writer_capture_t *NULLABLE current_capture = NULL;
+
+writer_capture_t *NULLABLE writer_capture_new(void) {
+    writer_capture_t *NULLABLE capture = malloc(sizeof(writer_capture_t));
+    if unlikely (capture == NULL) {
+        return NULL;
+    }
+
+    *capture = (writer_capture_t) {.lock = PTHREAD_MUTEX_INITIALIZER, .data = NULL, .len = 0, .capacity = 0};
+    return capture;
+}
+
+void writer_capture_release(writer_capture_t *NULLABLE capture) {
+    if unlikely (capture == NULL) {
+        return;
+    }
+
+    if likely (capture->data != NULL) {
+        writer_queue(capture->data, capture->len);
+    }
+    free(capture->data);
+    (void) pthread_mutex_destroy(&(capture->lock));
+    free(capture);
+}
+
+writer_capture_t *NULLABLE writer_capture_get(void) {
+    return current_capture;
+}
+
+void writer_capture_set(writer_capture_t *NULLABLE capture) {
+    current_capture = capture;
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(1, 2)]]
+/**
+ * Append `len` bytes of `data` to `capture`.
+ *
+ * @return `false` if out of memory, leaving `capture` unchanged.
+ */
+static bool capture_append(writer_capture_t *NONNULL capture, const char *NONNULL data, const size_t len) {
+    (void) pthread_mutex_lock(&(capture->lock));
+
+    bool ok = true;
+    if unlikely (capture->len + len > capture->capacity) {
+        size_t capacity = likely(capture->capacity > 0) ? capture->capacity : CAPTURE_INITIAL_CAPACITY;
+        while (capacity < capture->len + len) {
+            capacity *= 2;
+        }
+
+        char *NULLABLE grown = realloc(capture->data, capacity);
+        if likely (grown != NULL) {
+            capture->data = grown;
+            capture->capacity = capacity;
+        } else {
+            ok = false;
+        }
+    }
+    if likely (ok) {
+        memcpy(&(capture->data[capture->len]), data, len);
+        capture->len += len;
+    }
+
+    (void) pthread_mutex_unlock(&(capture->lock));
+    return ok;
+}
+
+/**
+ * Append to the capture of the current thread, or queue the message.
+ */
+void writer_write(const char *NONNULL data, const size_t len) {
+    if unlikely (len == 0) {
+        return;
+    }
+
+    writer_capture_t *NULLABLE capture = current_capture;
+    if (capture != NULL && capture_append(capture, data, len)) {
+        return;
+    }
+    // no capture, or out of memory: keep the output, even if out of order
+    writer_queue(data, len);
+}
+
+/**
+ * Format into a local buffer and queue the result.
+ */
+void writer_printf(const char *NONNULL fmt, ...) {
+    char buf[BUFSIZ] = "";
+
+    va_list ap;
+    va_start(ap, fmt);
+    const int written = vsnprintf(buf, BUFSIZ, fmt, ap);
+    va_end(ap);
+
+    if unlikely (written <= 0) {
+        return;
+    }
+
+    constexpr size_t MAX_BYTES = BUFSIZ - 1;
+    writer_write(buf, likely((size_t) written < MAX_BYTES) ? (size_t) written : MAX_BYTES);
+}
@@ -0,0 +1,73 @@
+#ifndef APP_WRITER_H
+/** Asynchronous writer for the app and enclave output. */
+#define APP_WRITER_H
+
+#include <stddef.h>
+
+#include "defines.h"
+
+[[nodiscard("error must be checked"), gnu::cold]]
+/**
+ * Start the writer thread, which drains all messages to stdout with batched `write(2)` calls. The remaining messages
+ * are flushed by `writer_stop`, which is also registered with `atexit`.
+ *
+ * Without a writer thread, messages are written synchronously to `stdout`.
+ *
+ * @return `false` if the thread could not be started.
+ */
+bool writer_start(void);
+
+[[gnu::cold]]
+/**
+ * Write all queued messages and stop the writer thread. Must not race with other writes.
+ */
+void writer_stop(void);
+
+[[gnu::nonnull(1), gnu::hot]]
+/**
+ * Queue `len` bytes of `data` to stdout, or append them to the capture of the current thread. Messages from the same
+ * thread are written in order.
+ *
+ * When more than `WRITER_QUEUE_BYTES` are waiting, the caller yields until the writer catches up.
+ */
+void writer_write(const char *NONNULL data, size_t len);
+
+/**
+ * Output held back from the queue, so it can be written later as a whole.
+ */
+typedef struct writer_capture writer_capture_t;
+
+[[nodiscard("leaks memory"), gnu::malloc, gnu::nothrow]]
+/**
+ * Create an empty capture.
+ *
+ * @return `NULL` if out of memory.
+ */
+writer_capture_t *NULLABLE writer_capture_new(void);
+
+[[gnu::nothrow]]
+/**
+ * Queue all output held by `capture`, then free it.
+ */
+void writer_capture_release(writer_capture_t *NULLABLE capture);
+
+[[nodiscard("useless call"), gnu::nothrow]]
+/**
+ * Capture of the current thread, or `NULL` if its output goes straight to the queue.
+ */
+writer_capture_t *NULLABLE writer_capture_get(void);
+
+[[gnu::nothrow]]
+/**
+ * Hold all output written by the current thread in `capture`, or send it to the queue again with `NULL`. The same
+ * capture can be shared by multiple threads.
+ */
+void writer_capture_set(writer_capture_t *NULLABLE capture);
+
+[[gnu::format(printf, 1, 2), gnu::nonnull(1)]]
+/**
+ * `printf` through `writer_write`. Output is limited to `BUFSIZ` bytes.
+ */
+void writer_printf(const char *NONNULL fmt, ...);
+
+#endif  // APP_WRITER_H
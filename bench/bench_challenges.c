@@ -0,0 +1,211 @@
+#include <inttypes.h>
+#include <limits.h>
+#include <sgx_defs.h>
+#include <sgx_eid.h>
+#include <sgx_error.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../app/error.h"
+#include "./common.h"
+#include "defines.h"
+#include "enclave_u.h"
+
+/** Number of ECALLs measured after the first one. */
+static constexpr uint64_t CALLS = 100'000;
+
+/**
+ * A single challenge ECALL, with arguments that never solve the challenge.
+ */
+typedef sgx_status_t bench_call_fn(sgx_enclave_id_t eid, int *NONNULL rv);
+
+[[nodiscard("error must be checked"), gnu::nonnull(2)]]
+/** Challenge 2, with an out of range password. It's only rejected after the secret is read. */
+static sgx_status_t call_password(const sgx_enclave_id_t eid, int *NONNULL rv) {
+    return ecall_verificar_senha(eid, rv, 100'000);
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(2)]]
+/** Challenge 3, with a lowercase word, which never matches the secret. */
+static sgx_status_t call_word(const sgx_enclave_id_t eid, int *NONNULL rv) {
+    char guess[20];
+    memset(guess, 'a', sizeof(guess));
+    return ecall_palavra_secreta(eid, rv, guess);
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(2)]]
+/** Challenge 4, evaluating the polynomial. */
+static sgx_status_t call_polynomial(const sgx_enclave_id_t eid, int *NONNULL rv) {
+    const sgx_status_t status = ecall_polinomio_secreto(eid, rv, 1);
+    // any value is valid
+    *rv = -1;
+    return status;
+}
+
+/** Number of points in each `ecall_polinomio_secreto_lote`. */
+static constexpr size_t POLYNOMIAL_BATCH = 4096;
+
+[[nodiscard("error must be checked"), gnu::nonnull(2)]]
+/** Challenge 4, evaluating the polynomial at `POLYNOMIAL_BATCH` points in a single call. */
+static sgx_status_t call_polynomial_batch(const sgx_enclave_id_t eid, int *NONNULL rv) {
+    static int x[POLYNOMIAL_BATCH] = {0};
+    static int y[POLYNOMIAL_BATCH] = {0};
+    // nonzero points, set only once
+    if unlikely (x[0] == 0) {
+        for (size_t i = 0; i < POLYNOMIAL_BATCH; i++) {
+            x[i] = (int) i + 1;
+        }
+    }
+
+    const sgx_status_t status = ecall_polinomio_secreto_lote(eid, rv, x, y, POLYNOMIAL_BATCH);
+    // returns 0 on success
+    *rv = likely(*rv == 0) ? -1 : *rv;
+    return status;
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(2)]]
+/** Challenge 4, verifying coefficients outside the valid range. */
+static sgx_status_t call_verify(const sgx_enclave_id_t eid, int *NONNULL rv) {
+    const sgx_status_t status = ecall_verificar_polinomio(eid, rv, INT_MIN, INT_MIN, INT_MIN);
+    // returns `false` on wrong guesses
+    *rv = likely(*rv == 0) ? -1 : *rv;
+    return status;
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(2)]]
+/** Challenge 5, a full game with 20 OCALLs that always play rock. */
+static sgx_status_t call_game(const sgx_enclave_id_t eid, int *NONNULL rv) {
+    const sgx_status_t status = ecall_pedra_papel_tesoura(eid, rv);
+    // any number of wins is valid, except winning with rock on all rounds
+    *rv = likely(0 <= *rv && *rv < 20) ? -1 : *rv;
+    return status;
+}
+
+/**
+ * A challenge ECALL to be measured.
+ */
+typedef struct scenario {
+    /** Description for the report. */
+    const char *NONNULL name;
+    /** The ECALL. Must set `rv` to `-1` on the expected result. */
+    bench_call_fn *NONNULL call;
+} scenario_t;
+
+/** ECALLs that read a challenge secret. The first call of each secret also generates it. */
+static const scenario_t SCENARIOS[] = {
+    {.name = "ecall_verificar_senha",        .call = call_password        },
+    {.name = "ecall_palavra_secreta",        .call = call_word            },
+    {.name = "ecall_polinomio_secreto",      .call = call_polynomial      },
+    {.name = "ecall_polinomio_secreto_lote", .call = call_polynomial_batch},
+    {.name = "ecall_verificar_polinomio",    .call = call_verify          },
+    {.name = "ecall_pedra_papel_tesoura",    .call = call_game            },
+};
+
+/**
+ * Measurements of a scenario.
+ */
+typedef struct result {
+    /** Latency of the first call. */
+    uint64_t first_ns;
+    /** Average latency of the next `CALLS`. */
+    double steady_ns;
+    /** Enclave counters during the `CALLS`, if `has_counters`. */
+    enclave_stats_t counters;
+    /** If the enclave has `ecall_get_stats`. */
+    bool has_counters;
+} result_t;
+
+[[nodiscard("error must be checked"), gnu::nonnull(2, 3)]]
+/**
+ * Measure the first call of `scenario`, then the average of the next `CALLS`, with the enclave counters of these.
+ */
+static sgx_status_t run_scenario(
+    const sgx_enclave_id_t eid,
+    result_t *NONNULL result,
+    const scenario_t *NONNULL scenario
+) {
+    int rv = 0;
+    uint64_t start = bench_now_ns();
+    sgx_status_t status = scenario->call(eid, &rv);
+    result->first_ns = bench_now_ns() - start;
+    if unlikely (status != SGX_SUCCESS) {
+        return status;
+    }
+    if unlikely (rv != -1) {
+        printf("bench-challenges: unexpected result %d from %s\n", rv, scenario->name);
+        return SGX_ERROR_UNEXPECTED;
+    }
+
+    // unavailable on the pre-compiled enclave
+    result->has_counters = ecall_reset_stats(eid) == SGX_SUCCESS;
+
+    start = bench_now_ns();
+    for (uint64_t i = 0; i < CALLS; i++) {
+        status = scenario->call(eid, &rv);
+        if unlikely (status != SGX_SUCCESS) {
+            return status;
+        }
+        if unlikely (rv != -1) {
+            printf("bench-challenges: unexpected result %d from %s\n", rv, scenario->name);
+            return SGX_ERROR_UNEXPECTED;
+        }
+    }
+    result->steady_ns = (double) (bench_now_ns() - start) / (double) CALLS;
+
+    if likely (result->has_counters) {
+        int counters_rv = -1;
+        status = ecall_get_stats(eid, &counters_rv, &(result->counters));
+        result->has_counters = status == SGX_SUCCESS && counters_rv == 0;
+    }
+    return SGX_SUCCESS;
+}
+
+/**
+ * Challenge ECALL latency: the first call generates the secret, the following ones read the cached value.
+ *
+ * Must run on a freshly loaded enclave, so that the first calls are not cached yet.
+ */
+int SGX_CDECL main(const int argc, const char *restrict NONNULL argv[NONNULL argc]) {
+    sgx_enclave_id_t eid = (sgx_enclave_id_t) -1;
+    if unlikely (!bench_load_enclave(argc, argv, &eid)) {
+        return EXIT_FAILURE;
+    }
+
+    bool ok = true;
+    printf(
+        "%-30s %14s %14s %12s %12s %12s\n",
+        "ecall",
+        "first (ns)",
+        "steady (ns)",
+        "blocks/call",
+        "rejects/call",
+        "ocalls/call"
+    );
+    for (size_t i = 0; i < sizeof(SCENARIOS) / sizeof(SCENARIOS[0]); i++) {
+        result_t result = {.first_ns = UINT64_MAX, .steady_ns = 0, .counters = {}, .has_counters = false};
+        const sgx_status_t status = run_scenario(eid, &result, &SCENARIOS[i]);
+        if unlikely (status != SGX_SUCCESS) {
+            print_error_message(status);
+            ok = false;
+            continue;
+        }
+
+        printf("%-30s %14" PRIu64 " %14.1f", SCENARIOS[i].name, result.first_ns, result.steady_ns);
+        if likely (result.has_counters) {
+            printf(
+                " %12.3f %12.3f %12.3f\n",
+                (double) result.counters.drbg_blocks / (double) CALLS,
+                (double) result.counters.drbg_rejections / (double) CALLS,
+                (double) result.counters.ocalls / (double) CALLS
+            );
+        } else {
+            printf(" %12s %12s %12s\n", "-", "-", "-");
+        }
+    }
+
+    bench_destroy_enclave(eid);
+    return likely(ok) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,166 @@
+#include <sgx_defs.h>
+#include <sgx_eid.h>
+#include <sgx_error.h>
+#include <inttypes.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../app/error.h"
+#include "./common.h"
+#include "defines.h"
+#include "drbg.h"
+#include "enclave_u.h"
+
+/** Total number of blocks or samples generated in each measurement. */
+static constexpr uint64_t TOTAL = UINT64_C(1) << 18;
+/** Number of measurements per scenario, the fastest one is reported. */
+static constexpr unsigned REPEAT = 5;
+/** Number of fresh generators compared by the identity check. */
+static constexpr uint64_t CHECK_STREAMS = 16;
+/** Blocks, samples or digits compared on each generator, enough for several full pool refills. */
+static constexpr uint64_t CHECK_SAMPLES = 4'096;
+
+/** Backend names for the report, indexed by `drbg_backend_id_t`. */
+static const char *const BACKEND_NAMES[DRBG_BACKENDS] = {
+    [DRBG_BACKEND_TCRYPTO] = "tcrypto",
+    [DRBG_BACKEND_AESNI] = "aesni",
+};
+
+/**
+ * A DRBG usage pattern.
+ */
+typedef struct scenario {
+    /** Description for the report. */
+    const char *NONNULL name;
+    /** Number of blocks generated by each fresh generator, or zero for bounded samples. */
+    uint64_t blocks_per_stream;
+    /** Upper bound for bounded samples, or zero for raw blocks. */
+    uint64_t bound;
+    /** Take the samples from a digit stream, instead of one block per sample. */
+    bool digits;
+} scenario_t;
+
+/** Patterns found in the challenges, from a long lived stream to one generator per block. */
+static const scenario_t SCENARIOS[] = {
+    {.name = "block, single stream",           .blocks_per_stream = TOTAL, .bound = 0,           .digits = false},
+    {.name = "block, 20/stream (challenge 3)", .blocks_per_stream = 20,    .bound = 0,           .digits = false},
+    {.name = "block, 3/stream (challenge 4)",  .blocks_per_stream = 3,     .bound = 0,           .digits = false},
+    {.name = "block, 1/stream (challenge 2)",  .blocks_per_stream = 1,     .bound = 0,           .digits = false},
+    {.name = "sample, [0,3)",                  .blocks_per_stream = 0,     .bound = 3,           .digits = false},
+    {.name = "sample, [0,26)",                 .blocks_per_stream = 0,     .bound = 26,          .digits = false},
+    {.name = "sample, [0,100000)",             .blocks_per_stream = 0,     .bound = 100'000,     .digits = false},
+    {.name = "sample, [0,200000001)",          .blocks_per_stream = 0,     .bound = 200'000'001, .digits = false},
+    {.name = "digit, [0,3)",                   .blocks_per_stream = 0,     .bound = 3,           .digits = true },
+    {.name = "digit, [0,26)",                  .blocks_per_stream = 0,     .bound = 26,          .digits = true },
+};
+
+[[nodiscard("error must be checked"), gnu::nonnull(2)]]
+/**
+ * Run a single measurement of `scenario` on `backend`.
+ */
+static sgx_status_t run_once(
+    const sgx_enclave_id_t eid,
+    int *NONNULL rv,
+    const drbg_backend_id_t backend,
+    const scenario_t scenario
+) {
+    if (scenario.bound == 0) {
+        const uint64_t streams = TOTAL / scenario.blocks_per_stream;
+        return ecall_bench_drbg(eid, rv, backend, streams, scenario.blocks_per_stream);
+    } else if (scenario.digits) {
+        return ecall_bench_drbg_digits(eid, rv, backend, (uint8_t) scenario.bound, TOTAL);
+    } else {
+        return ecall_bench_drbg_bounded(eid, rv, backend, scenario.bound, TOTAL);
+    }
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(2)]]
+/**
+ * Run `scenario` `REPEAT` times on `backend`, writing the fastest run duration to `elapsed_ns`.
+ */
+static sgx_status_t run_scenario(
+    const sgx_enclave_id_t eid,
+    uint64_t *NONNULL elapsed_ns,
+    const drbg_backend_id_t backend,
+    const scenario_t scenario
+) {
+    *elapsed_ns = UINT64_MAX;
+    for (unsigned i = 0; i < REPEAT; i++) {
+        int rv = -1;
+        const uint64_t start = bench_now_ns();
+        const sgx_status_t status = run_once(eid, &rv, backend, scenario);
+        const uint64_t end = bench_now_ns();
+
+        if unlikely (status != SGX_SUCCESS) {
+            return status;
+        }
+        if unlikely (rv != 0) {
+            printf("bench-drbg: failed '%s' on %s\n", scenario.name, BACKEND_NAMES[backend]);
+            return SGX_ERROR_UNEXPECTED;
+        }
+
+        if (end - start < *elapsed_ns) {
+            *elapsed_ns = end - start;
+        }
+    }
+    return SGX_SUCCESS;
+}
+
+[[nodiscard("error must be checked")]]
+/**
+ * Check that all backends generate the original DRBG sequences, before measuring them.
+ *
+ * @return `true` if all sequences match.
+ */
+static bool check_identity(const sgx_enclave_id_t eid) {
+    int rv = -1;
+    const sgx_status_t status = ecall_bench_drbg_check(eid, &rv, CHECK_STREAMS, CHECK_SAMPLES);
+    if unlikely (status != SGX_SUCCESS) {
+        print_error_message(status);
+        return false;
+    }
+
+    const char *NONNULL result = likely(rv == 0) ? "ok" : (rv > 0 ? "MISMATCH" : "failed");
+    printf("check: %" PRIu64 " streams x %" PRIu64 " samples: %s\n", CHECK_STREAMS, CHECK_SAMPLES, result);
+    return rv == 0;
+}
+
+/**
+ * DRBG microbenchmark: nanoseconds per block and per bounded sample for each backend, measured inside a single ECALL.
+ * Fails without measuring if the backends don't generate the same sequences.
+ *
+ * Build with `-D drbg_pool_blocks=1` for the unbuffered baseline.
+ */
+int SGX_CDECL main(const int argc, const char *restrict NONNULL argv[NONNULL argc]) {
+    sgx_enclave_id_t eid = (sgx_enclave_id_t) -1;
+    if unlikely (!bench_load_enclave(argc, argv, &eid)) {
+        return EXIT_FAILURE;
+    }
+
+    if unlikely (!check_identity(eid)) {
+        bench_destroy_enclave(eid);
+        return EXIT_FAILURE;
+    }
+
+    bool ok = true;
+    printf("%-8s %-32s %14s %10s\n", "backend", "scenario", "ops/s", "ns/op");
+    for (size_t backend = 0; backend < DRBG_BACKENDS; backend++) {
+        for (size_t i = 0; i < sizeof(SCENARIOS) / sizeof(SCENARIOS[0]); i++) {
+            uint64_t elapsed_ns = UINT64_MAX;
+            const sgx_status_t status = run_scenario(eid, &elapsed_ns, (drbg_backend_id_t) backend, SCENARIOS[i]);
+            if unlikely (status != SGX_SUCCESS) {
+                print_error_message(status);
+                ok = false;
+                continue;
+            }
+
+            const double ns_per_op = (double) elapsed_ns / (double) TOTAL;
+            printf("%-8s %-32s %14.0f %10.1f\n", BACKEND_NAMES[backend], SCENARIOS[i].name, 1e9 / ns_per_op, ns_per_op);
+        }
+    }
+
+    bench_destroy_enclave(eid);
+    return likely(ok) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
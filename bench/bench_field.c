@@ -0,0 +1,400 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../app/field.h"
+#include "defines.h"
+
+/** Number of interpolation problems, unless given as `argv[1]`. */
+static constexpr size_t DEFAULT_PROBLEMS = 1 << 16;
+/** Number of measurements per scenario, the fastest one is reported. */
+static constexpr unsigned REPEAT = 5;
+
+/** Backend names for the report, indexed by `fp_backend_t`. */
+static const char *const BACKEND_NAMES[FP_BACKENDS] = {
+    [FP_BACKEND_SCALAR] = "scalar",
+    [FP_BACKEND_AVX2] = "avx2",
+    [FP_BACKEND_AVX512] = "avx512",
+};
+
+[[nodiscard("useless call"), gnu::const]]
+/**
+ * SplitMix64 finalizer.
+ */
+static uint64_t mix(uint64_t x) {
+    x = (x ^ (x >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+    x = (x ^ (x >> 27)) * UINT64_C(0x94D049BB133111EB);
+    return x ^ (x >> 31);
+}
+
+[[nodiscard("useless call"), gnu::const]]
+/**
+ * Random value in `[0, FP_P)` for `seed`.
+ */
+static uint32_t random_value(const uint64_t seed) {
+    return (uint32_t) ((mix(seed) >> 32) % FP_P);
+}
+
+[[nodiscard("useless call"), gnu::const]]
+/**
+ * Random value in `[1, FP_P)` for `seed`, so it has an inverse.
+ */
+static uint32_t random_nonzero(const uint64_t seed) {
+    return 1 + (uint32_t) ((mix(seed) >> 32) % (FP_P - 1));
+}
+
+[[nodiscard("useless call"), gnu::const]]
+/**
+ * `(a * b) % FP_P` with a 64-bit division, like the previous challenge 4 helpers.
+ */
+static uint32_t mod_mul(const uint32_t a, const uint32_t b) {
+    return (uint32_t) (((uint64_t) a * (uint64_t) b) % FP_P);
+}
+
+[[nodiscard("useless call"), gnu::const]]
+/**
+ * `(a + b) % FP_P` with a 64-bit division.
+ */
+static uint32_t mod_add(const uint32_t a, const uint32_t b) {
+    return (uint32_t) (((uint64_t) a + (uint64_t) b) % FP_P);
+}
+
+[[nodiscard("useless call"), gnu::const]]
+/**
+ * `(a - b) % FP_P` with a 64-bit division.
+ */
+static uint32_t mod_sub(const uint32_t a, const uint32_t b) {
+    return (uint32_t) (((uint64_t) a + FP_P - (uint64_t) b) % FP_P);
+}
+
+[[nodiscard("useless call"), gnu::const]]
+/**
+ * Square-and-multiply `a^(p-2)`, with a division on every step.
+ */
+static uint32_t mod_inv(const uint32_t a) {
+    uint32_t base = a;
+    uint32_t result = 1;
+    for (uint32_t n = FP_P - 2; n > 0; n /= 2) {
+        if (n % 2 != 0) {
+            result = mod_mul(result, base);
+        }
+        base = mod_mul(base, base);
+    }
+    return result;
+}
+
+[[nodiscard("useless call"), gnu::const]]
+/**
+ * Baseline: the same Cramer's rule as `fp_interpolate`, with the division-based helpers.
+ */
+static fp_quadratic_t mod_interpolate(
+    const uint32_t x1,
+    const uint32_t y1,
+    const uint32_t x2,
+    const uint32_t y2,
+    const uint32_t x3,
+    const uint32_t y3
+) {
+    const uint32_t iD = mod_inv(mod_mul(mod_mul(mod_sub(x1, x2), mod_sub(x1, x3)), mod_sub(x2, x3)));
+    const uint32_t x1x1 = mod_mul(x1, x1);
+    const uint32_t x2x2 = mod_mul(x2, x2);
+    const uint32_t x3x3 = mod_mul(x3, x3);
+
+    const uint32_t Na =
+        mod_add(mod_add(mod_mul(x1, mod_sub(y3, y2)), mod_mul(x2, mod_sub(y1, y3))), mod_mul(x3, mod_sub(y2, y1)));
+    const uint32_t Nb = mod_add(
+        mod_add(mod_mul(x1x1, mod_sub(y2, y3)), mod_mul(x2x2, mod_sub(y3, y1))),
+        mod_mul(x3x3, mod_sub(y1, y2))
+    );
+    const uint32_t Nc = mod_add(
+        mod_add(
+            mod_mul(x1x1, mod_sub(mod_mul(x2, y3), mod_mul(x3, y2))),
+            mod_mul(x2x2, mod_sub(mod_mul(x3, y1), mod_mul(x1, y3)))
+        ),
+        mod_mul(x3x3, mod_sub(mod_mul(x1, y2), mod_mul(x2, y1)))
+    );
+    return (fp_quadratic_t) {.a = mod_mul(Na, iD), .b = mod_mul(Nb, iD), .c = mod_mul(Nc, iD)};
+}
+
+/**
+ * Interpolation problems in columns, and the expected coefficients.
+ */
+typedef struct problems {
+    /** Number of problems. */
+    size_t count;
+    /** `x[k][i]` of point `k` of problem `i`, all distinct for the same `i`. */
+    uint32_t *NONNULL x[3];
+    /** `y[k][i]` of point `k` of problem `i`. */
+    uint32_t *NONNULL y[3];
+    /** Coefficients of problem `i`, from the division-based baseline. */
+    fp_quadratic_t *NONNULL expected;
+    /** Output columns for the batch interpolation. */
+    uint32_t *NONNULL coefficients[3];
+} problems_t;
+
+[[nodiscard("useless call")]]
+/**
+ * Monotonic clock, in nanoseconds.
+ */
+static uint64_t now_ns(void) {
+    struct timespec now = {};
+    (void) clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1'000'000'000 + (uint64_t) now.tv_nsec;
+}
+
+[[gnu::nonnull(1)]]
+/**
+ * Show `ns` for `count` operations as millions of operations per second and nanoseconds per operation.
+ */
+static void print_row(const char *NONNULL name, const size_t count, const uint64_t ns) {
+    const double ns_per_op = (double) ns / (double) count;
+    printf("%-32s %12.2f %10.2f\n", name, 1e3 / ns_per_op, ns_per_op);
+}
+
+[[nodiscard("useless call"), gnu::nonnull(1)]]
+/**
+ * Fastest of `REPEAT` runs of the division-based baseline, or `UINT64_MAX` if some result differs from the expected.
+ */
+static uint64_t bench_mod(const problems_t *NONNULL problems) {
+    uint64_t best = UINT64_MAX;
+    for (unsigned r = 0; r < REPEAT; r++) {
+        bool ok = true;
+        const uint64_t start = now_ns();
+        for (size_t i = 0; i < problems->count; i++) {
+            const fp_quadratic_t poly = mod_interpolate(
+                problems->x[0][i],
+                problems->y[0][i],
+                problems->x[1][i],
+                problems->y[1][i],
+                problems->x[2][i],
+                problems->y[2][i]
+            );
+            ok &= poly.a == problems->expected[i].a && poly.b == problems->expected[i].b
+                && poly.c == problems->expected[i].c;
+        }
+        const uint64_t elapsed = now_ns() - start;
+        if unlikely (!ok) {
+            return UINT64_MAX;
+        }
+        best = likely(elapsed < best) ? elapsed : best;
+    }
+    return best;
+}
+
+[[nodiscard("useless call"), gnu::nonnull(1)]]
+/**
+ * Fastest of `REPEAT` runs of `fp_interpolate` on each problem, or `UINT64_MAX` on wrong results.
+ */
+static uint64_t bench_single(const problems_t *NONNULL problems) {
+    uint64_t best = UINT64_MAX;
+    for (unsigned r = 0; r < REPEAT; r++) {
+        bool ok = true;
+        const uint64_t start = now_ns();
+        for (size_t i = 0; i < problems->count; i++) {
+            const fp_quadratic_t poly = fp_interpolate(
+                problems->x[0][i],
+                problems->y[0][i],
+                problems->x[1][i],
+                problems->y[1][i],
+                problems->x[2][i],
+                problems->y[2][i]
+            );
+            ok &= poly.a == problems->expected[i].a && poly.b == problems->expected[i].b
+                && poly.c == problems->expected[i].c;
+        }
+        const uint64_t elapsed = now_ns() - start;
+        if unlikely (!ok) {
+            return UINT64_MAX;
+        }
+        best = likely(elapsed < best) ? elapsed : best;
+    }
+    return best;
+}
+
+[[nodiscard("useless call"), gnu::nonnull(2)]]
+/**
+ * Fastest of `REPEAT` runs of `fp_interpolate_batch` on `backend`, or `UINT64_MAX` on wrong results.
+ */
+static uint64_t bench_batch(const fp_backend_t backend, problems_t *NONNULL problems) {
+    const uint32_t *const x[3] = {problems->x[0], problems->x[1], problems->x[2]};
+    const uint32_t *const y[3] = {problems->y[0], problems->y[1], problems->y[2]};
+
+    uint64_t best = UINT64_MAX;
+    for (unsigned r = 0; r < REPEAT; r++) {
+        const uint64_t start = now_ns();
+        const bool solved = fp_interpolate_batch(backend, problems->coefficients, x, y, problems->count);
+        const uint64_t elapsed = now_ns() - start;
+        if unlikely (!solved) {
+            return UINT64_MAX;
+        }
+        best = likely(elapsed < best) ? elapsed : best;
+    }
+
+    for (size_t i = 0; i < problems->count; i++) {
+        if unlikely (
+            problems->coefficients[0][i] != problems->expected[i].a
+            || problems->coefficients[1][i] != problems->expected[i].b
+            || problems->coefficients[2][i] != problems->expected[i].c
+        ) {
+            return UINT64_MAX;
+        }
+    }
+    return best;
+}
+
+[[nodiscard("useless call"), gnu::nonnull(2, 3, 4)]]
+/**
+ * Fastest of `REPEAT` runs of `fp_mul_batch` on `backend`.
+ */
+static uint64_t bench_mul(
+    const fp_backend_t backend,
+    uint32_t out[NONNULL],
+    const uint32_t a[NONNULL],
+    const uint32_t b[NONNULL],
+    const size_t n
+) {
+    uint64_t best = UINT64_MAX;
+    for (unsigned r = 0; r < REPEAT; r++) {
+        const uint64_t start = now_ns();
+        fp_mul_batch(backend, out, a, b, n);
+        const uint64_t elapsed = now_ns() - start;
+        best = likely(elapsed < best) ? elapsed : best;
+    }
+    return best;
+}
+
+[[nodiscard("useless call"), gnu::nonnull(2, 3)]]
+/**
+ * Fastest of `REPEAT` runs of `fp_inv_batch` on `backend`, or `UINT64_MAX` if some inverse is wrong.
+ */
+static uint64_t bench_inv(
+    const fp_backend_t backend,
+    uint32_t *restrict NONNULL out,
+    const uint32_t *restrict NONNULL in,
+    const size_t n
+) {
+    uint64_t best = UINT64_MAX;
+    for (unsigned r = 0; r < REPEAT; r++) {
+        const uint64_t start = now_ns();
+        const bool inverted = fp_inv_batch(backend, out, in, n);
+        const uint64_t elapsed = now_ns() - start;
+        if unlikely (!inverted) {
+            return UINT64_MAX;
+        }
+        best = likely(elapsed < best) ? elapsed : best;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        if unlikely (fp_mul(out[i], in[i]) != 1) {
+            return UINT64_MAX;
+        }
+    }
+    return best;
+}
+
+/**
+ * F_p microbenchmark: quadratic interpolations per second for the division-based baseline, the scalar
+ * `fp_interpolate` and `fp_interpolate_batch` on each backend supported by this CPU, for `argv[1]` random problems.
+ * Batch multiplications and inversions are also reported per value. All results are checked against the baseline.
+ */
+int main(const int argc, const char *restrict NONNULL argv[NONNULL argc]) {
+    size_t count = DEFAULT_PROBLEMS;
+    if (argc > 1) {
+        char *end = NULL;
+        count = (size_t) strtoull(argv[1], &end, 10);
+        if unlikely (count == 0 || end == argv[1] || *end != '\0') {
+            (void) fprintf(stderr, "usage: %s [problems]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    static constexpr size_t COLUMNS = 9;
+    uint32_t *columns[COLUMNS] = {};
+    bool ok = true;
+    for (size_t k = 0; k < COLUMNS; k++) {
+        columns[k] = calloc(count, sizeof(uint32_t));
+        ok &= columns[k] != NULL;
+    }
+    fp_quadratic_t *expected = calloc(count, sizeof(fp_quadratic_t));
+    uint32_t *inverses = calloc(count, sizeof(uint32_t));
+    if unlikely (!ok || expected == NULL || inverses == NULL) {
+        (void) fprintf(stderr, "out of memory\n");
+        for (size_t k = 0; k < COLUMNS; k++) {
+            free(columns[k]);
+        }
+        free(expected);
+        free(inverses);
+        return EXIT_FAILURE;
+    }
+
+    problems_t problems = {.count = count, .expected = expected};
+    for (size_t k = 0; k < 3; k++) {
+        problems.x[k] = columns[k];
+        problems.y[k] = columns[3 + k];
+        problems.coefficients[k] = columns[6 + k];
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        uint64_t seed = mix(i);
+        for (size_t k = 0; k < 3; k++) {
+            // x are nonzero, for the inversion benchmark, and distinct for the same problem
+            bool repeated = true;
+            while (repeated) {
+                problems.x[k][i] = random_nonzero(seed++);
+                repeated = (k > 0 && problems.x[k][i] == problems.x[0][i])
+                    || (k > 1 && problems.x[k][i] == problems.x[1][i]);
+            }
+            problems.y[k][i] = random_value(seed++);
+        }
+        expected[i] = mod_interpolate(
+            problems.x[0][i],
+            problems.y[0][i],
+            problems.x[1][i],
+            problems.y[1][i],
+            problems.x[2][i],
+            problems.y[2][i]
+        );
+    }
+
+    printf("%-32s %12s %10s\n", "operation", "M ops/s", "ns/op");
+
+    const uint64_t mod_ns = bench_mod(&problems);
+    const uint64_t single_ns = bench_single(&problems);
+    ok = mod_ns != UINT64_MAX && single_ns != UINT64_MAX;
+    print_row("interpolate, % (baseline)", count, mod_ns);
+    print_row("interpolate, shift-and-add", count, single_ns);
+
+    for (size_t backend = 0; backend < FP_BACKENDS && ok; backend++) {
+        if (!fp_backend_supported((fp_backend_t) backend)) {
+            printf("%-32s %12s\n", BACKEND_NAMES[backend], "unsupported");
+            continue;
+        }
+
+        char name[64];
+        const uint64_t batch_ns = bench_batch((fp_backend_t) backend, &problems);
+        (void) snprintf(name, sizeof(name), "interpolate batch, %s", BACKEND_NAMES[backend]);
+        print_row(name, count, batch_ns);
+
+        const uint64_t mul_ns = bench_mul((fp_backend_t) backend, inverses, problems.x[0], problems.x[1], count);
+        (void) snprintf(name, sizeof(name), "mul batch, %s", BACKEND_NAMES[backend]);
+        print_row(name, count, mul_ns);
+
+        const uint64_t inv_ns = bench_inv((fp_backend_t) backend, inverses, problems.x[0], count);
+        (void) snprintf(name, sizeof(name), "inverse batch, %s", BACKEND_NAMES[backend]);
+        print_row(name, count, inv_ns);
+
+        ok &= batch_ns != UINT64_MAX && inv_ns != UINT64_MAX;
+    }
+    if unlikely (!ok) {
+        (void) fprintf(stderr, "wrong results\n");
+    }
+
+    for (size_t k = 0; k < COLUMNS; k++) {
+        free(columns[k]);
+    }
+    free(expected);
+    free(inverses);
+    return likely(ok) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,52 @@
+#include <sgx_defs.h>
+#include <sgx_eid.h>
+#include <sgx_error.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../app/challenge/challenges.h"
+#include "../app/error.h"
+#include "./common.h"
+#include "app_config.h"
+#include "defines.h"
+
+/** Number of searches measured for each thread count. */
+static constexpr uint64_t SEARCHES = 10;
+
+/**
+ * Password search: wall-clock time of challenge 2 from 1 to `APP_THREADS` threads sharing the same enclave.
+ *
+ * The enclave shows the success banner after every search.
+ */
+int SGX_CDECL main(const int argc, const char *restrict NONNULL argv[NONNULL argc]) {
+    sgx_enclave_id_t eid = (sgx_enclave_id_t) -1;
+    if unlikely (!bench_load_enclave(argc, argv, &eid)) {
+        return EXIT_FAILURE;
+    }
+
+    bool ok = true;
+    double elapsed_ms[APP_THREADS] = {};
+    for (size_t threads = 1; threads <= APP_THREADS && ok; threads++) {
+        const uint64_t start = bench_now_ns();
+        for (uint64_t i = 0; i < SEARCHES; i++) {
+            const sgx_status_t status = challenge_2_threads(eid, threads);
+            if unlikely (status != SGX_SUCCESS) {
+                print_error_message(status);
+                ok = false;
+                break;
+            }
+        }
+        elapsed_ms[threads - 1] = (double) (bench_now_ns() - start) / (1e6 * (double) SEARCHES);
+    }
+
+    printf("%7s %14s %8s\n", "threads", "search (ms)", "speedup");
+    const double single_thread = elapsed_ms[0];
+    for (size_t threads = 1; threads <= APP_THREADS && ok; threads++) {
+        printf("%7zu %14.3f %7.2fx\n", threads, elapsed_ms[threads - 1], single_thread / elapsed_ms[threads - 1]);
+    }
+
+    bench_destroy_enclave(eid);
+    return likely(ok) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,212 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../app/challenge/rps_solver.h"
+#include "defines.h"
+
+/** Number of simulated enclaves, unless given as `argv[1]`. */
+static constexpr size_t DEFAULT_SEEDS = 1'000;
+
+[[nodiscard("useless call"), gnu::const]]
+/**
+ * SplitMix64 finalizer.
+ */
+static uint64_t mix(uint64_t x) {
+    x = (x ^ (x >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+    x = (x ^ (x >> 27)) * UINT64_C(0x94D049BB133111EB);
+    return x ^ (x >> 31);
+}
+
+[[nodiscard("useless call"), gnu::nonnull(2), gnu::pure]]
+/**
+ * Simulated `ecall_pedra_papel_tesoura`: the enclave play on each round is a hash of `seed` and all previous app
+ * plays, like a PRNG keyed by the game so far.
+ */
+static uint8_t play_game(const uint64_t seed, const uint8_t answers[NONNULL RPS_ROUNDS]) {
+    uint64_t state = mix(seed);
+    size_t wins = 0;
+    for (size_t round = 0; round < RPS_ROUNDS; round++) {
+        const uint64_t enclave_play = ((state >> 32) * 3) >> 32;
+        wins += (answers[round] == (enclave_play + 1) % 3);
+        state = mix(state + answers[round] + 1);
+    }
+    return (uint8_t) wins;
+}
+
+/** Failed search, from an inconsistent oracle or out of memory. */
+static constexpr size_t FAILED = SIZE_MAX;
+
+[[nodiscard("useless call"), gnu::nonnull(2)]]
+/**
+ * Games played by the prefix search of `challenge_5_exact` from `prefix`, with its branches searched in order.
+ */
+static size_t search_games(const uint64_t seed, const rps_prefix_t *NONNULL prefix) {
+    size_t games = 0;
+    for (uint8_t play = 0; play < 3; play++) {
+        if ((prefix->branches & (1U << play)) == 0) {
+            continue;
+        }
+
+        uint8_t answers[RPS_ROUNDS] = {};
+        memcpy(answers, prefix->plays, prefix->length * sizeof(uint8_t));
+        answers[prefix->length] = play;
+        while (true) {
+            const uint8_t wins = play_game(seed, answers);
+            games++;
+            if unlikely (wins == RPS_ROUNDS) {
+                return games;
+            }
+            if unlikely (!rps_search_next(answers, wins, prefix->length + 1)) {
+                break;
+            }
+        }
+    }
+    return FAILED;
+}
+
+[[nodiscard("useless call"), gnu::nonnull(2, 3)]]
+/**
+ * Games played by the propagation search of `challenge_5_exact`, including the prefix search after
+ * `RPS_PROPAGATION_GAMES`, which starts from the established plays and is counted in full. The peak number of
+ * prefixes is written to `nodes`, and whether it fell back to `fallback`.
+ */
+static size_t propagation_games(const uint64_t seed, size_t *NONNULL nodes, bool *NONNULL fallback) {
+    rps_solver_t *solver = rps_solver_new();
+    if unlikely (solver == NULL) {
+        return FAILED;
+    }
+
+    size_t games = FAILED;
+    size_t played = 0;
+    uint8_t answers[RPS_ROUNDS] = {};
+    while (played < RPS_PROPAGATION_GAMES && rps_solver_next(solver, answers)) {
+        const uint8_t wins = play_game(seed, answers);
+        played++;
+        if unlikely (wins == RPS_ROUNDS) {
+            games = played;
+            break;
+        }
+        if unlikely (!rps_solver_observe(solver, answers, wins)) {
+            break;
+        }
+    }
+
+    *nodes = rps_solver_nodes(solver);
+    *fallback = unlikely(played >= RPS_PROPAGATION_GAMES) && games == FAILED;
+    rps_prefix_t prefix = RPS_PREFIX_EMPTY;
+    const bool consistent = !*fallback || rps_solver_prefix(solver, &prefix);
+    rps_solver_free(solver);
+
+    if unlikely (*fallback) {
+        const size_t search = likely(consistent) ? search_games(seed, &prefix) : FAILED;
+        games = likely(search != FAILED) ? played + search : FAILED;
+    }
+    return games;
+}
+
+[[nodiscard("useless call"), gnu::nonnull(1, 2)]]
+/**
+ * Ascending order of games.
+ */
+static int compare_games(const void *NONNULL a, const void *NONNULL b) {
+    const size_t x = *(const size_t *) a;
+    const size_t y = *(const size_t *) b;
+    return (x > y) - (x < y);
+}
+
+[[nodiscard("useless call")]]
+/**
+ * Monotonic clock, in nanoseconds.
+ */
+static uint64_t now_ns(void) {
+    struct timespec now = {};
+    (void) clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1'000'000'000 + (uint64_t) now.tv_nsec;
+}
+
+[[gnu::nonnull(1, 3)]]
+/**
+ * Print mean, p50, p99 and max of the `seeds` sorted `games`, and the mean solver time in microseconds.
+ */
+static void print_row(const char *NONNULL name, const size_t seeds, size_t games[NONNULL seeds], const uint64_t ns) {
+    qsort(games, seeds, sizeof(size_t), compare_games);
+
+    double total = 0;
+    for (size_t i = 0; i < seeds; i++) {
+        total += (double) games[i];
+    }
+    printf(
+        "%-12s %10.1f %8zu %8zu %8zu %12.1f\n",
+        name,
+        total / (double) seeds,
+        games[seeds / 2],
+        games[(seeds * 99) / 100],
+        games[seeds - 1],
+        (double) ns / (1e3 * (double) seeds)
+    );
+}
+
+/**
+ * Exact solvers of challenge 5: games played by the prefix search and the propagation search against simulated
+ * enclaves, one for each seed in `0 .. argv[1]`. The real enclave always has the same plays, so it can't show the
+ * spread between enclaves.
+ */
+int main(const int argc, const char *restrict NONNULL argv[NONNULL argc]) {
+    size_t seeds = DEFAULT_SEEDS;
+    if (argc > 1) {
+        char *end = NULL;
+        seeds = (size_t) strtoull(argv[1], &end, 10);
+        if unlikely (seeds == 0 || end == argv[1] || *end != '\0') {
+            (void) fprintf(stderr, "usage: %s [seeds]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    size_t *search = calloc(seeds, sizeof(size_t));
+    size_t *propagation = calloc(seeds, sizeof(size_t));
+    if unlikely (search == NULL || propagation == NULL) {
+        (void) fprintf(stderr, "out of memory\n");
+        free(search);
+        free(propagation);
+        return EXIT_FAILURE;
+    }
+
+    bool ok = true;
+    uint64_t start = now_ns();
+    for (size_t seed = 0; seed < seeds && ok; seed++) {
+        search[seed] = search_games(seed, &RPS_PREFIX_EMPTY);
+        ok = likely(search[seed] != FAILED);
+    }
+    const uint64_t search_ns = now_ns() - start;
+
+    size_t max_nodes = 0;
+    size_t fallbacks = 0;
+    start = now_ns();
+    for (size_t seed = 0; seed < seeds && ok; seed++) {
+        size_t nodes = 0;
+        bool fallback = false;
+        propagation[seed] = propagation_games(seed, &nodes, &fallback);
+        ok = likely(propagation[seed] != FAILED);
+        max_nodes = likely(nodes <= max_nodes) ? max_nodes : nodes;
+        fallbacks += fallback;
+    }
+    const uint64_t propagation_ns = now_ns() - start;
+
+    if likely (ok) {
+        printf("%-12s %10s %8s %8s %8s %12s\n", "solver", "mean games", "p50", "p99", "max", "time (us)");
+        print_row("search", seeds, search, search_ns);
+        print_row("propagation", seeds, propagation, propagation_ns);
+        printf("%zu seeds, at most %zu prefixes kept by the propagation search\n", seeds, max_nodes);
+        printf("%zu seeds fell back to the prefix search after %zu games\n", fallbacks, RPS_PROPAGATION_GAMES);
+    } else {
+        (void) fprintf(stderr, "solver failed\n");
+    }
+
+    free(search);
+    free(propagation);
+    return likely(ok) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,164 @@
+#include <pthread.h>
+#include <sched.h>
+#include <sgx_defs.h>
+#include <sgx_eid.h>
+#include <sgx_error.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../app/error.h"
+#include "./common.h"
+#include "defines.h"
+#include "enclave_config.h"
+#include "enclave_u.h"
+
+/** Number of ECALLs made by each thread, per measurement. */
+static constexpr uint64_t CALLS_PER_THREAD = 20'000;
+
+/**
+ * A seed access pattern.
+ */
+typedef struct scenario {
+    /** Description for the report. */
+    const char *NONNULL name;
+    /** Number of generators initialized by each ECALL. */
+    uint64_t generators;
+} scenario_t;
+
+/** From transition bound (one seed read per ECALL) to seed bound (many seed reads per ECALL). */
+static const scenario_t SCENARIOS[] = {
+    {.name = "1 seed read/ECALL",    .generators = 1    },
+    {.name = "1000 seed reads/ECALL", .generators = 1'000},
+};
+
+/**
+ * State for each benchmark thread.
+ */
+typedef struct worker {
+    /** Shared enclave. */
+    sgx_enclave_id_t eid;
+    /** Measured scenario. */
+    const scenario_t *NONNULL scenario;
+    /** Synchronized start for all workers and the main thread. */
+    pthread_barrier_t *NONNULL start;
+    /** Result of the ECALLs. */
+    sgx_status_t status;
+} worker_t;
+
+[[gnu::nonnull(1)]]
+/**
+ * Thread entry: make `CALLS_PER_THREAD` ECALLs, retrying when all TCS are busy.
+ */
+static void *NULLABLE worker_run(void *NONNULL arg) {
+    worker_t *NONNULL worker = (worker_t *) arg;
+    (void) pthread_barrier_wait(worker->start);
+
+    for (uint64_t i = 0; i < CALLS_PER_THREAD; i++) {
+        int rv = -1;
+        sgx_status_t status = SGX_ERROR_OUT_OF_TCS;
+        while (status == SGX_ERROR_OUT_OF_TCS) {
+            status = ecall_bench_seed(worker->eid, &rv, worker->scenario->generators);
+            if unlikely (status == SGX_ERROR_OUT_OF_TCS) {
+                (void) sched_yield();
+            }
+        }
+
+        if unlikely (status != SGX_SUCCESS || rv != 0) {
+            worker->status = likely(status != SGX_SUCCESS) ? status : SGX_ERROR_UNEXPECTED;
+            return NULL;
+        }
+    }
+
+    worker->status = SGX_SUCCESS;
+    return NULL;
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(2, 3)]]
+/**
+ * Run `scenario` on `threads` concurrent threads, writing the total duration to `elapsed_ns`.
+ */
+static sgx_status_t run_scenario(
+    const sgx_enclave_id_t eid,
+    uint64_t *NONNULL elapsed_ns,
+    const scenario_t *NONNULL scenario,
+    const size_t threads
+) {
+    assume(0 < threads && threads <= TCS_NUM);
+
+    pthread_barrier_t start;
+    if unlikely (pthread_barrier_init(&start, NULL, (unsigned) threads + 1) != 0) {
+        return SGX_ERROR_UNEXPECTED;
+    }
+
+    worker_t workers[TCS_NUM];
+    pthread_t handles[TCS_NUM];
+    size_t started = 0;
+    for (; started < threads; started++) {
+        workers[started] = (worker_t) {
+            .eid = eid,
+            .scenario = scenario,
+            .start = &start,
+            .status = SGX_ERROR_UNEXPECTED,
+        };
+        if unlikely (pthread_create(&handles[started], NULL, worker_run, &workers[started]) != 0) {
+            break;
+        }
+    }
+    // threads that failed to start are never waited on, so the barrier would deadlock
+    if unlikely (started < threads) {
+        printf("bench-threads: failed to start thread %zu\n", started);
+        abort();
+    }
+
+    (void) pthread_barrier_wait(&start);
+    const uint64_t begin = bench_now_ns();
+    for (size_t i = 0; i < threads; i++) {
+        (void) pthread_join(handles[i], NULL);
+    }
+    *elapsed_ns = bench_now_ns() - begin;
+    (void) pthread_barrier_destroy(&start);
+
+    for (size_t i = 0; i < threads; i++) {
+        if unlikely (workers[i].status != SGX_SUCCESS) {
+            return workers[i].status;
+        }
+    }
+    return SGX_SUCCESS;
+}
+
+/**
+ * Seed stress benchmark: ECALL throughput from 1 to `TCS_NUM` threads sharing the same enclave.
+ */
+int SGX_CDECL main(const int argc, const char *restrict NONNULL argv[NONNULL argc]) {
+    sgx_enclave_id_t eid = (sgx_enclave_id_t) -1;
+    if unlikely (!bench_load_enclave(argc, argv, &eid)) {
+        return EXIT_FAILURE;
+    }
+
+    bool ok = true;
+    printf("%-24s %7s %14s %8s\n", "scenario", "threads", "ECALLs/s", "speedup");
+    for (size_t i = 0; i < sizeof(SCENARIOS) / sizeof(SCENARIOS[0]); i++) {
+        double single_thread = 0;
+
+        for (size_t threads = 1; threads <= TCS_NUM; threads++) {
+            uint64_t elapsed_ns = UINT64_MAX;
+            const sgx_status_t status = run_scenario(eid, &elapsed_ns, &SCENARIOS[i], threads);
+            if unlikely (status != SGX_SUCCESS) {
+                print_error_message(status);
+                ok = false;
+                break;
+            }
+
+            const double throughput = (double) (threads * CALLS_PER_THREAD) * 1e9 / (double) elapsed_ns;
+            if (threads == 1) {
+                single_thread = throughput;
+            }
+            printf("%-24s %7zu %14.0f %7.2fx\n", SCENARIOS[i].name, threads, throughput, throughput / single_thread);
+        }
+    }
+
+    bench_destroy_enclave(eid);
+    return likely(ok) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
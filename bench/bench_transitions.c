@@ -0,0 +1,602 @@
+#include <inttypes.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sgx_defs.h>
+#include <sgx_eid.h>
+#include <sgx_error.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../app/error.h"
+#include "../app/parallel.h"
+#include "./common.h"
+#include "app_config.h"
+#include "defines.h"
+#include "enclave_config.h"
+#include "enclave_u.h"
+
+/** Calls measured on each thread, for every scenario and thread count. */
+static constexpr size_t CALLS_PER_THREAD = 10'000;
+
+/**
+ * Buffers for the ECALL arguments, owned by a single thread.
+ */
+typedef struct buffers {
+    /** Bytes for the `[in]` and `[in, out]` buffers. */
+    uint8_t bytes[MAX_STRING_LENGTH];
+    /** A NUL-terminated name that never matches. */
+    char name[2];
+    /** A lowercase word, which never matches the secret. */
+    palavra_t word;
+    /** Match bitmask for `word`. */
+    uint32_t mask;
+    /** A game that always plays rock. */
+    jogo_t game;
+    /** Wins of `game`. */
+    uint8_t wins;
+} buffers_t;
+
+/**
+ * A single measured call. Returns `SGX_ERROR_UNEXPECTED` if the ECALL returned an error.
+ */
+typedef sgx_status_t bench_call_fn(sgx_enclave_id_t eid, buffers_t *NONNULL buffers, size_t size);
+
+[[nodiscard("error must be checked"), gnu::nonnull(2)]]
+/** Empty ECALL. */
+static sgx_status_t call_empty(const sgx_enclave_id_t eid, buffers_t *NONNULL buffers, const size_t size) {
+    (void) buffers;
+    (void) size;
+    return ecall_bench_empty(eid);
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(2)]]
+/** Empty ECALL with `size` bytes copied in. */
+static sgx_status_t call_in(const sgx_enclave_id_t eid, buffers_t *NONNULL buffers, const size_t size) {
+    return ecall_bench_in(eid, buffers->bytes, size);
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(2)]]
+/** Empty ECALL with `size` bytes copied in and out. */
+static sgx_status_t call_in_out(const sgx_enclave_id_t eid, buffers_t *NONNULL buffers, const size_t size) {
+    return ecall_bench_in_out(eid, buffers->bytes, size);
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(2)]]
+/** ECALL with a single nested OCALL. */
+static sgx_status_t call_ocall(const sgx_enclave_id_t eid, buffers_t *NONNULL buffers, const size_t size) {
+    (void) buffers;
+    (void) size;
+    int rv = -1;
+    const sgx_status_t status = ecall_bench_ocall(eid, &rv, 1);
+    return likely(status != SGX_SUCCESS || rv == 0) ? status : SGX_ERROR_UNEXPECTED;
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(2)]]
+/** Challenge 1, checking a name that is never valid. */
+static sgx_status_t call_name_check(const sgx_enclave_id_t eid, buffers_t *NONNULL buffers, const size_t size) {
+    (void) size;
+    int rv = 0;
+    const sgx_status_t status = ecall_name_check(eid, &rv, buffers->name);
+    return likely(status != SGX_SUCCESS || rv == -1) ? status : SGX_ERROR_UNEXPECTED;
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(2)]]
+/** Challenge 1, with a name that is never valid. */
+static sgx_status_t call_student(const sgx_enclave_id_t eid, buffers_t *NONNULL buffers, const size_t size) {
+    (void) size;
+    int rv = 0;
+    const sgx_status_t status = ecall_verificar_aluno(eid, &rv, buffers->name);
+    return likely(status != SGX_SUCCESS || rv == -1) ? status : SGX_ERROR_UNEXPECTED;
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(2)]]
+/** Challenge 2, with an out of range password. */
+static sgx_status_t call_password(const sgx_enclave_id_t eid, buffers_t *NONNULL buffers, const size_t size) {
+    (void) buffers;
+    (void) size;
+    int rv = 0;
+    const sgx_status_t status = ecall_verificar_senha(eid, &rv, 100'000);
+    return likely(status != SGX_SUCCESS || rv == -1) ? status : SGX_ERROR_UNEXPECTED;
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(2)]]
+/** Challenge 2, batched, with a single out of range password. */
+static sgx_status_t call_passwords(const sgx_enclave_id_t eid, buffers_t *NONNULL buffers, const size_t size) {
+    (void) buffers;
+    (void) size;
+    const unsigned password = 100'000;
+    int rv = 0;
+    const sgx_status_t status = ecall_verificar_senhas(eid, &rv, &password, 1);
+    return likely(status != SGX_SUCCESS || rv == -1) ? status : SGX_ERROR_UNEXPECTED;
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(2)]]
+/** Challenge 3, with a lowercase word. */
+static sgx_status_t call_word(const sgx_enclave_id_t eid, buffers_t *NONNULL buffers, const size_t size) {
+    (void) size;
+    char guess[sizeof(buffers->word.letras)];
+    memcpy(guess, buffers->word.letras, sizeof(guess));
+    int rv = 0;
+    const sgx_status_t status = ecall_palavra_secreta(eid, &rv, guess);
+    return likely(status != SGX_SUCCESS || rv == -1) ? status : SGX_ERROR_UNEXPECTED;
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(2)]]
+/** Challenge 3, batched, with a single lowercase word. */
+static sgx_status_t call_words(const sgx_enclave_id_t eid, buffers_t *NONNULL buffers, const size_t size) {
+    (void) size;
+    int rv = 0;
+    const sgx_status_t status = ecall_palavras_secretas(eid, &rv, &(buffers->word), &(buffers->mask), 1);
+    return likely(status != SGX_SUCCESS || rv == -1) ? status : SGX_ERROR_UNEXPECTED;
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(2)]]
+/** Challenge 4, evaluating the polynomial. */
+static sgx_status_t call_polynomial(const sgx_enclave_id_t eid, buffers_t *NONNULL buffers, const size_t size) {
+    (void) buffers;
+    (void) size;
+    // any value is valid
+    int rv = 0;
+    return ecall_polinomio_secreto(eid, &rv, 1);
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(2)]]
+/** Challenge 4, batched, evaluating a single point. */
+static sgx_status_t call_polynomial_batch(const sgx_enclave_id_t eid, buffers_t *NONNULL buffers, const size_t size) {
+    (void) buffers;
+    (void) size;
+    const int x = 1;
+    int y = 0;
+    int rv = -1;
+    const sgx_status_t status = ecall_polinomio_secreto_lote(eid, &rv, &x, &y, 1);
+    return likely(status != SGX_SUCCESS || rv == 0) ? status : SGX_ERROR_UNEXPECTED;
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(2)]]
+/** Challenge 4, with coefficients outside the valid range. */
+static sgx_status_t call_verify(const sgx_enclave_id_t eid, buffers_t *NONNULL buffers, const size_t size) {
+    (void) buffers;
+    (void) size;
+    int rv = -1;
+    const sgx_status_t status = ecall_verificar_polinomio(eid, &rv, INT_MIN, INT_MIN, INT_MIN);
+    return likely(status != SGX_SUCCESS || rv == 0) ? status : SGX_ERROR_UNEXPECTED;
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(2)]]
+/** Challenge 4, batched, with a single set of coefficients outside the valid range. */
+static sgx_status_t call_verify_batch(const sgx_enclave_id_t eid, buffers_t *NONNULL buffers, const size_t size) {
+    (void) buffers;
+    (void) size;
+    const coeficientes_t candidate = {.a = INT_MIN, .b = INT_MIN, .c = INT_MIN};
+    int rv = 0;
+    const sgx_status_t status = ecall_verificar_polinomios(eid, &rv, &candidate, 1);
+    return likely(status != SGX_SUCCESS || rv == -1) ? status : SGX_ERROR_UNEXPECTED;
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(2)]]
+/** Challenge 5, a full game with 20 OCALLs that always play rock. */
+static sgx_status_t call_game(const sgx_enclave_id_t eid, buffers_t *NONNULL buffers, const size_t size) {
+    (void) buffers;
+    (void) size;
+    // any number of wins is valid
+    int rv = 0;
+    return ecall_pedra_papel_tesoura(eid, &rv);
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(2)]]
+/** Challenge 5, batched, with a single game that always plays rock. */
+static sgx_status_t call_games(const sgx_enclave_id_t eid, buffers_t *NONNULL buffers, const size_t size) {
+    (void) size;
+    // winning with rock on all rounds is possible, but very unlikely
+    int rv = 0;
+    const sgx_status_t status = ecall_pedra_papel_tesoura_lote(eid, &rv, &(buffers->game), &(buffers->wins), 1);
+    return likely(status != SGX_SUCCESS || rv >= -1) ? status : SGX_ERROR_UNEXPECTED;
+}
+
+/**
+ * A call to be measured.
+ */
+typedef struct scenario {
+    /** Name for the report and the baseline file, without spaces. */
+    const char *NONNULL name;
+    /** The call. */
+    bench_call_fn *NONNULL call;
+    /** Buffer size, for `[in]` and `[in, out]` buffers. */
+    size_t size;
+} scenario_t;
+
+/** Transitions, from the cheapest ECALL to the challenges. */
+static const scenario_t SCENARIOS[] = {
+    {.name = "ecall_empty",                          .call = call_empty,            .size = 0                },
+    {.name = "ecall_in/20",                          .call = call_in,               .size = 20               },
+    {.name = "ecall_in/256",                         .call = call_in,               .size = 256              },
+    {.name = "ecall_in/1024",                        .call = call_in,               .size = 1024             },
+    {.name = "ecall_in/" STR(MAX_STRING_LENGTH),     .call = call_in,               .size = MAX_STRING_LENGTH},
+    {.name = "ecall_in_out/20",                      .call = call_in_out,           .size = 20               },
+    {.name = "ecall_in_out/256",                     .call = call_in_out,           .size = 256              },
+    {.name = "ecall_in_out/1024",                    .call = call_in_out,           .size = 1024             },
+    {.name = "ecall_in_out/" STR(MAX_STRING_LENGTH), .call = call_in_out,           .size = MAX_STRING_LENGTH},
+    {.name = "ecall_ocall",                          .call = call_ocall,            .size = 0                },
+    {.name = "ecall_name_check",                     .call = call_name_check,       .size = 0                },
+    {.name = "ecall_verificar_aluno",                .call = call_student,          .size = 0                },
+    {.name = "ecall_verificar_senha",                .call = call_password,         .size = 0                },
+    {.name = "ecall_verificar_senhas",               .call = call_passwords,        .size = 0                },
+    {.name = "ecall_palavra_secreta",                .call = call_word,             .size = 0                },
+    {.name = "ecall_palavras_secretas",              .call = call_words,            .size = 0                },
+    {.name = "ecall_polinomio_secreto",              .call = call_polynomial,       .size = 0                },
+    {.name = "ecall_polinomio_secreto_lote",         .call = call_polynomial_batch, .size = 0                },
+    {.name = "ecall_verificar_polinomio",            .call = call_verify,           .size = 0                },
+    {.name = "ecall_verificar_polinomios",           .call = call_verify_batch,     .size = 0                },
+    {.name = "ecall_pedra_papel_tesoura",            .call = call_game,             .size = 0                },
+    {.name = "ecall_pedra_papel_tesoura_lote",       .call = call_games,            .size = 0                },
+};
+/** Number of scenarios. */
+static constexpr size_t N_SCENARIOS = sizeof(SCENARIOS) / sizeof(SCENARIOS[0]);
+
+/**
+ * Latency percentiles and throughput of a scenario, for a number of threads.
+ */
+typedef struct result {
+    /** Median latency, in nanoseconds. */
+    uint64_t p50;
+    /** 99th percentile latency, in nanoseconds. */
+    uint64_t p99;
+    /** 99.9th percentile latency, in nanoseconds. */
+    uint64_t p999;
+    /** Calls per second, from all threads. */
+    double throughput;
+} result_t;
+
+/**
+ * State for each benchmark thread.
+ */
+typedef struct worker {
+    /** Shared enclave. */
+    sgx_enclave_id_t eid;
+    /** Measured scenario. */
+    const scenario_t *NONNULL scenario;
+    /** Synchronized start for all workers and the main thread. */
+    pthread_barrier_t *NONNULL start;
+    /** Latency of each call, in nanoseconds. */
+    uint64_t *NONNULL latencies;
+    /** Result of the calls. */
+    sgx_status_t status;
+} worker_t;
+
+[[gnu::nonnull(1)]]
+/**
+ * Thread entry: time `CALLS_PER_THREAD` calls, retrying when all TCS are busy.
+ */
+static void *NULLABLE worker_run(void *NONNULL arg) {
+    worker_t *NONNULL worker = (worker_t *) arg;
+    const scenario_t *NONNULL scenario = worker->scenario;
+
+    buffers_t buffers = {.name = "x", .mask = 0, .wins = 0};
+    memset(buffers.bytes, 0xAA, sizeof(buffers.bytes));
+    memset(buffers.word.letras, 'a', sizeof(buffers.word.letras));
+    memset(buffers.game.jogadas, 0, sizeof(buffers.game.jogadas));
+
+    (void) pthread_barrier_wait(worker->start);
+
+    for (size_t i = 0; i < CALLS_PER_THREAD; i++) {
+        const uint64_t begin = bench_now_ns();
+        const sgx_status_t status = ECALL_RETRY(scenario->call(worker->eid, &buffers, scenario->size));
+        worker->latencies[i] = bench_now_ns() - begin;
+
+        if unlikely (status != SGX_SUCCESS) {
+            worker->status = status;
+            return NULL;
+        }
+    }
+
+    worker->status = SGX_SUCCESS;
+    return NULL;
+}
+
+[[nodiscard("pure function"), gnu::nonnull(1, 2), gnu::pure]]
+/** Order for `qsort`. */
+static int compare_latency(const void *NONNULL a, const void *NONNULL b) {
+    const uint64_t x = *(const uint64_t *) a;
+    const uint64_t y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+[[nodiscard("pure function"), gnu::nonnull(1), gnu::pure]]
+/**
+ * Nearest-rank percentile `permille` of the `count` sorted `latencies`.
+ */
+static uint64_t percentile(const uint64_t latencies[NONNULL], const size_t count, const size_t permille) {
+    assume(count > 0);
+    const size_t rank = (count * permille + 999) / 1000;
+    return latencies[likely(rank > 0) ? rank - 1 : 0];
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(2, 3)]]
+/**
+ * Run `scenario` on `threads` concurrent threads, writing the latency percentiles and throughput to `result`.
+ */
+static sgx_status_t run_scenario(
+    const sgx_enclave_id_t eid,
+    result_t *NONNULL result,
+    const scenario_t *NONNULL scenario,
+    const size_t threads
+) {
+    assume(0 < threads && threads <= TCS_NUM);
+
+    uint64_t *NULLABLE latencies = calloc(threads * CALLS_PER_THREAD, sizeof(uint64_t));
+    if unlikely (latencies == NULL) {
+        return SGX_ERROR_OUT_OF_MEMORY;
+    }
+
+    pthread_barrier_t start;
+    if unlikely (pthread_barrier_init(&start, NULL, (unsigned) threads + 1) != 0) {
+        free(latencies);
+        return SGX_ERROR_UNEXPECTED;
+    }
+
+    worker_t workers[TCS_NUM];
+    pthread_t handles[TCS_NUM];
+    size_t started = 0;
+    for (; started < threads; started++) {
+        workers[started] = (worker_t) {
+            .eid = eid,
+            .scenario = scenario,
+            .start = &start,
+            .latencies = &(latencies[started * CALLS_PER_THREAD]),
+            .status = SGX_ERROR_UNEXPECTED,
+        };
+        if unlikely (pthread_create(&handles[started], NULL, worker_run, &workers[started]) != 0) {
+            break;
+        }
+    }
+    // threads that failed to start are never waited on, so the barrier would deadlock
+    if unlikely (started < threads) {
+        printf("bench-transitions: failed to start thread %zu\n", started);
+        abort();
+    }
+
+    (void) pthread_barrier_wait(&start);
+    const uint64_t begin = bench_now_ns();
+    for (size_t i = 0; i < threads; i++) {
+        (void) pthread_join(handles[i], NULL);
+    }
+    const uint64_t elapsed_ns = bench_now_ns() - begin;
+    (void) pthread_barrier_destroy(&start);
+
+    for (size_t i = 0; i < threads; i++) {
+        if unlikely (workers[i].status != SGX_SUCCESS) {
+            free(latencies);
+            return workers[i].status;
+        }
+    }
+
+    const size_t count = threads * CALLS_PER_THREAD;
+    qsort(latencies, count, sizeof(uint64_t), compare_latency);
+    *result = (result_t) {
+        .p50 = percentile(latencies, count, 500),
+        .p99 = percentile(latencies, count, 990),
+        .p999 = percentile(latencies, count, 999),
+        .throughput = (double) count * 1e9 / (double) elapsed_ns,
+    };
+    free(latencies);
+    return SGX_SUCCESS;
+}
+
+/** Maximum length of a scenario name in the baseline file. */
+static constexpr size_t MAX_NAME = 64;
+
+/**
+ * A result read from the baseline file.
+ */
+typedef struct baseline {
+    /** Scenario name. */
+    char name[MAX_NAME];
+    /** Number of threads. */
+    size_t threads;
+    /** Saved result. */
+    result_t result;
+} baseline_t;
+
+/** Maximum number of results in a baseline file, which may come from a build with more TCS. */
+static constexpr size_t MAX_BASELINE = N_SCENARIOS * TCS_MAX_NUM;
+
+/** Mode of the current build, recorded in the baseline file. */
+static const char *NONNULL const MODE = SGX_SIMULATION ? "sim" : "hw";
+
+[[nodiscard("error must be checked"), gnu::nonnull(1, 2, 3)]]
+/**
+ * Read the results saved in `path` into `baseline`, writing the number of results to `count`.
+ *
+ * @return `false` if the file could not be read.
+ */
+static bool load_baseline(const char *NONNULL path, baseline_t baseline[NONNULL MAX_BASELINE], size_t *NONNULL count) {
+    FILE *NULLABLE file = fopen(path, "r");
+    if unlikely (file == NULL) {
+        perror(path);
+        return false;
+    }
+
+    *count = 0;
+    char line[256];
+    while (*count < MAX_BASELINE && fgets(line, sizeof(line), file) != NULL) {
+        if (line[0] == '#') {
+            char mode[8] = "";
+            if (sscanf(line, "# mode %7s", mode) == 1 && strcmp(mode, MODE) != 0) {
+                printf("bench-transitions: baseline from %s mode, running in %s mode\n", mode, MODE);
+            }
+            continue;
+        }
+
+        baseline_t *NONNULL entry = &(baseline[*count]);
+        const int fields = sscanf(
+            line,
+            "%63s %zu %" SCNu64 " %" SCNu64 " %" SCNu64 " %lf",
+            entry->name,
+            &(entry->threads),
+            &(entry->result.p50),
+            &(entry->result.p99),
+            &(entry->result.p999),
+            &(entry->result.throughput)
+        );
+        if likely (fields == 6) {
+            *count += 1;
+        }
+    }
+
+    (void) fclose(file);
+    return true;
+}
+
+[[nodiscard("pure function"), gnu::nonnull(1, 3), gnu::pure]]
+/**
+ * Find the saved result for `name` with `threads`, or `NULL` if there is none.
+ */
+static const result_t *NULLABLE find_baseline(
+    const baseline_t baseline[NONNULL],
+    const size_t count,
+    const char *NONNULL name,
+    const size_t threads
+) {
+    for (size_t i = 0; i < count; i++) {
+        if (baseline[i].threads == threads && strcmp(baseline[i].name, name) == 0) {
+            return &(baseline[i].result);
+        }
+    }
+    return NULL;
+}
+
+[[nodiscard("pure function"), gnu::const]]
+/** Relative change from `before` to `after`, in percent. */
+static double change(const double before, const double after) {
+    return likely(before > 0) ? 100.0 * (after - before) / before : 0.0;
+}
+
+/**
+ * Transition cost benchmark: latency percentiles and throughput of empty, buffered and nested transitions and all
+ * challenge ECALLs, from 1 to `TCS_NUM` threads sharing the same enclave.
+ *
+ * Results can be saved with `--save FILE`, and compared with a previous run with `--compare FILE`.
+ */
+int SGX_CDECL main(const int argc, const char *restrict NONNULL argv[NONNULL argc]) {
+    const char *NULLABLE save_path = NULL;
+    const char *NULLABLE compare_path = NULL;
+
+    // remaining arguments, for the enclave path
+    const char *NONNULL args[argc];
+    int nargs = 0;
+    args[nargs++] = argv[0];
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--save") == 0 && i + 1 < argc) {
+            save_path = argv[++i];
+        } else if (strcmp(argv[i], "--compare") == 0 && i + 1 < argc) {
+            compare_path = argv[++i];
+        } else {
+            args[nargs++] = argv[i];
+        }
+    }
+
+    baseline_t *NULLABLE baseline = NULL;
+    size_t baseline_count = 0;
+    if (compare_path != NULL) {
+        baseline = calloc(MAX_BASELINE, sizeof(baseline_t));
+        if unlikely (baseline == NULL || !load_baseline(compare_path, baseline, &baseline_count)) {
+            free(baseline);
+            return EXIT_FAILURE;
+        }
+    }
+
+    FILE *NULLABLE save = NULL;
+    if (save_path != NULL) {
+        save = fopen(save_path, "w");
+        if unlikely (save == NULL) {
+            perror(save_path);
+            free(baseline);
+            return EXIT_FAILURE;
+        }
+        (void) fprintf(save, "# mode %s\n", MODE);
+        (void) fprintf(save, "# scenario threads p50_ns p99_ns p999_ns calls_per_s\n");
+    }
+
+    sgx_enclave_id_t eid = (sgx_enclave_id_t) -1;
+    if unlikely (!bench_load_enclave(nargs, args, &eid)) {
+        free(baseline);
+        if (save != NULL) {
+            (void) fclose(save);
+        }
+        return EXIT_FAILURE;
+    }
+
+    bool ok = true;
+    printf("mode: %s, %zu calls per thread\n", MODE, CALLS_PER_THREAD);
+    printf("%-30s %7s %10s %10s %10s %12s", "scenario", "threads", "p50 (ns)", "p99 (ns)", "p999 (ns)", "calls/s");
+    if (baseline != NULL) {
+        printf(" %9s %9s", "p50", "calls/s");
+    }
+    printf("\n");
+
+    for (size_t i = 0; i < N_SCENARIOS; i++) {
+        const scenario_t *NONNULL scenario = &SCENARIOS[i];
+
+        // the first call of each challenge generates its secret, which is not measured
+        result_t warmup = {};
+        sgx_status_t status = run_scenario(eid, &warmup, scenario, 1);
+
+        for (size_t threads = 1; threads <= TCS_NUM && status == SGX_SUCCESS; threads++) {
+            result_t result = {};
+            status = run_scenario(eid, &result, scenario, threads);
+            if unlikely (status != SGX_SUCCESS) {
+                break;
+            }
+
+            printf(
+                "%-30s %7zu %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %12.0f",
+                scenario->name,
+                threads,
+                result.p50,
+                result.p99,
+                result.p999,
+                result.throughput
+            );
+            const result_t *NULLABLE before =
+                baseline != NULL ? find_baseline(baseline, baseline_count, scenario->name, threads) : NULL;
+            if (before != NULL) {
+                printf(
+                    " %+8.1f%% %+8.1f%%",
+                    change((double) before->p50, (double) result.p50),
+                    change(before->throughput, result.throughput)
+                );
+            }
+            printf("\n");
+
+            if (save != NULL) {
+                (void) fprintf(
+                    save,
+                    "%s %zu %" PRIu64 " %" PRIu64 " %" PRIu64 " %.0f\n",
+                    scenario->name,
+                    threads,
+                    result.p50,
+                    result.p99,
+                    result.p999,
+                    result.throughput
+                );
+            }
+        }
+
+        if unlikely (status != SGX_SUCCESS) {
+            printf("bench-transitions: %s failed\n", scenario->name);
+            print_error_message(status);
+            ok = false;
+        }
+    }
+
+    bench_destroy_enclave(eid);
+    free(baseline);
+    if (save != NULL && fclose(save) != 0) {
+        perror(save_path);
+        ok = false;
+    }
+    return likely(ok) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,77 @@
+#include <sgx_defs.h>
+#include <sgx_eid.h>
+#include <sgx_error.h>
+#include <sgx_urts.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "../app/error.h"
+#include "../app/loader.h"
+#include "./common.h"
+#include "defines.h"
+#include "enclave_u.h"
+
+/**
+ * OCALL called by the enclave to print some text to the terminal.
+ **/
+void ocall_print_string(const char *NULLABLE str) {
+    printf("%s", likely(str != NULL) ? str : "<null>");
+}
+
+/**
+ * Challenge 5 OCALL, not used by the benchmarks. Always plays rock.
+ **/
+unsigned int ocall_pedra_papel_tesoura(unsigned int round) {
+    (void) round;
+    return 0;
+}
+
+/**
+ * Empty OCALL, for the cost of nested transitions.
+ **/
+void ocall_bench_noop(void) {}
+
+/**
+ * Load the enclave from the optional `argv[1]` argument into `eid`.
+ */
+bool bench_load_enclave(
+    const int argc,
+    const char *restrict NONNULL argv[NONNULL argc],
+    sgx_enclave_id_t *NONNULL eid
+) {
+    const char *NONNULL enclave = "enclave.signed.so";
+    if unlikely (argc == 2) {
+        enclave = argv[1];
+    } else if unlikely (argc > 2) {
+        (void) fprintf(stderr, "Error: too many arguments\n");
+        (void) fprintf(stderr, "%s: [SIGNED_ENCLAVE.SO]\n", argv[0]);
+        return false;
+    }
+
+    const sgx_status_t status = load_enclave(enclave, eid);
+    if unlikely (status != SGX_SUCCESS) {
+        print_error_message(status);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Destroy the enclave loaded with `bench_load_enclave`, printing any errors.
+ */
+void bench_destroy_enclave(const sgx_enclave_id_t eid) {
+    const sgx_status_t status = sgx_destroy_enclave(eid);
+    if unlikely (status != SGX_SUCCESS) {
+        print_error_message(status);
+    }
+}
+
+/**
+ * Monotonic clock, in nanoseconds.
+ */
+uint64_t bench_now_ns(void) {
+    struct timespec now = {0};
+    (void) clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * UINT64_C(1'000'000'000) + (uint64_t) now.tv_nsec;
+}
@@ -0,0 +1,30 @@
+#ifndef BENCH_COMMON_H
+/** Shared setup for the enclave benchmarks. */
+#define BENCH_COMMON_H
+
+#include <sgx_eid.h>
+#include <stdint.h>
+
+#include "defines.h"
+
+[[nodiscard("error must be checked"), gnu::nonnull(2, 3), gnu::cold, gnu::nothrow]]
+/**
+ * Load the enclave from the optional `argv[1]` argument into `eid`.
+ *
+ * @returns `true` on success, or `false` after printing the error or usage message.
+ */
+bool bench_load_enclave(int argc, const char *restrict NONNULL argv[NONNULL argc], sgx_enclave_id_t *NONNULL eid);
+
+[[gnu::cold, gnu::nothrow]]
+/**
+ * Destroy the enclave loaded with `bench_load_enclave`, printing any errors.
+ */
+void bench_destroy_enclave(sgx_enclave_id_t eid);
+
+[[nodiscard("useless call otherwise"), gnu::hot, gnu::nothrow, gnu::leaf]]
+/**
+ * Monotonic clock, in nanoseconds.
+ */
+uint64_t bench_now_ns(void);
+
+#endif  // BENCH_COMMON_H
@@ -0,0 +1,421 @@
+#include <limits.h>
+#include <sgx_error.h>
+#include <sgx_tcrypto.h>
+#include <stdint.h>
+
+#include "./enclave.h"
+#include "./log.h"
+#include "./stats.h"
+#include "defines.h"
+#include "drbg.h"
+#include "enclave_t.h"
+
+/** Stream selectors used for benchmarking, disjoint from all challenge streams. */
+static constexpr uint64_t BENCH_STREAM = UINT64_C(1) << 63;
+
+[[nodiscard("error must be checked"), gnu::leaf, gnu::nothrow]]
+/**
+ * Benchmark: generate `blocks` DRBG blocks on each of `streams` fresh generators.
+ */
+int ecall_bench_drbg(const uint8_t backend, const uint64_t streams, const uint64_t blocks) {
+    LOG_FLUSH_ON_RETURN;
+
+    if unlikely (backend >= DRBG_BACKENDS) {
+        return -1;
+    }
+
+    for (uint64_t stream = 0; stream < streams; stream++) {
+        drbg_ctr128_t rng = drbg_seeded_init_backend(BENCH_STREAM | stream, (drbg_backend_id_t) backend);
+
+        for (uint64_t i = 0; i < blocks; i++) {
+            uint128_t value = UINT128_MAX;
+            const bool ok = drbg_rand_threshold(&rng, &value, UINT128_MAX);
+            if unlikely (!ok) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(1), gnu::always_inline, gnu::hot, gnu::nothrow]]
+/**
+ * Draw `samples` numbers in `[0,bound)`. Always inlined, so that `bound` is a constant like in the challenges.
+ */
+static inline int bench_bounded(drbg_ctr128_t *NONNULL rng, const uint64_t samples, const uint128_t bound) {
+    for (uint64_t i = 0; i < samples; i++) {
+        uint128_t value = UINT128_MAX;
+        const bool ok = drbg_rand_bounded(rng, &value, bound);
+        if unlikely (!ok) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+[[nodiscard("error must be checked"), gnu::leaf, gnu::nothrow]]
+/**
+ * Benchmark: generate `samples` numbers in `[0,bound)` from a single generator.
+ */
+int ecall_bench_drbg_bounded(const uint8_t backend, const uint64_t bound, const uint64_t samples) {
+    LOG_FLUSH_ON_RETURN;
+
+    if unlikely (backend >= DRBG_BACKENDS) {
+        return -1;
+    }
+
+    drbg_ctr128_t rng = drbg_seeded_init_backend(BENCH_STREAM, (drbg_backend_id_t) backend);
+    switch (bound) {
+        // challenge 5
+        case 3:
+            return bench_bounded(&rng, samples, 3);
+        // challenge 3
+        case 26:
+            return bench_bounded(&rng, samples, 26);
+        // challenge 2
+        case 100'000:
+            return bench_bounded(&rng, samples, 100'000);
+        // challenge 4
+        case 200'000'001:
+            return bench_bounded(&rng, samples, 200'000'001);
+        default:
+            return -1;
+    }
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(1), gnu::always_inline, gnu::hot, gnu::nothrow]]
+/**
+ * Draw `samples` digits in `[0,base)`. Always inlined, so that `base` is a constant like in the challenges.
+ */
+static inline int bench_digits(drbg_ctr128_t *NONNULL rng, const uint64_t samples, const uint8_t base) {
+    drbg_digits_t digits = drbg_digits_init(base);
+
+    for (uint64_t i = 0; i < samples; i++) {
+        uint8_t value = UINT8_MAX;
+        const bool ok = drbg_rand_digit(rng, &digits, &value);
+        if unlikely (!ok) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+[[nodiscard("error must be checked"), gnu::leaf, gnu::nothrow]]
+/**
+ * Benchmark: generate `samples` digits in `[0,base)` from a single generator.
+ */
+int ecall_bench_drbg_digits(const uint8_t backend, const uint8_t base, const uint64_t samples) {
+    LOG_FLUSH_ON_RETURN;
+
+    if unlikely (backend >= DRBG_BACKENDS) {
+        return -1;
+    }
+
+    drbg_ctr128_t rng = drbg_seeded_init_backend(BENCH_STREAM, (drbg_backend_id_t) backend);
+    switch (base) {
+        // challenge 5
+        case 3:
+            return bench_digits(&rng, samples, 3);
+        // challenge 3
+        case 26:
+            return bench_digits(&rng, samples, 26);
+        default:
+            return -1;
+    }
+}
+
+/** Stream selector bit for the second half of each checked stream, switched to with `drbg_set_stream`. */
+static constexpr uint64_t CHECK_RESTREAM = UINT64_C(1) << 62;
+
+/**
+ * Generators compared by `ecall_bench_drbg_check`, all on the same key.
+ */
+typedef struct drbg_check {
+    /** Key of the reference sequence. */
+    uint128_t key;
+    /** Big-endian counter of the reference sequence, incremented in place by `sgx_aes_ctr_encrypt`. */
+    uint8_t ctr[sizeof(uint128_t)];
+    /** One generator for each `drbg_backend_id_t`. */
+    drbg_ctr128_t rng[DRBG_BACKENDS];
+    /** Stream selector of the generators, without `CHECK_RESTREAM`. */
+    uint64_t stream;
+} drbg_check_t;
+
+[[nodiscard("useless call"), gnu::nothrow]]
+/**
+ * Fresh generators on `stream`, with the reference counter at zero.
+ */
+static drbg_check_t check_init(const uint64_t stream) {
+    drbg_check_t check = {.key = 0, .ctr = {0}, .stream = BENCH_STREAM | stream};
+    for (size_t backend = 0; backend < DRBG_BACKENDS; backend++) {
+        check.rng[backend] = drbg_seeded_init_backend(check.stream, (drbg_backend_id_t) backend);
+    }
+    check.key = check.rng[DRBG_BACKEND_TCRYPTO].key;
+    return check;
+}
+
+[[gnu::nonnull(1), gnu::nothrow]]
+/**
+ * Switch all generators to the second half of the stream, which rekeys the backends and keeps the counter.
+ */
+static void check_restream(drbg_check_t *NONNULL check) {
+    for (size_t backend = 0; backend < DRBG_BACKENDS; backend++) {
+        drbg_set_stream(&(check->rng[backend]), check->stream | CHECK_RESTREAM);
+    }
+    check->key = check->rng[DRBG_BACKEND_TCRYPTO].key;
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(1, 2), gnu::nothrow]]
+/**
+ * Next block of the reference sequence, generated like the DRBG did before the block pool and the backends: a single
+ * block per `sgx_aes_ctr_encrypt` call.
+ *
+ * @return `true` on success, or `false` if AES CTR failed.
+ */
+static bool check_reference(drbg_check_t *NONNULL check, uint128_t *NONNULL output) {
+    const uint128_t PLAINTEXT = 0;
+
+    const sgx_status_t status = sgx_aes_ctr_encrypt(
+        (const sgx_aes_ctr_128bit_key_t *) &(check->key),
+        (const uint8_t *) &PLAINTEXT,
+        sizeof(PLAINTEXT),
+        check->ctr,
+        sizeof(check->ctr) * CHAR_BIT,
+        (uint8_t *) output
+    );
+
+    if unlikely (status != SGX_SUCCESS) {
+        LOG(DRBG_RAND_FAILED, status);
+        return false;
+    }
+    return true;
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(1), gnu::nothrow]]
+/**
+ * Compare `samples` blocks of each backend with the reference sequence.
+ *
+ * @return 0 if all blocks match, 1 on the first mismatch, or -1 if the DRBG failed.
+ */
+static int check_blocks(drbg_check_t *NONNULL check, const uint64_t samples) {
+    for (uint64_t i = 0; i < samples; i++) {
+        if unlikely (i == samples / 2) {
+            check_restream(check);
+        }
+
+        uint128_t expected = UINT128_MAX;
+        const bool ok = check_reference(check, &expected);
+        if unlikely (!ok) {
+            return -1;
+        }
+
+        for (size_t backend = 0; backend < DRBG_BACKENDS; backend++) {
+            uint128_t value = UINT128_MAX;
+            const bool generated = drbg_rand(&(check->rng[backend]), &value);
+            if unlikely (!generated) {
+                return -1;
+            }
+            if unlikely (value != expected) {
+                LOG(DRBG_MISMATCH, "block", UINT64_C(0), check->stream, i);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(1), gnu::always_inline, gnu::nothrow]]
+/**
+ * Compare `samples` numbers in `[0,bound)` of each backend. With `DRBG_SAMPLING_COMPAT`, they are also compared with
+ * the original sampling on the reference sequence. Always inlined, so that `bound` is a constant like in the
+ * challenges.
+ *
+ * @return 0 if all samples match, 1 on the first mismatch, or -1 if the DRBG failed.
+ */
+static inline int check_bounded(drbg_check_t *NONNULL check, const uint64_t samples, const uint128_t bound) {
+    for (uint64_t i = 0; i < samples; i++) {
+        if unlikely (i == samples / 2) {
+            check_restream(check);
+        }
+
+        uint128_t values[DRBG_BACKENDS] = {0};
+        for (size_t backend = 0; backend < DRBG_BACKENDS; backend++) {
+            const bool ok = drbg_rand_bounded(&(check->rng[backend]), &(values[backend]), bound);
+            if unlikely (!ok) {
+                return -1;
+            }
+        }
+
+#if DRBG_SAMPLING == DRBG_SAMPLING_COMPAT
+        // modulo of the first block below the largest multiple of `bound`
+        const uint128_t threshold = UINT128_MAX - UINT128_MAX % bound;
+        uint128_t expected = UINT128_MAX;
+        do {
+            const bool ok = check_reference(check, &expected);
+            if unlikely (!ok) {
+                return -1;
+            }
+        } while (expected >= threshold);
+        expected %= bound;
+#else
+        // Lemire sampling has no original sequence, so only the backends are compared
+        const uint128_t expected = values[DRBG_BACKEND_TCRYPTO];
+#endif
+
+        for (size_t backend = 0; backend < DRBG_BACKENDS; backend++) {
+            if unlikely (values[backend] != expected) {
+                LOG(DRBG_MISMATCH, "sample", (uint64_t) bound, check->stream, i);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(1), gnu::always_inline, gnu::nothrow]]
+/**
+ * Compare `samples` digits in `[0,base)` of each backend. Always inlined, so that `base` is a constant like in the
+ * challenges.
+ *
+ * @return 0 if all digits match, 1 on the first mismatch, or -1 if the DRBG failed.
+ */
+static inline int check_digits(drbg_check_t *NONNULL check, const uint64_t samples, const uint8_t base) {
+    drbg_digits_t digits[DRBG_BACKENDS];
+    for (size_t backend = 0; backend < DRBG_BACKENDS; backend++) {
+        digits[backend] = drbg_digits_init(base);
+    }
+
+    for (uint64_t i = 0; i < samples; i++) {
+        if unlikely (i == samples / 2) {
+            check_restream(check);
+            // buffered digits come from the old key
+            for (size_t backend = 0; backend < DRBG_BACKENDS; backend++) {
+                digits[backend] = drbg_digits_init(base);
+            }
+        }
+
+        uint8_t values[DRBG_BACKENDS] = {0};
+        for (size_t backend = 0; backend < DRBG_BACKENDS; backend++) {
+            const bool ok = drbg_rand_digit(&(check->rng[backend]), &(digits[backend]), &(values[backend]));
+            if unlikely (!ok) {
+                return -1;
+            }
+        }
+
+        for (size_t backend = 0; backend < DRBG_BACKENDS; backend++) {
+            if unlikely (values[backend] != values[DRBG_BACKEND_TCRYPTO]) {
+                LOG(DRBG_MISMATCH, "digit", (uint64_t) base, check->stream, i);
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+[[nodiscard("error must be checked"), gnu::nothrow]]
+/**
+ * Run all checks on fresh generators for `stream`, with the same bounds and bases used by the challenges.
+ *
+ * @return 0 if all sequences match, 1 on the first mismatch, or -1 if the DRBG failed.
+ */
+static int check_stream(const uint64_t stream, const uint64_t samples) {
+    drbg_check_t check = check_init(stream);
+    int rv = check_blocks(&check, samples);
+
+    if likely (rv == 0) {
+        check = check_init(stream);
+        rv = check_bounded(&check, samples, 3);
+    }
+    if likely (rv == 0) {
+        check = check_init(stream);
+        rv = check_bounded(&check, samples, 26);
+    }
+    if likely (rv == 0) {
+        check = check_init(stream);
+        rv = check_bounded(&check, samples, 100'000);
+    }
+    if likely (rv == 0) {
+        check = check_init(stream);
+        rv = check_bounded(&check, samples, 200'000'001);
+    }
+    if likely (rv == 0) {
+        check = check_init(stream);
+        rv = check_digits(&check, samples, 3);
+    }
+    if likely (rv == 0) {
+        check = check_init(stream);
+        rv = check_digits(&check, samples, 26);
+    }
+    return rv;
+}
+
+[[nodiscard("error must be checked"), gnu::leaf, gnu::nothrow]]
+/**
+ * Check that both backends generate the same blocks, bounded samples and digits, and that blocks and compat samples
+ * match the single block sequence of the original DRBG, for any `DRBG_POOL_BLOCKS`.
+ */
+int ecall_bench_drbg_check(const uint64_t streams, const uint64_t samples) {
+    LOG_FLUSH_ON_RETURN;
+
+    for (uint64_t stream = 0; stream < streams; stream++) {
+        const int rv = check_stream(stream, samples);
+        if unlikely (rv != 0) {
+            return rv;
+        }
+    }
+    return 0;
+}
+
+[[nodiscard("error must be checked"), gnu::leaf, gnu::nothrow]]
+/**
+ * Benchmark: initialize `generators` DRBGs from the enclave seed, which is what every challenge ECALL does first.
+ */
+int ecall_bench_seed(const uint64_t generators) {
+    LOG_FLUSH_ON_RETURN;
+
+    for (uint64_t stream = 0; stream < generators; stream++) {
+        const drbg_ctr128_t rng = drbg_seeded_init(BENCH_STREAM | stream);
+        // keep the call, without generating anything
+        __asm__ volatile("" : : "r"(&rng) : "memory");
+    }
+    return 0;
+}
+
+[[gnu::nothrow]]
+/**
+ * Benchmark: empty ECALL, for the raw transition cost. No-op ECALLs never log, so there's nothing to flush.
+ */
+void ecall_bench_empty(void) {}
+
+[[gnu::nothrow]]
+/**
+ * Benchmark: ECALL with `len` bytes copied into the enclave by the bridge.
+ */
+void ecall_bench_in(const uint8_t buf[NULLABLE], const size_t len) {
+    (void) buf;
+    (void) len;
+}
+
+[[gnu::nothrow]]
+/**
+ * Benchmark: ECALL with `len` bytes copied into the enclave and back by the bridge.
+ */
+void ecall_bench_in_out(uint8_t buf[NULLABLE], const size_t len) {
+    (void) buf;
+    (void) len;
+}
+
+[[nodiscard("error must be checked"), gnu::nothrow]]
+/**
+ * Benchmark: make `calls` no-op OCALLs from inside a single ECALL.
+ */
+int ecall_bench_ocall(const uint32_t calls) {
+    for (uint32_t i = 0; i < calls; i++) {
+        STATS_INC(ocalls);
+        const sgx_status_t status = ocall_bench_noop();
+        if unlikely (status != SGX_SUCCESS) {
+            return -1;
+        }
+    }
+    return 0;
+}
@@ -6,6 +6,7 @@
 #include <string.h>
 
 #include "../enclave.h"
+#include "../log.h"
 #include "defines.h"
 #include "enclave_config.h"
 #include "enclave_t.h"
@@ -55,7 +56,7 @@ static const char *NULLABLE skip_whitespace(string_t str, const string_t stop) {
         str++;
         if unlikely (str == stop) {
 #ifdef DEBUG
-            printf("[DEBUG] skip_whitespace: stop reached\n");
+            LOG(WHITESPACE_STOP);
 #endif
             return NULL;
         }
@@ -75,7 +76,7 @@ static const char *NULLABLE consume_name(string_t str, const string_t stop) {
     const string_t start = str;
     if unlikely (!is_uppercase_letter(*str)) {
 #ifdef DEBUG
-        printf("[DEBUG] consume_name: does not start with uppercase letter, str=%s\n", str);
+        LOG(NAME_NOT_UPPERCASE, str);
 #endif
         return NULL;
     }
@@ -86,7 +87,7 @@ static const char *NULLABLE consume_name(string_t str, const string_t stop) {
         str++;
         if unlikely (str == stop) {
 #ifdef DEBUG
-            printf("[DEBUG] consume_name: stop reached\n");
+            LOG(NAME_STOP);
 #endif
             return NULL;
         }
@@ -95,7 +96,7 @@ static const char *NULLABLE consume_name(string_t str, const string_t stop) {
     // at least one lowercase letter is required
     if unlikely (str == start + 1) {
 #ifdef DEBUG
-        printf("[DEBUG] consume_name: single letter name, start=%s\n", start);
+        LOG(NAME_SINGLE_LETTER, start);
 #endif
         return NULL;
     }
@@ -119,7 +120,7 @@ static bool name_matches_position(
 
     if unlikely (i >= n) {
 #ifdef DEBUG
-        printf("[DEBUG] name_matches_position: nothing to match at i=%zu: str=%s\n", i, str);
+        LOG(POSITION_NOTHING, i, str);
 #endif
         return false;
     }
@@ -127,14 +128,14 @@ static bool name_matches_position(
     const size_t len = strlen(expected[i]);
     if unlikely (strncmp(str, expected[i], strlen(expected[i])) != 0) {
 #ifdef DEBUG
-        printf("[DEBUG] name_matches_position: does not match i=%zu: expected=%s, str=%s\n", i, expected[i], str);
+        LOG(POSITION_MISMATCH, i, expected[i], str);
 #endif
         return false;
     }
 
     if unlikely (str[len] != '\0' && !is_whitespace(str[len])) {
 #ifdef DEBUG
-        printf("[DEBUG] name_matches_position: length does not match i=%zu: longer than %zu\n", i, len);
+        LOG(POSITION_LENGTH, i, len);
 #endif
         return false;
     }
@@ -150,7 +151,7 @@ static bool match_name(const char *NULLABLE str, const size_t n, const unique_st
     assume(n > 1);
     if unlikely (str == NULL) {
 #ifdef DEBUG
-        printf("[DEBUG] match_name: string is null\n");
+        LOG(MATCH_NULL);
 #endif
         return false;
     }
@@ -158,7 +159,7 @@ static bool match_name(const char *NULLABLE str, const size_t n, const unique_st
     const size_t strn = strnlen(str, MAX_STRING_LENGTH);
     if unlikely (strn >= MAX_STRING_LENGTH || str[strn] != '\0') {
 #ifdef DEBUG
-        printf("[DEBUG] match_name: string is too long\n");
+        LOG(MATCH_TOO_LONG);
 #endif
         return false;
     }
@@ -211,14 +212,14 @@ static bool match_name(const char *NULLABLE str, const size_t n, const unique_st
 
     if unlikely (*str != '\0') {
 #ifdef DEBUG
-        printf("[DEBUG] match_name: unmatched content: str=%s\n", str);
+        LOG(MATCH_UNMATCHED, str);
 #endif
         return false;
     }
 
     if unlikely (expected != NULL && i != n) {
 #ifdef DEBUG
-        printf("[DEBUG] match_name: does not match expected name: i=%zu, n=%zu\n", i, n);
+        LOG(MATCH_MISMATCH, i, n);
 #endif
     }
 
@@ -230,6 +231,8 @@ static bool match_name(const char *NULLABLE str, const size_t n, const unique_st
  * Example code.
  */
 int ecall_name_check(const char *NULLABLE name) {
+    LOG_FLUSH_ON_RETURN;
+
     const bool ok = match_name(name, SIZE_MAX, NULL);
     return likely(ok) ? 0 : -1;
 }
@@ -242,6 +245,8 @@ int ecall_name_check(const char *NULLABLE name) {
  * Just call this function passing your full name.
  */
 int ecall_verificar_aluno(const char *NULLABLE nome) {
+    LOG_FLUSH_ON_RETURN;
+
     static const unique_string_t EXPECTED_NAME[] = STUDENT_NAME;
     const size_t len = sizeof(EXPECTED_NAME) / sizeof(EXPECTED_NAME[0]);
 
@@ -250,8 +255,7 @@ int ecall_verificar_aluno(const char *NULLABLE nome) {
         return -1;
     }
 
-    printf("\n%s\n", SEPARATOR);
-    printf("[ENCLAVE] DESAFIO 1 CONCLUIDO!! parabéns %s!!\n", nome);
-    printf("%s\n", SEPARATOR);
+    // a single OCALL, so banners of concurrent challenges don't interleave
+    printf("\n%s\n[ENCLAVE] DESAFIO 1 CONCLUIDO!! parabéns %s!!\n%s\n", SEPARATOR, nome, SEPARATOR);
     return 0;
 }
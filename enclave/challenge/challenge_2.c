@@ -1,7 +1,9 @@
 #include <limits.h>
+#include <stddef.h>
 #include <stdio.h>
 
 #include "../enclave.h"
+#include "../log.h"
 #include "defines.h"
 #include "enclave_t.h"
 
@@ -23,7 +25,7 @@ static constexpr unsigned MAX_PASSWORD = 99'999;
 static constexpr unsigned UNINITIALIZED_PASSWORD = UINT_MAX;
 static_assert(!IS_VALID(UNINITIALIZED_PASSWORD));
 
-[[nodiscard("pure function"), gnu::const, gnu::hot, gnu::nothrow]]
+[[nodiscard("useless call"), gnu::hot, gnu::nothrow]]
 /**
  * Generate password from fixed seed. Returns `UNINITIALIZED_PASSWORD` on errors.
  */
@@ -40,6 +42,39 @@ static unsigned generate_password(void) {
     return MIN_PASSWORD + (unsigned) value;
 }
 
+[[nodiscard("error must be checked"), gnu::nonnull(1), gnu::cold, gnu::nothrow]]
+/**
+ * Initialize the cached password (an `unsigned`).
+ */
+static bool load_password(void *NONNULL output) {
+    unsigned *NONNULL password = (unsigned *) output;
+    *password = generate_password();
+    return IS_VALID(*password);
+}
+
+[[nodiscard("useless call"), gnu::hot, gnu::nothrow]]
+/**
+ * The password, generated on the first call. Returns `UNINITIALIZED_PASSWORD` on errors.
+ */
+static unsigned secret_password(void) {
+    static lazy_t lazy = LAZY_INITIALIZER;
+    static unsigned password = UNINITIALIZED_PASSWORD;
+
+    const bool ok = lazy_get(&lazy, load_password, &password);
+    if unlikely (!ok) {
+        return UNINITIALIZED_PASSWORD;
+    }
+    return password;
+}
+
+[[gnu::cold, gnu::nothrow]]
+/**
+ * Show the success banner for challenge 2.
+ */
+static void print_success(const unsigned password) {
+    printf("\n%s\n[ENCLAVE] DESAFIO 2 CONCLUIDO!! a senha é %u\n%s\n", SEPARATOR, password, SEPARATOR);
+}
+
 [[nodiscard("error must be checked"), gnu::leaf, gnu::nothrow]]
 /**
  * Challenge 2: Crack the Password
@@ -50,17 +85,19 @@ static unsigned generate_password(void) {
  * HINT: the password is an integer between 0 and 99999.
  */
 int ecall_verificar_senha(unsigned int senha) {
-    const unsigned expected_password = generate_password();
+    LOG_FLUSH_ON_RETURN;
+
+    const unsigned expected_password = secret_password();
     if unlikely (!IS_VALID(expected_password)) {
 #ifdef DEBUG
-        printf("[ENCLAVE] ecall_verificar_senha: failed to generate password\n");
+        LOG(PASSWORD_FAILED, "ecall_verificar_senha");
 #endif
         return -2;
     }
 
     if unlikely (!IS_VALID(senha)) {
 #ifdef DEBUG
-        printf("[DEBUG] ecall_verificar_senha: invalid password=%u\n", senha);
+        LOG(PASSWORD_INVALID, senha);
 #endif
         return -1;
     }
@@ -69,8 +106,43 @@ int ecall_verificar_senha(unsigned int senha) {
         return -1;
     }
 
-    printf("\n%s\n", SEPARATOR);
-    printf("[ENCLAVE] DESAFIO 2 CONCLUIDO!! a senha é %u\n", expected_password);
-    printf("%s\n", SEPARATOR);
+    print_success(expected_password);
     return 0;
 }
+
+[[nodiscard("error must be checked"), gnu::leaf, gnu::nothrow]]
+/**
+ * Challenge 2: Crack the Password, batched
+ * ----------------------------------------
+ *
+ * Same as `ecall_verificar_senha`, but checks `n` passwords in a single call. Invalid passwords never match.
+ *
+ * Returns the index of the right password, -1 if none matched, or -2 on errors.
+ */
+int ecall_verificar_senhas(const unsigned int senhas[NULLABLE], const size_t n) {
+    LOG_FLUSH_ON_RETURN;
+
+    const unsigned expected_password = secret_password();
+    if unlikely (!IS_VALID(expected_password)) {
+#ifdef DEBUG
+        LOG(PASSWORD_FAILED, "ecall_verificar_senhas");
+#endif
+        return -2;
+    }
+
+    if unlikely (senhas == NULL || n > INT_MAX) {
+#ifdef DEBUG
+        LOG(PASSWORDS_INVALID, n);
+#endif
+        return -2;
+    }
+
+    // `expected_password` is always valid, so invalid passwords can't match
+    for (size_t i = 0; i < n; i++) {
+        if unlikely (senhas[i] == expected_password) {
+            print_success(expected_password);
+            return (int) i;
+        }
+    }
+    return -1;
+}
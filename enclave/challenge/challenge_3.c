@@ -1,14 +1,16 @@
 #include <assert.h>
 #include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
-#include <string.h>
 
 #include "../enclave.h"
+#include "../log.h"
 #include "defines.h"
 #include "enclave_t.h"
 
 /** Number of characters for the secret word. */
 static constexpr size_t WORD_LEN = 20;
+static_assert(WORD_LEN <= 32);
 
 /**
  * The secret word, not NUL-terminated.
@@ -33,16 +35,27 @@ static constexpr word_t EMPTY_WORD = {
  */
 #define IS_EMPTY(word) unlikely((word).data[0] == '\0')
 
-[[nodiscard("useless call otherwise"), gnu::nonnull(1)]]
+/** Possible letters in the secret word. */
+static constexpr char LETTERS[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+/** Number of possible letters. */
+static constexpr size_t N_LETTERS = sizeof(LETTERS) - 1;
+static_assert(N_LETTERS <= UINT8_MAX);
+
+[[nodiscard("useless call otherwise"), gnu::nonnull(1, 2)]]
 /**
  * Generate a single letter from the specified list. Returns `\0` on errors.
+ *
+ * With `DRBG_DIGITS`, letters are taken from `digits`, and the whole word usually fits in a single block.
  */
-static char generate_letter(drbg_ctr128_t *NONNULL rng) {
-    constexpr char LETTERS[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
-    const size_t N_LETTERS = strlen(LETTERS);
-
+static char generate_letter(drbg_ctr128_t *NONNULL rng, drbg_digits_t *NONNULL digits) {
+#if DRBG_DIGITS
+    uint8_t index = UINT8_MAX;
+    const bool ok = drbg_rand_digit(rng, digits, &index);
+#else
+    (void) digits;
     uint128_t index = 0;
     const bool ok = drbg_rand_bounded(rng, &index, N_LETTERS);
+#endif
     if unlikely (!ok) {
         return '\0';
     }
@@ -51,16 +64,17 @@ static char generate_letter(drbg_ctr128_t *NONNULL rng) {
     return LETTERS[index % N_LETTERS];
 }
 
-[[nodiscard("pure function"), gnu::const, gnu::hot]]
+[[nodiscard("useless call"), gnu::hot]]
 /**
  * Generate secret word from fixed seed. Returns `EMPTY_WORD` on errors.
  */
 static word_t generate_secret_word(void) {
     drbg_ctr128_t rng = drbg_seeded_init(3);
+    drbg_digits_t digits = drbg_digits_init((uint8_t) N_LETTERS);
 
     word_t secret = EMPTY_WORD;
     for (size_t i = 0; i < WORD_LEN; i++) {
-        const char ch = generate_letter(&rng);
+        const char ch = generate_letter(&rng, &digits);
         if unlikely (ch == '\0') {
             return EMPTY_WORD;
         }
@@ -69,6 +83,46 @@ static word_t generate_secret_word(void) {
     return secret;
 }
 
+[[nodiscard("error must be checked"), gnu::nonnull(1), gnu::cold, gnu::nothrow]]
+/**
+ * Initialize the cached secret word (a `word_t`).
+ */
+static bool load_secret_word(void *NONNULL output) {
+    word_t *NONNULL secret = (word_t *) output;
+    *secret = generate_secret_word();
+    return !IS_EMPTY(*secret);
+}
+
+[[nodiscard("useless call"), gnu::hot]]
+/**
+ * The secret word, generated on the first call. Returns `EMPTY_WORD` on errors.
+ */
+static word_t secret_word(void) {
+    static lazy_t lazy = LAZY_INITIALIZER;
+    static word_t secret = EMPTY_WORD;
+
+    const bool ok = lazy_get(&lazy, load_secret_word, &secret);
+    if unlikely (!ok) {
+        return EMPTY_WORD;
+    }
+    return secret;
+}
+
+[[gnu::cold, gnu::nothrow]]
+/**
+ * Show the success banner for challenge 3.
+ */
+static void print_success(const word_t secret) {
+    static_assert(WORD_LEN <= INT_MAX);
+    printf(
+        "\n%s\n[ENCLAVE] DESAFIO 3 CONCLUIDO!! a palavra secreta é %.*s\n%s\n",
+        SEPARATOR,
+        (int) WORD_LEN,
+        secret.data,
+        SEPARATOR
+    );
+}
+
 [[nodiscard("error must be checked"), gnu::leaf, gnu::nothrow]]
 /**
  * Challenge 3: Find the Secret Word
@@ -80,17 +134,19 @@ static word_t generate_secret_word(void) {
  * HINT: the secret word contains only uppercase letters, no spaces, diacritics or digits.
  */
 int ecall_palavra_secreta(char palavra[NULLABLE WORD_LEN]) {
-    const word_t secret = generate_secret_word();
+    LOG_FLUSH_ON_RETURN;
+
+    const word_t secret = secret_word();
     if unlikely (IS_EMPTY(secret)) {
 #ifdef DEBUG
-        printf("[ENCLAVE] ecall_palavra_secreta: failed to generate secret word\n");
+        LOG(WORD_FAILED, "ecall_palavra_secreta");
 #endif
         return -2;
     }
 
     if unlikely (palavra == NULL) {
 #ifdef DEBUG
-        printf("[DEBUG] ecall_palavra_secreta: input is null\n");
+        LOG(WORD_NULL);
 #endif
         return -1;
     }
@@ -107,9 +163,63 @@ int ecall_palavra_secreta(char palavra[NULLABLE WORD_LEN]) {
         return -1;
     }
 
-    static_assert(WORD_LEN <= INT_MAX);
-    printf("\n%s\n", SEPARATOR);
-    printf("[ENCLAVE] DESAFIO 3 CONCLUIDO!! a palavra secreta é %.*s\n", (int) WORD_LEN, secret.data);
-    printf("%s\n", SEPARATOR);
+    print_success(secret);
     return 0;
 }
+
+/** Match mask with all positions right. */
+static constexpr uint32_t FULL_MASK = (UINT32_C(1) << WORD_LEN) - 1;
+
+[[nodiscard("error must be checked"), gnu::leaf, gnu::nothrow]]
+/**
+ * Challenge 3: Find the Secret Word, batched
+ * ------------------------------------------
+ *
+ * Check `k` words in a single call. Instead of replacing wrong letters, bit `i` of `mascaras[j]` is set if letter `i`
+ * of `palavras[j]` is right. Words are not modified.
+ *
+ * Returns the index of the first word that matches the secret, -1 if none matched, or -2 on errors.
+ */
+int ecall_palavras_secretas(
+    const palavra_t palavras[NULLABLE],
+    uint32_t mascaras[NULLABLE],
+    const size_t k
+) {
+    LOG_FLUSH_ON_RETURN;
+
+    const word_t secret = secret_word();
+    if unlikely (IS_EMPTY(secret)) {
+#ifdef DEBUG
+        LOG(WORD_FAILED, "ecall_palavras_secretas");
+#endif
+        return -2;
+    }
+
+    if unlikely (palavras == NULL || mascaras == NULL || k > INT_MAX) {
+#ifdef DEBUG
+        LOG(WORDS_INVALID, k);
+#endif
+        return -2;
+    }
+
+    static_assert(sizeof(palavras[0].letras) == WORD_LEN);
+    int found = -1;
+    for (size_t j = 0; j < k; j++) {
+        uint32_t mask = 0;
+        for (size_t i = 0; i < WORD_LEN; i++) {
+            mask |= (uint32_t) (palavras[j].letras[i] == secret.data[i]) << i;
+        }
+        mascaras[j] = mask;
+
+        if unlikely (mask == FULL_MASK && found < 0) {
+            found = (int) j;
+        }
+    }
+
+    if likely (found < 0) {
+        return -1;
+    }
+
+    print_success(secret);
+    return found;
+}
@@ -6,6 +6,7 @@
 #include <stdlib.h>
 
 #include "../enclave.h"
+#include "../log.h"
 #include "defines.h"
 #include "enclave_t.h"
 
@@ -33,6 +34,28 @@ static inline int64_t i64(int x) {
     return (int64_t) x;
 }
 
+[[nodiscard("pure function"), gnu::const, gnu::always_inline, gnu::hot]]
+/**
+ * Same as `value % P`, with C semantics (the result has the sign of `value`), but without divisions. Valid for
+ * `|value| < 2^62`.
+ *
+ * Since `P = 2^31 - 1`, we have `2^31 ≡ 1 (mod P)`, so adding the high bits to the low 31 bits keeps the residue.
+ * Everything is branchless, so loops using it can be vectorized.
+ */
+static inline int64_t modP(const int64_t value) {
+    static_assert(P == (INT64_C(1) << 31) - 1);
+
+    // all ones for negative values
+    const uint64_t sign = (uint64_t) (value >> 63);
+    uint64_t magnitude = ((uint64_t) value ^ sign) - sign;
+    // less than 2^32, then at most P + 1
+    magnitude = (magnitude & (uint64_t) P) + (magnitude >> 31);
+    magnitude = (magnitude & (uint64_t) P) + (magnitude >> 31);
+    magnitude -= (magnitude >= (uint64_t) P) ? (uint64_t) P : 0;
+
+    return (int64_t) ((magnitude ^ sign) - sign);
+}
+
 /** Check if a value is in the define `MIN_VALUE` to `MAX_VALUE` range (both inclusive). */
 #define IN_RANGE(value) likely(MIN_VALUE <= (value) && (value) <= MAX_VALUE)
 static_assert(INT_MIN < MIN_VALUE);
@@ -48,6 +71,22 @@ typedef struct coefficients {
     int64_t c;
 } coefficients_t;
 
+[[nodiscard("pure function"), gnu::const, gnu::always_inline, gnu::hot]]
+/**
+ * Evaluate `((x*x*a) + (x*b) + c) % P` as `((a*x % P + b) % P * x % P + c) % P`, with C semantics for `%`.
+ *
+ * Each coefficient and each partial result fits in 32 bits, so the products are `32x32->64` multiplications. The
+ * values are bounded by `|a*x| < 2^58` and `|(a*x % P + b) % P * x| < 2^62`, as required by `modP`.
+ */
+static inline int evaluate(const int a, const int b, const int c, const int x) {
+    static_assert(-MIN_VALUE <= (1 << 27) && MAX_VALUE <= (1 << 27));
+
+    const int ax = (int) modP(i64(a) * i64(x));
+    const int axb = (int) modP(i64(ax) + i64(b));
+    const int axbx = (int) modP(i64(axb) * i64(x));
+    return (int) modP(i64(axbx) + i64(c));
+}
+
 /**
  * Check if a given coefficient set is in the expected range.
  */
@@ -63,7 +102,7 @@ static constexpr coefficients_t UNINITIALIZED_COEFFICIENTS = {
 };
 static_assert(!IS_VALID(UNINITIALIZED_COEFFICIENTS));
 
-[[nodiscard("pure function"), gnu::const, gnu::hot]]
+[[nodiscard("useless call"), gnu::hot]]
 /**
  * Generate pseudo-random polynomial coefficients from fixed seed. Returns `UNINITIALIZED_COEFFICIENTS` on errors.
  */
@@ -105,6 +144,31 @@ static coefficients_t generate_coefficients(void) {
     }
 }
 
+[[nodiscard("error must be checked"), gnu::nonnull(1), gnu::cold, gnu::nothrow]]
+/**
+ * Initialize the cached coefficients (a `coefficients_t`).
+ */
+static bool load_coefficients(void *NONNULL output) {
+    coefficients_t *NONNULL poly = (coefficients_t *) output;
+    *poly = generate_coefficients();
+    return IS_VALID(*poly);
+}
+
+[[nodiscard("useless call"), gnu::hot]]
+/**
+ * The polynomial coefficients, generated on the first call. Returns `UNINITIALIZED_COEFFICIENTS` on errors.
+ */
+static coefficients_t secret_coefficients(void) {
+    static lazy_t lazy = LAZY_INITIALIZER;
+    static coefficients_t poly = UNINITIALIZED_COEFFICIENTS;
+
+    const bool ok = lazy_get(&lazy, load_coefficients, &poly);
+    if unlikely (!ok) {
+        return UNINITIALIZED_COEFFICIENTS;
+    }
+    return poly;
+}
+
 /**
  * Challenge 4: Secret Polynomial
  * ------------------------------
@@ -118,23 +182,92 @@ static coefficients_t generate_coefficients(void) {
  * HINT: the prime 2147483647 is irrelevant except when you supply *       a very large x.
  */
 int ecall_polinomio_secreto(const int x) {
-    const coefficients_t poly = generate_coefficients();
+    LOG_FLUSH_ON_RETURN;
+
+    const coefficients_t poly = secret_coefficients();
     if unlikely (!IS_VALID(poly)) {
 #ifdef DEBUG
-        printf("[DEBUG] ecall_polinomio_secreto: failed to generate coefficients\n");
+        LOG(POLYNOMIAL_FAILED, "ecall_polinomio_secreto");
+        (void) log_flush();
 #endif
         abort();
     }
 
     if unlikely (x == 0) {
 #ifdef DEBUG
-        printf("[DEBUG] ecall_polinomio_secreto: invalid x=%d\n", x);
+        LOG(POLYNOMIAL_INVALID_X, "ecall_polinomio_secreto", x);
+        (void) log_flush();
 #endif
         abort();
     }
 
     static_assert(P <= INT_MAX);
-    return (int) ((((((poly.a * i64(x)) % P + poly.b) % P) * i64(x)) % P + poly.c) % P);
+    return evaluate((int) poly.a, (int) poly.b, (int) poly.c, x);
+}
+
+[[nodiscard("error must be checked"), gnu::leaf, gnu::nothrow]]
+/**
+ * Challenge 4: Secret Polynomial, batched
+ * ---------------------------------------
+ *
+ * Evaluate the polynomial at `n` points in a single call, with `ys[i] = ecall_polinomio_secreto(xs[i])`. Returns 0
+ * on success, or -1 on errors.
+ *
+ * NOTE: this ECALL aborts if any `xs[i]` is zero, like `ecall_polinomio_secreto`.
+ */
+int ecall_polinomio_secreto_lote(const int xs[NULLABLE], int ys[NULLABLE], const size_t n) {
+    LOG_FLUSH_ON_RETURN;
+
+    const coefficients_t poly = secret_coefficients();
+    if unlikely (!IS_VALID(poly)) {
+#ifdef DEBUG
+        LOG(POLYNOMIAL_FAILED, "ecall_polinomio_secreto_lote");
+        (void) log_flush();
+#endif
+        abort();
+    }
+
+    if unlikely ((xs == NULL || ys == NULL) && n > 0) {
+#ifdef DEBUG
+        LOG(POLYNOMIAL_INVALID_INPUT, "ecall_polinomio_secreto_lote", n);
+#endif
+        return -1;
+    }
+
+    // validate everything first, so the main loop has no branches
+    bool has_zero = false;
+    for (size_t i = 0; i < n; i++) {
+        has_zero |= (xs[i] == 0);
+    }
+    if unlikely (has_zero) {
+#ifdef DEBUG
+        LOG(POLYNOMIAL_INVALID_X, "ecall_polinomio_secreto_lote", 0);
+        (void) log_flush();
+#endif
+        abort();
+    }
+
+    const int a = (int) poly.a;
+    const int b = (int) poly.b;
+    const int c = (int) poly.c;
+    for (size_t i = 0; i < n; i++) {
+        ys[i] = evaluate(a, b, c, xs[i]);
+    }
+    return 0;
+}
+
+/**
+ * Show the success banner for challenge 4.
+ */
+static void print_success(const coefficients_t poly) {
+    printf(
+        "\n%s\n[ENCLAVE] DESAFIO 4 CONCLUIDO!! os polinomios são: A=%" PRIi64 ", B=%" PRIi64 ", C=%" PRIi64 "\n%s\n",
+        SEPARATOR,
+        poly.a,
+        poly.b,
+        poly.c,
+        SEPARATOR
+    );
 }
 
 [[nodiscard("error must be checked"), gnu::leaf, gnu::nothrow]]
@@ -148,10 +281,13 @@ int ecall_polinomio_secreto(const int x) {
  * HINT: the function is deliberately hard to brute-force.
  */
 int ecall_verificar_polinomio(int a, int b, int c) {
-    const coefficients_t poly = generate_coefficients();
+    LOG_FLUSH_ON_RETURN;
+
+    const coefficients_t poly = secret_coefficients();
     if unlikely (!IS_VALID(poly)) {
 #ifdef DEBUG
-        printf("[DEBUG] ecall_polinomio_secreto: failed to generate coefficients\n");
+        LOG(POLYNOMIAL_FAILED, "ecall_polinomio_secreto");
+        (void) log_flush();
 #endif
         abort();
     }
@@ -160,13 +296,49 @@ int ecall_verificar_polinomio(int a, int b, int c) {
         return (int) false;
     }
 
-    printf("\n%s\n", SEPARATOR);
-    printf(
-        "[ENCLAVE] DESAFIO 4 CONCLUIDO!! os polinomios são: A=%" PRIi64 ", B=%" PRIi64 ", C=%" PRIi64 "\n",
-        poly.a,
-        poly.b,
-        poly.c
-    );
-    printf("%s\n", SEPARATOR);
+    print_success(poly);
     return (int) true;
 }
+
+[[nodiscard("error must be checked"), gnu::leaf, gnu::nothrow]]
+/**
+ * Challenge 4: Secret Polynomial, batched
+ * ---------------------------------------
+ *
+ * Verify `n` sets of coefficients in a single call. Returns the index of the first set that matches, -1 if none
+ * matched, or -2 on errors.
+ */
+int ecall_verificar_polinomios(const coeficientes_t candidatos[NULLABLE], const size_t n) {
+    LOG_FLUSH_ON_RETURN;
+
+    const coefficients_t poly = secret_coefficients();
+    if unlikely (!IS_VALID(poly)) {
+#ifdef DEBUG
+        LOG(POLYNOMIAL_FAILED, "ecall_verificar_polinomios");
+#endif
+        return -2;
+    }
+
+    if unlikely (candidatos == NULL || n > INT_MAX) {
+#ifdef DEBUG
+        LOG(POLYNOMIAL_INVALID_INPUT, "ecall_verificar_polinomios", n);
+#endif
+        return -2;
+    }
+
+    const int a = (int) poly.a;
+    const int b = (int) poly.b;
+    const int c = (int) poly.c;
+    // branchless min-index reduction, instead of an early exit
+    size_t found = n;
+    for (size_t i = 0; i < n; i++) {
+        const bool match = (candidatos[i].a == a) & (candidatos[i].b == b) & (candidatos[i].c == c);
+        found = (match && i < found) ? i : found;
+    }
+    if likely (found >= n) {
+        return -1;
+    }
+
+    print_success(poly);
+    return (int) found;
+}
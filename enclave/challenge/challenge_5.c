@@ -5,12 +5,31 @@
 #include <stdio.h>
 
 #include "../enclave.h"
+#include "../log.h"
+#include "../stats.h"
 #include "defines.h"
 #include "enclave_t.h"
 
 /** Pre-defined number of rounds in each Rock, Paper, Scissors game. */
 static constexpr size_t ROUNDS = 20;
 
+#if DRBG_DIGITS
+/** Rounds played with each stream selector, when plays are taken from a digit stream. */
+static constexpr size_t SUBTREE_DEPTH = 4;
+/** Plays for every possible sequence of app answers in `SUBTREE_DEPTH` rounds: `1 + 3 + 9 + 27`. */
+static constexpr size_t SUBTREE_NODES = 40;
+#else
+/** Rounds played with each stream selector. */
+static constexpr size_t SUBTREE_DEPTH = 1;
+/** Plays generated with each stream selector. */
+static constexpr size_t SUBTREE_NODES = 1;
+#endif
+static_assert(ROUNDS % SUBTREE_DEPTH == 0);
+
+/** First stream selector, for round 1. */
+static constexpr uint64_t INITIAL_STREAM = 5;
+
+#if !DRBG_DIGITS
 [[nodiscard("generated value"), gnu::nonnull(1), gnu::hot, gnu::nothrow]]
 /**
  * Generate a pseudo-random play: `0` (rock), `1` (paper), or `2` (scissors). Returns `UINT8_MAX` on errors.
@@ -25,6 +44,185 @@ static uint8_t random_play(drbg_ctr128_t *NONNULL rng) {
     assume(value < 3);
     return (uint8_t) (value % 3);
 }
+#endif
+
+[[nodiscard("error must be checked"), gnu::nonnull(1, 2), gnu::hot, gnu::nothrow]]
+/**
+ * Generate the enclave plays for the next `SUBTREE_DEPTH` rounds, for all possible app answers, as a ternary tree in
+ * an array: the children of node `n` are `3n + 1 + app_play`. With `DRBG_DIGITS`, a single block covers the whole
+ * subtree. Otherwise, it's a single play.
+ *
+ * @return `true` on success, or `false` if AES CTR failed.
+ */
+static bool random_subtree(drbg_ctr128_t *NONNULL rng, uint8_t plays[NONNULL SUBTREE_NODES]) {
+#if DRBG_DIGITS
+    drbg_digits_t digits = drbg_digits_init(3);
+
+    for (size_t i = 0; i < SUBTREE_NODES; i++) {
+        const bool ok = drbg_rand_digit(rng, &digits, &plays[i]);
+        if unlikely (!ok) {
+            return false;
+        }
+    }
+    return true;
+#else
+    plays[0] = random_play(rng);
+    return plays[0] != UINT8_MAX;
+#endif
+}
+
+#if RPS_CACHE_DEPTH > 0
+static_assert(RPS_CACHE_DEPTH <= ROUNDS);
+
+/**
+ * Enclave plays already computed, for all streams of the first `RPS_CACHE_DEPTH` rounds. The stream for round `i`
+ * (from 0) is in `[5 * 3^i, 6 * 3^i)`, so the flat index is `(3^i - 1) / 2 + (stream - 5 * 3^i)`.
+ *
+ * Each entry uses 2 bits: zero for unknown, or `play + 1`. Entries are written only once, and always with the same
+ * value, since the seed is fixed for the enclave lifetime.
+ */
+static uint64_t rps_cache[(RPS_CACHE_ENTRIES + 31) / 32] = {};
+
+/** Cache lookups that found the play. */
+static uint64_t rps_cache_hits = 0;
+/** Cache lookups that needed to generate the play. */
+static uint64_t rps_cache_misses = 0;
+
+[[nodiscard("pure function"), gnu::const, gnu::hot]]
+/**
+ * Flat index in `rps_cache` for the `stream` used on `round`.
+ */
+static size_t rps_cache_index(const size_t round, const uint64_t stream) {
+    assume(round < RPS_CACHE_DEPTH);
+
+    uint64_t power = 1;
+    for (size_t i = 0; i < round; i++) {
+        power *= 3;
+    }
+
+    assume(INITIAL_STREAM * power <= stream && stream < (INITIAL_STREAM + 1) * power);
+    return (size_t) ((power - 1) / 2 + (stream - INITIAL_STREAM * power));
+}
+
+[[nodiscard("cache lookup"), gnu::hot, gnu::nothrow]]
+/**
+ * Cached play for `stream` on `round`, or `UINT8_MAX` if not cached.
+ */
+static uint8_t rps_cache_get(const size_t round, const uint64_t stream) {
+    if (round >= RPS_CACHE_DEPTH) {
+        return UINT8_MAX;
+    }
+
+    const size_t index = rps_cache_index(round, stream);
+    const uint64_t word = __atomic_load_n(&rps_cache[index / 32], __ATOMIC_RELAXED);
+    const uint8_t entry = (uint8_t) ((word >> (2 * (index % 32))) & 0b11);
+    return likely(entry != 0) ? (uint8_t) (entry - 1) : UINT8_MAX;
+}
+
+[[gnu::nonnull(3), gnu::hot, gnu::nothrow]]
+/**
+ * Save all plays from a subtree generated for `stream` on `round`.
+ */
+static void rps_cache_put(const size_t round, const uint64_t stream, const uint8_t plays[NONNULL SUBTREE_NODES]) {
+    // nodes on each depth are ordered by app answers, and so are their streams
+    size_t first_node = 0;
+    uint64_t width = 1;
+    for (size_t depth = 0; depth < SUBTREE_DEPTH && round + depth < RPS_CACHE_DEPTH; depth++) {
+        const size_t first_index = rps_cache_index(round + depth, stream * width);
+
+        for (size_t offset = 0; offset < width; offset++) {
+            const size_t index = first_index + offset;
+            const uint8_t play = plays[first_node + offset];
+            assume(play < 3);
+
+            const uint64_t entry = (uint64_t) (play + 1) << (2 * (index % 32));
+            (void) __atomic_fetch_or(&rps_cache[index / 32], entry, __ATOMIC_RELAXED);
+        }
+
+        first_node += width;
+        width *= 3;
+    }
+}
+
+[[gnu::hot, gnu::nothrow]]
+/**
+ * Add the lookups from a single game with `rounds` played to the global counters. Every round up to
+ * `RPS_CACHE_DEPTH` is either a hit or a miss.
+ */
+static void rps_cache_count(const size_t rounds, const uint64_t hits) {
+    const uint64_t lookups = likely(rounds < RPS_CACHE_DEPTH) ? rounds : RPS_CACHE_DEPTH;
+    assume(hits <= lookups);
+
+    (void) __atomic_fetch_add(&rps_cache_hits, hits, __ATOMIC_RELAXED);
+    (void) __atomic_fetch_add(&rps_cache_misses, lookups - hits, __ATOMIC_RELAXED);
+}
+#else
+/** Cache disabled: never found. */
+#    define rps_cache_get(round, stream) ((void) (round), (void) (stream), UINT8_MAX)
+/** Cache disabled: nothing to save. */
+#    define rps_cache_put(round, stream, plays) ((void) (round), (void) (stream), (void) (plays))
+/** Cache disabled: nothing to count. */
+#    define rps_cache_count(rounds, hits) ((void) (rounds), (void) (hits))
+#endif
+
+/**
+ * Plays for the current subtree of rounds, generated only when some play is not cached.
+ */
+typedef struct subtree {
+    /** Generator for the current subtree, valid only if `generated`. */
+    drbg_ctr128_t rng;
+    /** DRBG block counter at the start of the current subtree. */
+    uint128_t ctr;
+    /** Stream selector for the current subtree. */
+    uint64_t stream;
+    /** First round (from 0) of the current subtree. */
+    size_t round;
+    /** If `plays` were generated for the current subtree. */
+    bool generated;
+    /** Generated plays, see `random_subtree`. */
+    uint8_t plays[SUBTREE_NODES];
+} subtree_t;
+
+[[gnu::nonnull(1), gnu::hot, gnu::nothrow]]
+/**
+ * Move to the subtree starting at `round` with `stream`. The DRBG counter continues from the previous subtree, which
+ * used a single block if it wasn't generated (all of its plays came from the cache).
+ */
+static void subtree_next(subtree_t *NONNULL tree, const size_t round, const uint64_t stream) {
+    tree->ctr = tree->generated ? tree->rng.ctr : tree->ctr + 1;
+    tree->stream = stream;
+    tree->round = round;
+    tree->generated = false;
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(1), gnu::hot, gnu::nothrow]]
+/**
+ * Generate the plays for the current subtree, saving them in the cache.
+ *
+ * Only subtrees on the nominal path are cached: when every previous subtree (and this one) used a single block. A
+ * cached play then implies the counter position on later rounds, so cache hits never change the generated sequence.
+ *
+ * @return `true` on success, or `false` if AES CTR failed.
+ */
+static bool subtree_generate(subtree_t *NONNULL tree) {
+    // the generator starts on the right key for the first subtree
+    if (tree->round > 0) {
+        tree->rng.ctr = tree->ctr;
+        drbg_set_stream(&(tree->rng), tree->stream);
+    }
+
+    const bool ok = random_subtree(&(tree->rng), tree->plays);
+    if unlikely (!ok) {
+        return false;
+    }
+    tree->generated = true;
+
+    const bool nominal = tree->ctr == tree->round / SUBTREE_DEPTH && tree->rng.ctr == tree->ctr + 1;
+    if likely (nominal) {
+        rps_cache_put(tree->round, tree->stream, tree->plays);
+    }
+    return true;
+}
 
 [[nodiscard("do not throw away user calls"), gnu::hot, gnu::nothrow]]
 /**
@@ -34,15 +232,16 @@ static uint8_t ocall_play(uint8_t round) {
     assume(0 < round && round <= ROUNDS);
 
     unsigned play = UINT_MAX;
+    STATS_INC(ocalls);
     const sgx_status_t status = ocall_pedra_papel_tesoura(&play, round);
     if unlikely (status != SGX_SUCCESS) {
-        printf("[ENCLAVE] ocall_pedra_papel_tesoura failed: status=0x%04x\n", status);
+        LOG(RPS_OCALL_FAILED, status);
         return UINT8_MAX;
     }
 
     if unlikely (play >= 3) {
 #ifdef DEBUG
-        printf("[DEBUG] ocall_pedra_papel_tesoura: invalid answer=%u\n", play);
+        LOG(RPS_INVALID_ANSWER, play);
 #endif
         return UINT8_MAX;
     }
@@ -105,6 +304,117 @@ static char display_result(const round_result_t result) {
     }
 }
 
+/**
+ * Plays and results of a single game, for the success banner.
+ */
+typedef struct game_record {
+    /** Enclave plays, as `display_play`. */
+    char enclave_sequence[ROUNDS + 1];
+    /** App plays, as `display_play`. */
+    char app_sequence[ROUNDS + 1];
+    /** Results for the app, as `display_result`. */
+    char results[ROUNDS + 1];
+} game_record_t;
+
+[[nodiscard("error must be checked"), gnu::nonnull(2), gnu::hot, gnu::nothrow]]
+/**
+ * Play all `ROUNDS` of a single game. App plays are taken from `app_plays` or, if null, from
+ * `ocall_pedra_papel_tesoura`.
+ *
+ * Returns the number of app wins, -1 for invalid app plays, or -2 if AES CTR failed.
+ */
+static int play_game(const uint8_t app_plays[NULLABLE ROUNDS], game_record_t *NONNULL record) {
+    uint64_t stream = INITIAL_STREAM;
+
+    subtree_t tree = {
+        .rng = drbg_seeded_init(stream),
+        .ctr = 0,
+        .stream = stream,
+        .round = 0,
+        .generated = false,
+        .plays = {},
+    };
+    size_t node = 0;
+    uint8_t user_wins = 0;
+
+    uint64_t hits = 0;
+
+    static_assert(ROUNDS < UINT8_MAX);
+    for (uint8_t i = 0; i < ROUNDS; i++) {
+        if (i > 0 && i % SUBTREE_DEPTH == 0) {
+            subtree_next(&tree, i, stream);
+            node = 0;
+        }
+
+        uint8_t enclave_play = rps_cache_get(i, stream);
+        if likely (enclave_play != UINT8_MAX) {
+            hits += 1;
+        } else {
+            if (!tree.generated) {
+                const bool ok = subtree_generate(&tree);
+                if unlikely (!ok) {
+                    return -2;
+                }
+            }
+            assume(node < SUBTREE_NODES);
+            enclave_play = tree.plays[node];
+        }
+
+        uint8_t app_play = UINT8_MAX;
+        if (app_plays == NULL) {
+            app_play = ocall_play(i + 1);
+        } else if likely (app_plays[i] < 3) {
+            app_play = app_plays[i];
+        }
+        if unlikely (app_play == UINT8_MAX) {
+            rps_cache_count(i + 1, hits);
+            return -1;
+        }
+        const round_result_t res = result(enclave_play, app_play);
+        if (res == WIN) {
+            user_wins += 1;
+        }
+
+        record->enclave_sequence[i] = display_play(enclave_play);
+        record->app_sequence[i] = display_play(app_play);
+        record->results[i] = display_result(res);
+
+        // always less than 6 * 3**20 < 2**35, can't overflow
+        stream = stream * 3 + app_play;
+        node = 3 * node + 1 + app_play;
+    }
+    rps_cache_count(ROUNDS, hits);
+
+    record->enclave_sequence[ROUNDS] = '\0';
+    record->app_sequence[ROUNDS] = '\0';
+    record->results[ROUNDS] = '\0';
+
+    assume(user_wins <= ROUNDS);
+    return (int) user_wins;
+}
+
+[[gnu::nonnull(1)]]
+/**
+ * Show the success banner for challenge 5.
+ */
+static void print_success(const game_record_t *NONNULL record) {
+    printf(
+        // clang-format off
+        "\n%s\n"
+        "[ENCLAVE] DESAFIO 5 CONCLUIDO!! V (vitória), D (derrota) E (empate)\n"
+        "          ENCLAVE JOGADAS: %s\n"
+        "             SUAS JOGADAS: %s\n"
+        "                RESULTADO: %s\n"
+        "%s\n",
+        // clang-format on
+        SEPARATOR,
+        record->enclave_sequence,
+        record->app_sequence,
+        record->results,
+        SEPARATOR
+    );
+}
+
 [[nodiscard("error must be checked"), gnu::leaf, gnu::nothrow]]
 /**
  * Challenge 5: Rock, Paper, Scissors
@@ -128,59 +438,83 @@ static char display_result(const round_result_t result) {
  *  plays the same moves.
  **/
 int ecall_pedra_papel_tesoura(void) {
-    uint64_t stream = 5;
+    LOG_FLUSH_ON_RETURN;
 
-    drbg_ctr128_t rng = drbg_seeded_init(stream);
-    uint8_t user_wins = 0;
+    game_record_t record = {};
+    const int user_wins = play_game(NULL, &record);
 
-    char enclave_sequence[ROUNDS + 1] = "";
-    char app_sequence[ROUNDS + 1] = "";
-    char results[ROUNDS + 1] = "";
+    if unlikely (user_wins >= (int) ROUNDS) {
+        print_success(&record);
+    }
+    return user_wins;
+}
 
-    static_assert(ROUNDS < UINT8_MAX);
-    for (uint8_t i = 0; i < ROUNDS; i++) {
-        uint8_t enclave_play = random_play(&rng);
-        if unlikely (enclave_play == UINT8_MAX) {
+[[nodiscard("error must be checked"), gnu::leaf, gnu::nothrow]]
+/**
+ * Challenge 5: Rock, Paper, Scissors, batched
+ * -------------------------------------------
+ *
+ * Play `n` games in a single call, with all app plays given upfront instead of `ocall_pedra_papel_tesoura`. The
+ * enclave plays exactly as in `ecall_pedra_papel_tesoura`, and the number of app wins in each game is written to
+ * `vitorias`.
+ *
+ * Returns the index of the first game with all rounds won, -1 if none won, or -2 on errors (including plays other
+ * than 0, 1 or 2).
+ */
+int ecall_pedra_papel_tesoura_lote(const jogo_t jogos[NULLABLE], uint8_t vitorias[NULLABLE], const size_t n) {
+    LOG_FLUSH_ON_RETURN;
+
+    if unlikely (jogos == NULL || vitorias == NULL || n > INT_MAX) {
+#ifdef DEBUG
+        LOG(RPS_INVALID_INPUT, n);
+#endif
+        return -2;
+    }
+
+    static_assert(sizeof(jogos[0].jogadas) == ROUNDS);
+    int winner = -1;
+    for (size_t i = 0; i < n; i++) {
+        game_record_t record = {};
+        const int user_wins = play_game(jogos[i].jogadas, &record);
+        if unlikely (user_wins < 0) {
+#ifdef DEBUG
+            LOG(RPS_GAME_FAILED, i, user_wins);
+#endif
             return -2;
         }
 
-        const uint8_t app_play = ocall_play(i + 1);
-        if unlikely (app_play == UINT8_MAX) {
-            return -1;
+        assume(user_wins <= (int) ROUNDS);
+        vitorias[i] = (uint8_t) user_wins;
+        if unlikely (user_wins == (int) ROUNDS && winner < 0) {
+            print_success(&record);
+            winner = (int) i;
         }
-        const round_result_t res = result(enclave_play, app_play);
-        if (res == WIN) {
-            user_wins += 1;
-        }
-
-        enclave_sequence[i] = display_play(enclave_play);
-        app_sequence[i] = display_play(app_play);
-        results[i] = display_result(res);
-
-        // always less than 6 * 3**20 < 2**35, can't overflow
-        stream = stream * 3 + app_play;
-        rng = drbg_set_stream(rng, stream);
     }
+    return winner;
+}
 
-    enclave_sequence[ROUNDS] = '\0';
-    app_sequence[ROUNDS] = '\0';
-    results[ROUNDS] = '\0';
+[[nodiscard("error must be checked"), gnu::leaf, gnu::nothrow]]
+/**
+ * Hit and miss counters of the RPS play cache, since the enclave was loaded.
+ *
+ * Returns 0 on success, or -1 if `stats` is null.
+ */
+int ecall_rps_cache_stats(rps_cache_stats_t *NULLABLE stats) {
+    LOG_FLUSH_ON_RETURN;
 
-    assume(user_wins <= ROUNDS);
-    if unlikely (user_wins >= ROUNDS) {
-        printf("\n%s\n", SEPARATOR);
-        printf(
-            // clang-format off
-            "[ENCLAVE] DESAFIO 5 CONCLUIDO!! V (vitória), D (derrota) E (empate)\n"
-            "          ENCLAVE JOGADAS: %s\n"
-            "             SUAS JOGADAS: %s\n"
-            "                RESULTADO: %s\n",
-            // clang-format on
-            enclave_sequence,
-            app_sequence,
-            results
-        );
-        printf("%s\n", SEPARATOR);
+    if unlikely (stats == NULL) {
+        return -1;
     }
-    return (int) user_wins;
+
+#if RPS_CACHE_DEPTH > 0
+    *stats = (rps_cache_stats_t) {
+        .hits = __atomic_load_n(&rps_cache_hits, __ATOMIC_RELAXED),
+        .misses = __atomic_load_n(&rps_cache_misses, __ATOMIC_RELAXED),
+        .entries = RPS_CACHE_ENTRIES,
+        .depth = RPS_CACHE_DEPTH,
+    };
+#else
+    *stats = (rps_cache_stats_t) {.hits = 0, .misses = 0, .entries = 0, .depth = 0};
+#endif
+    return 0;
 }
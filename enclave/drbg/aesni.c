@@ -0,0 +1,111 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "../enclave.h"
+#include "./backend.h"
+#include "defines.h"
+
+/**
+ * 128-bit vector for AES-NI builtins. Used instead of `<wmmintrin.h>`, which is not available with `-nostdinc`.
+ */
+typedef long long aes_block_t [[gnu::vector_size(16)]];
+/** Same as `aes_block_t`, but split in 32-bit words. */
+typedef uint32_t aes_words_t [[gnu::vector_size(16)]];
+
+static_assert(sizeof(aes_block_t) == sizeof(uint128_t));
+static_assert(DRBG_SCHEDULE_BLOCKS == 11, "AES-128 has 10 rounds");
+
+/** Number of blocks encrypted together, to hide the `aesenc` latency. */
+static constexpr size_t LANES = 4;
+
+/**
+ * Derive round key `i` from round key `i - 1` (FIPS-197, section 5.2). Must be a macro, `rcon` is an immediate.
+ */
+#define EXPAND_ROUND_KEY(schedule, i, rcon)                                                           \
+    do {                                                                                              \
+        const aes_block_t previous = (schedule)[(i) - 1];                                             \
+        const aes_words_t assist = (aes_words_t) __builtin_ia32_aeskeygenassist128(previous, (rcon)); \
+        aes_words_t words = (aes_words_t) previous;                                                   \
+        words[0] ^= assist[3];                                                                        \
+        words[1] ^= words[0];                                                                         \
+        words[2] ^= words[1];                                                                         \
+        words[3] ^= words[2];                                                                         \
+        (schedule)[i] = (aes_block_t) words;                                                          \
+    } while (0)
+
+[[gnu::nonnull(1), gnu::nothrow, gnu::target("aes")]]
+/**
+ * Expand the AES-128 key schedule, once per key.
+ */
+static void aesni_rekey(drbg_ctr128_t *NONNULL drbg) {
+    aes_block_t schedule[DRBG_SCHEDULE_BLOCKS];
+    memcpy(&schedule[0], &(drbg->key), sizeof(aes_block_t));
+
+    EXPAND_ROUND_KEY(schedule, 1, 0x01);
+    EXPAND_ROUND_KEY(schedule, 2, 0x02);
+    EXPAND_ROUND_KEY(schedule, 3, 0x04);
+    EXPAND_ROUND_KEY(schedule, 4, 0x08);
+    EXPAND_ROUND_KEY(schedule, 5, 0x10);
+    EXPAND_ROUND_KEY(schedule, 6, 0x20);
+    EXPAND_ROUND_KEY(schedule, 7, 0x40);
+    EXPAND_ROUND_KEY(schedule, 8, 0x80);
+    EXPAND_ROUND_KEY(schedule, 9, 0x1B);
+    EXPAND_ROUND_KEY(schedule, 10, 0x36);
+
+    static_assert(sizeof(schedule) == sizeof(drbg->schedule));
+    memcpy(drbg->schedule, schedule, sizeof(schedule));
+}
+
+[[nodiscard("pure function"), gnu::const, gnu::hot, gnu::target("aes")]]
+/**
+ * Load the big-endian counter block for block `ctr`, already whitened with the first round key.
+ */
+static inline aes_block_t load_counter(const uint128_t ctr, const aes_block_t first_key) {
+    const counter_block_t block = counter_block(ctr);
+
+    aes_block_t value;
+    memcpy(&value, block.data, sizeof(value));
+    return value ^ first_key;
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(1, 2), gnu::hot, gnu::nothrow, gnu::target("aes")]]
+/**
+ * Generate `blocks` keystream blocks, `LANES` at a time.
+ */
+static bool aesni_generate(const drbg_ctr128_t *NONNULL drbg, uint128_t output[NONNULL], const size_t blocks) {
+    aes_block_t schedule[DRBG_SCHEDULE_BLOCKS];
+    memcpy(schedule, drbg->schedule, sizeof(schedule));
+
+    size_t i = 0;
+    for (; i + LANES <= blocks; i += LANES) {
+        aes_block_t state[LANES];
+        for (size_t lane = 0; lane < LANES; lane++) {
+            state[lane] = load_counter(drbg->ctr + i + lane, schedule[0]);
+        }
+        for (size_t round = 1; round < DRBG_SCHEDULE_BLOCKS - 1; round++) {
+            for (size_t lane = 0; lane < LANES; lane++) {
+                state[lane] = __builtin_ia32_aesenc128(state[lane], schedule[round]);
+            }
+        }
+        for (size_t lane = 0; lane < LANES; lane++) {
+            state[lane] = __builtin_ia32_aesenclast128(state[lane], schedule[DRBG_SCHEDULE_BLOCKS - 1]);
+        }
+        memcpy(&output[i], state, sizeof(state));
+    }
+
+    for (; i < blocks; i++) {
+        aes_block_t state = load_counter(drbg->ctr + i, schedule[0]);
+        for (size_t round = 1; round < DRBG_SCHEDULE_BLOCKS - 1; round++) {
+            state = __builtin_ia32_aesenc128(state, schedule[round]);
+        }
+        state = __builtin_ia32_aesenclast128(state, schedule[DRBG_SCHEDULE_BLOCKS - 1]);
+        memcpy(&output[i], &state, sizeof(state));
+    }
+    return true;
+}
+
+const drbg_backend_t DRBG_AESNI = {
+    .rekey = aesni_rekey,
+    .generate = aesni_generate,
+};
@@ -0,0 +1,49 @@
+#ifndef ENCLAVE_DRBG_BACKEND_H
+/** Interface for the DRBG block generators. */
+#define ENCLAVE_DRBG_BACKEND_H
+
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../enclave.h"
+#include "defines.h"
+
+/**
+ * Operations implemented by each `drbg_backend_id_t`.
+ */
+typedef struct drbg_backend {
+    /** Update any key dependent state in `drbg` after `drbg->key` changes. */
+    void (*NONNULL rekey)(drbg_ctr128_t *NONNULL drbg);
+    /**
+     * Write `blocks` keystream blocks to `output`, starting at block `drbg->ctr`.
+     *
+     * @return `true` on success, or `false` if AES CTR failed.
+     */
+    bool (*NONNULL generate)(const drbg_ctr128_t *NONNULL drbg, uint128_t output[NONNULL], size_t blocks);
+} drbg_backend_t;
+
+/** SGX SDK `sgx_aes_ctr_encrypt` backend. */
+extern const drbg_backend_t DRBG_TCRYPTO;
+/** AES-NI backend. */
+extern const drbg_backend_t DRBG_AESNI;
+
+/** AES-CTR counter block, in big-endian order. */
+typedef struct counter_block {
+    uint8_t data[sizeof(uint128_t)];
+} counter_block_t;
+
+[[nodiscard("pure function"), gnu::const, gnu::hot]]
+/**
+ * Encode the block counter as big-endian, which is the increment order used by `sgx_aes_ctr_encrypt`.
+ */
+static inline counter_block_t counter_block(uint128_t ctr) {
+    counter_block_t block = {0};
+    for (size_t i = sizeof(block.data); i > 0; i--) {
+        block.data[i - 1] = (uint8_t) (ctr & UINT8_MAX);
+        ctr >>= CHAR_BIT;
+    }
+    return block;
+}
+
+#endif  // ENCLAVE_DRBG_BACKEND_H
@@ -0,0 +1,50 @@
+#include <limits.h>
+#include <sgx_error.h>
+#include <sgx_tcrypto.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "../enclave.h"
+#include "../log.h"
+#include "./backend.h"
+#include "defines.h"
+
+[[gnu::nonnull(1), gnu::nothrow]]
+/**
+ * Nothing to do, the SDK expands the key on every call.
+ */
+static void tcrypto_rekey(drbg_ctr128_t *NONNULL drbg) {
+    (void) drbg;
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(1, 2), gnu::nothrow]]
+/**
+ * Generate `blocks` keystream blocks with a single `sgx_aes_ctr_encrypt` call.
+ */
+static bool tcrypto_generate(const drbg_ctr128_t *NONNULL drbg, uint128_t output[NONNULL], const size_t blocks) {
+    // randomized plaintext is useless in CTR mode
+    static const uint128_t PLAINTEXT[DRBG_POOL_BLOCKS] = {0};
+    assume(0 < blocks && blocks <= DRBG_POOL_BLOCKS);
+
+    counter_block_t ctr = counter_block(drbg->ctr);
+    const sgx_status_t status = sgx_aes_ctr_encrypt(
+        (const sgx_aes_ctr_128bit_key_t *) &(drbg->key),
+        (const uint8_t *) PLAINTEXT,
+        (uint32_t) (blocks * sizeof(uint128_t)),
+        ctr.data,
+        sizeof(drbg->ctr) * CHAR_BIT,
+        (uint8_t *) output
+    );
+
+    if unlikely (status != SGX_SUCCESS) {
+        LOG(DRBG_RAND_FAILED, status);
+        return false;
+    }
+    return true;
+}
+
+const drbg_backend_t DRBG_TCRYPTO = {
+    .rekey = tcrypto_rekey,
+    .generate = tcrypto_generate,
+};
@@ -1,22 +1,27 @@
-#include <inttypes.h>  // IWYU pragma: keep
 #include <limits.h>
 #include <pthread.h>
 #include <sgx_error.h>
-#include <sgx_tcrypto.h>
 #include <sgx_trts.h>  // IWYU pragma: keep
 #include <stdarg.h>
 #include <stdint.h>
 #include <stdio.h>
 
+#include "./drbg/backend.h"
 #include "./enclave.h"
+#include "./log.h"
+#include "./stats.h"
 #include "defines.h"
 #include "enclave_config.h"
 #include "enclave_t.h"
 
 /**
  * `printf`-like function for the enclave. Buffer limited to `BUFSIZ` (8192) bytes.
+ *
+ * Pending log records of the thread are flushed first, so the output stays in order.
  */
 int printf(const char *NONNULL fmt, ...) {
+    (void) log_flush();
+
     char buf[BUFSIZ] = "";
 
     va_list ap;
@@ -28,6 +33,7 @@ int printf(const char *NONNULL fmt, ...) {
         return written;
     }
 
+    STATS_INC(ocalls);
     const sgx_status_t status = ocall_print_string(buf);
     if unlikely (status != SGX_SUCCESS) {
         return -1;
@@ -37,50 +43,65 @@ int printf(const char *NONNULL fmt, ...) {
     return likely(written < MAX_BYTES) ? written : MAX_BYTES;
 }
 
-[[nodiscard("error must be checked"), gnu::nonnull(1, 2, 3), gnu::cold, gnu::noinline, gnu::nothrow]]
 /**
- * Acquire write lock and initialize seed, if not initialized already.
+ * Acquire lock and run `init`, if `lazy` is not initialized already. The value is published by a release store on
+ * `lazy->ready`, so readers in `lazy_get` don't need the lock.
  */
-static bool drbg_seed_init(pthread_rwlock_t *NONNULL lock, bool *NONNULL initialized, uint64_t *NONNULL seed) {
-    // write step: check and initialize seed
-    int rv = pthread_rwlock_wrlock(lock);
+bool lazy_init(lazy_t *NONNULL lazy, lazy_init_fn *NONNULL init, void *NONNULL value) {
+    STATS_INC(lazy_locks);
+
+    // write step: check and initialize value
+    int rv = pthread_mutex_lock(&(lazy->lock));
     if unlikely (rv != 0) {
 #ifdef DEBUG
-        printf("[DEBUG] drbg_seed: failed to acquire wrlock: %d\n", rv);
+        LOG(LAZY_LOCK_FAILED, rv);
 #endif
         return false;
     }
 
-    sgx_status_t status = SGX_SUCCESS;
-    // write new seed value, ensure write once semantics
-    if likely (!*initialized) {
-#if ENCLAVE_SEED < 0
-        status = sgx_read_rand((uint8_t *) seed, sizeof(uint64_t));
-#else
-        *seed = ENCLAVE_SEED;
-#endif
-        *initialized = (status == SGX_SUCCESS);
+    bool ok = true;
+    // ensure write once semantics, another thread may have initialized it while we waited
+    if likely (!__atomic_load_n(&(lazy->ready), __ATOMIC_RELAXED)) {
+        ok = init(value);
+        if likely (ok) {
+            __atomic_store_n(&(lazy->ready), true, __ATOMIC_RELEASE);
+        }
     }
 
-    rv = pthread_rwlock_unlock(lock);
+    rv = pthread_mutex_unlock(&(lazy->lock));
     if unlikely (rv != 0) {
 #ifdef DEBUG
-        printf("[DEBUG] drbg_seed: failed to release wrlock: %d\n", rv);
+        LOG(LAZY_UNLOCK_FAILED, rv);
 #endif
         return false;
     }
+    return ok;
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(1), gnu::cold, gnu::nothrow]]
+/**
+ * Generate or load the predefined seed into `output` (an `uint64_t`).
+ */
+static bool drbg_seed_generate(void *NONNULL output) {
+    uint64_t *NONNULL seed = (uint64_t *) output;
+
+#if ENCLAVE_SEED < 0
+    const sgx_status_t status = sgx_read_rand((uint8_t *) seed, sizeof(uint64_t));
     if unlikely (status != SGX_SUCCESS) {
-#ifdef DEBUG
-        printf("[DEBUG] drbg_seed: failed read rand: %04x\n", (unsigned) status);
-#endif
+#    ifdef DEBUG
+        LOG(SEED_RAND_FAILED, (unsigned) status);
+#    endif
         return false;
     }
+#else
+    *seed = ENCLAVE_SEED;
+#endif
 
 #ifdef DEBUG
 #    if ENCLAVE_SEED < 0
-    printf("[DEBUG] drbg_seed: predefined %016" PRIx64 "\n", *seed);
+    LOG(SEED_GENERATED, *seed);
 #    else
-    printf("[DEBUG] drbg_seed: generated %016" PRIx64 "\n", *seed);
+    LOG(SEED_PREDEFINED, *seed);
 #    endif
 #endif
     return true;
@@ -88,38 +109,18 @@ static bool drbg_seed_init(pthread_rwlock_t *NONNULL lock, bool *NONNULL initial
 
 [[nodiscard("error must be checked"), gnu::nonnull(1), gnu::hot, gnu::nothrow]]
 /**
- * Acquire read lock and read seed, if initialized. Otherwise try to initialize it.
+ * Read seed, if initialized. Otherwise try to initialize it.
+ *
+ * The seed is written only once, so the steady state is a single acquire load, without touching the lock.
  */
 static bool drbg_seed(uint64_t *NONNULL output) {
-    static pthread_rwlock_t lock = PTHREAD_RWLOCK_INITIALIZER;
-    static bool initialized = false;
+    static lazy_t lazy = LAZY_INITIALIZER;
     static uint64_t seed = 0;
 
-    // read step: use seed if already initialized
-    int rv = pthread_rwlock_rdlock(&lock);
-    if unlikely (rv != 0) {
-#ifdef DEBUG
-        printf("[DEBUG] drbg_seed: failed to acquire rdlock: %d\n", rv);
-#endif
-        return false;
-    }
-
-    // safe to read, but not to write
-    bool ok = initialized;
-
-    rv = pthread_rwlock_unlock(&lock);
-    if unlikely (rv != 0) {
-#ifdef DEBUG
-        printf("[DEBUG] drbg_seed: failed to release rdlock: %d\n", rv);
-#endif
-        return false;
-    }
-
+    STATS_INC(seed_reads);
+    const bool ok = lazy_get(&lazy, drbg_seed_generate, &seed);
     if unlikely (!ok) {
-        ok = drbg_seed_init(&lock, &initialized, &seed);
-        if unlikely (!ok) {
-            return false;
-        }
+        return false;
     }
 
     // at this point, seed is already initialized, so
@@ -128,11 +129,31 @@ static bool drbg_seed(uint64_t *NONNULL output) {
     return true;
 }
 
+/**
+ * Implementation for each `drbg_backend_id_t`.
+ */
+static const drbg_backend_t *const BACKENDS[DRBG_BACKENDS] = {
+    [DRBG_BACKEND_TCRYPTO] = &DRBG_TCRYPTO,
+    [DRBG_BACKEND_AESNI] = &DRBG_AESNI,
+};
+
+/**
+ * Discard buffered blocks and update backend state after a change to `drbg->key`.
+ */
+void drbg_rekey(drbg_ctr128_t *NONNULL drbg) {
+    assume(drbg->backend < DRBG_BACKENDS);
+
+    drbg->len = 0;
+    drbg->pos = 0;
+    drbg->window = 1;
+    BACKENDS[drbg->backend]->rekey(drbg);
+}
+
 [[nodiscard("pure function"), gnu::const]]
 /**
  * Initialize the PRNG using an input `seed` and a `stream` selector.
  */
-static drbg_ctr128_t drbg_init(const uint64_t seed, const uint64_t stream) {
+static drbg_ctr128_t drbg_init(const uint64_t seed, const uint64_t stream, const drbg_backend_id_t backend) {
     drbg_ctr128_t drbg = {0};
 
     const uint64_t key[] = {seed, stream};
@@ -140,45 +161,71 @@ static drbg_ctr128_t drbg_init(const uint64_t seed, const uint64_t stream) {
 
     memcpy(&(drbg.key), &key, sizeof(drbg.key));
     memset(&(drbg.ctr), 0, sizeof(drbg.ctr));
+    drbg.backend = backend;
+    drbg_rekey(&drbg);
     return drbg;
 }
 
 /**
- * Initialize the PRNG using the seed file and a `stream` selector.
+ * Initialize the PRNG using the seed file, a `stream` selector and a specific `backend`.
  */
-drbg_ctr128_t drbg_seeded_init(const uint64_t stream) {
+drbg_ctr128_t drbg_seeded_init_backend(const uint64_t stream, const drbg_backend_id_t backend) {
     uint64_t seed = 0;
     const bool ok = drbg_seed(&seed);
-    if unlikely (!ok) {
+    if unlikely (!ok || backend >= DRBG_BACKENDS) {
+        // report why the seed failed before aborting
+        (void) log_flush();
         abort();
     }
 
-    return drbg_init(seed, stream);
+    return drbg_init(seed, stream, backend);
 }
 
-[[nodiscard("error must be checked"), gnu::nonnull(1, 2), gnu::hot, gnu::nothrow]]
 /**
- * Generate a pseudo-random number in `[0,UINT128_MAX)` from the DRBG sequence.
+ * Initialize the PRNG using the seed file and a `stream` selector.
+ */
+drbg_ctr128_t drbg_seeded_init(const uint64_t stream) {
+    return drbg_seeded_init_backend(stream, DRBG_BACKEND);
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(1), gnu::nothrow]]
+/**
+ * Generate the next `drbg->window` blocks of the keystream with a single backend call.
  *
  * @return `true` on success, or `false` if AES CTR failed.
  */
-static bool drbg_rand(drbg_ctr128_t *NONNULL drbg, uint128_t *NONNULL output) {
-    // randomized plaintext is useless in CTR mode
-    const uint128_t PLAINTEXT = 0;
-
-    const sgx_status_t status = sgx_aes_ctr_encrypt(
-        (const sgx_aes_ctr_128bit_key_t *) &(drbg->key),
-        (const uint8_t *) &PLAINTEXT,
-        sizeof(PLAINTEXT),
-        (uint8_t *) &(drbg->ctr),
-        sizeof(drbg->ctr) * CHAR_BIT,
-        (uint8_t *) output
-    );
+static bool drbg_refill(drbg_ctr128_t *NONNULL drbg) {
+    const uint8_t blocks = drbg->window;
+    assume(0 < blocks && blocks <= DRBG_POOL_BLOCKS);
+    assume(drbg->backend < DRBG_BACKENDS);
 
-    if unlikely (status != SGX_SUCCESS) {
-        printf("[ENCLAVE] drbg_rand failed: status=0x%04x\n", status);
+    const bool ok = BACKENDS[drbg->backend]->generate(drbg, drbg->pool, blocks);
+    if unlikely (!ok) {
         return false;
     }
+    STATS_INC(drbg_refills);
+    STATS_ADD(drbg_blocks, blocks);
+
+    drbg->len = blocks;
+    drbg->pos = 0;
+    // grow the window for long streams, up to the pool size
+    drbg->window = likely(blocks <= DRBG_POOL_BLOCKS / 2) ? (uint8_t) (2 * blocks) : DRBG_POOL_BLOCKS;
+    return true;
+}
+
+/**
+ * Generate the next 128-bit block of the DRBG sequence.
+ */
+bool drbg_rand(drbg_ctr128_t *NONNULL drbg, uint128_t *NONNULL output) {
+    if unlikely (drbg->pos >= drbg->len) {
+        const bool ok = drbg_refill(drbg);
+        if unlikely (!ok) {
+            return false;
+        }
+    }
+
+    *output = drbg->pool[drbg->pos++];
+    drbg->ctr++;
     return true;
 }
 
@@ -199,5 +246,6 @@ bool drbg_rand_threshold(drbg_ctr128_t *NONNULL drbg, uint128_t *NONNULL output,
             *output = value;
             return true;
         }
+        STATS_INC(drbg_rejections);
     }
 }
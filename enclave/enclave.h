@@ -1,10 +1,14 @@
 #ifndef ENCLAVE_H
 #define ENCLAVE_H
 
+#include <pthread.h>
 #include <stdint.h>
 #include <string.h>
 
+#include "./stats.h"
 #include "defines.h"
+#include "drbg.h"
+#include "enclave_config.h"
 
 /** Challenge output separator. */
 #define SEPARATOR "------------------------------------------------"
@@ -25,52 +29,130 @@
  */
 int printf(const char *NONNULL fmt, ...);
 
+/**
+ * A value initialized once per enclave lifetime, on first use. Failed initializations are retried on the next use.
+ */
+typedef struct lazy {
+    /** Serializes initialization. */
+    pthread_mutex_t lock;
+    /** Set with release semantics after the value is written. */
+    bool ready;
+} lazy_t;
+
+/** Static initializer for `lazy_t`. */
+#define LAZY_INITIALIZER {.lock = PTHREAD_MUTEX_INITIALIZER, .ready = false}
+
+/** Initialization function for a `lazy_t` value. Returns `false` on errors. */
+typedef bool lazy_init_fn(void *NONNULL value);
+
+[[nodiscard("error must be checked"), gnu::nonnull(1, 2, 3), gnu::cold, gnu::noinline, gnu::nothrow]]
+/**
+ * Slow path of `lazy_get`: initialize `value` with `init` under the lock, unless another thread already did.
+ */
+bool lazy_init(lazy_t *NONNULL lazy, lazy_init_fn *NONNULL init, void *NONNULL value);
+
+[[nodiscard("error must be checked"), gnu::nonnull(1, 2, 3), gnu::always_inline, gnu::hot, gnu::nothrow]]
+/**
+ * Ensure `value` was initialized by `init`, running it on first use. After that, only a single acquire load.
+ *
+ * @return `true` if `value` is ready to be read, or `false` if initialization failed.
+ */
+static inline bool lazy_get(lazy_t *NONNULL lazy, lazy_init_fn *NONNULL init, void *NONNULL value) {
+    // pairs with the release store in `lazy_init`
+    if likely (__atomic_load_n(&(lazy->ready), __ATOMIC_ACQUIRE)) {
+        return true;
+    }
+    return lazy_init(lazy, init, value);
+}
+
 /** Unsigned 128-bit number. GCC and Clang extensions. */
 typedef __uint128_t uint128_t;
 
 /** Maximum value for `uint128_t`. */
 static constexpr uint128_t UINT128_MAX = (uint128_t) -1;
 
+/** Number of round keys in the AES-128 key schedule. */
+#define DRBG_SCHEDULE_BLOCKS 11
+
 /**
  * Deterministic Random Bit Generator (DRBG).
  *
+ * AES blocks are generated `DRBG_POOL_BLOCKS` at a time and handed out one by one. The refill window starts at a
+ * single block after each (re)keying and doubles on every refill, so short lived streams don't waste AES calls.
+ * Blocks are generated by one of the `drbg_backend_id_t` implementations, picked by the `drbg_backend` option.
+ *
  * Note: this implementation is not thread-safe.
  */
 typedef struct drbg_ctr128 {
     /** 128-bit seed + stream selector */
     uint128_t key;
-    /** 128-bit block counter */
+    /** 128-bit block counter, for the next block handed out */
     uint128_t ctr;
+    /** Pre-generated keystream, starting at block `ctr - pos`. */
+    uint128_t pool[DRBG_POOL_BLOCKS];
+    /** Expanded AES key, for backends that keep one. */
+    uint128_t schedule[DRBG_SCHEDULE_BLOCKS];
+    /** Number of valid blocks in `pool`. */
+    uint8_t len;
+    /** Index of the next unused block in `pool`. */
+    uint8_t pos;
+    /** Number of blocks generated on the next refill. */
+    uint8_t window;
+    /** Implementation used for refills. */
+    drbg_backend_id_t backend;
 } drbg_ctr128_t;
 
-[[nodiscard("pure function"), gnu::const, gnu::hot, gnu::nothrow]]
+static_assert(0 < DRBG_POOL_BLOCKS && DRBG_POOL_BLOCKS <= UINT8_MAX / 2);
+
+[[nodiscard("useless call"), gnu::hot, gnu::nothrow]]
 /**
  * Initialize the PRNG using the seed file. The `stream` selector allows picking a different generated stream.
  *
  * Note: each different PRNG should use a unique stream selector, since the seed is the same.
  *
  * Note: although the seed may be random, it won't change for the lifetime of the program, so the output won't be
- *   affected by another state and it doesn't leave any observable side-effect (besides logs in DEBUG builds).
+ *   affected by another state. It's not `gnu::const`, though: each call updates the `seed_reads` and `lazy_locks`
+ *   performance counters, and logs in DEBUG builds.
  */
 drbg_ctr128_t drbg_seeded_init(uint64_t stream);
 
-[[nodiscard("pure function"), gnu::const, gnu::hot, gnu::nothrow]]
+[[nodiscard("useless call"), gnu::nothrow]]
+/**
+ * Same as `drbg_seeded_init`, but using a specific `backend` instead of the configured one.
+ */
+drbg_ctr128_t drbg_seeded_init_backend(uint64_t stream, drbg_backend_id_t backend);
+
+[[gnu::nonnull(1), gnu::hot, gnu::nothrow]]
+/**
+ * Discard buffered blocks and update backend state after a change to `drbg->key`.
+ */
+void drbg_rekey(drbg_ctr128_t *NONNULL drbg);
+
+[[gnu::nonnull(1), gnu::hot, gnu::nothrow]]
 /**
- * Replace the `stream` selector for the PRNG.
+ * Replace the `stream` selector for the PRNG. The block counter is kept, but buffered blocks are discarded.
  *
  * Note: take care of keeping the stream selector unique throught the enclave.
  */
-static inline drbg_ctr128_t drbg_set_stream(drbg_ctr128_t drbg, const uint64_t stream) {
+static inline void drbg_set_stream(drbg_ctr128_t *NONNULL drbg, const uint64_t stream) {
     uint64_t key[2] = {0, 0};
-    static_assert(sizeof(key) == sizeof(drbg.key));
+    static_assert(sizeof(key) == sizeof(drbg->key));
 
-    memcpy(key, &(drbg.key), sizeof(drbg.key));
+    memcpy(key, &(drbg->key), sizeof(drbg->key));
     key[1] = stream;
-    memcpy(&(drbg.key), key, sizeof(drbg.key));
+    memcpy(&(drbg->key), key, sizeof(drbg->key));
 
-    return drbg;
+    drbg_rekey(drbg);
 }
 
+[[nodiscard("error must be checked"), gnu::nonnull(1, 2), gnu::hot, gnu::nothrow, gnu::leaf]]
+/**
+ * Generate the next 128-bit block of the DRBG sequence.
+ *
+ * @return `true` on success, or `false` if AES CTR failed.
+ */
+bool drbg_rand(drbg_ctr128_t *NONNULL drbg, uint128_t *NONNULL output);
+
 [[nodiscard("error must be checked"), gnu::nonnull(1, 2), gnu::hot, gnu::nothrow, gnu::leaf]]
 /**
  * Pick a pseudo-random number from the DRBG sequence if it's in the `[0,threshold)` range.
@@ -79,24 +161,215 @@ static inline drbg_ctr128_t drbg_set_stream(drbg_ctr128_t drbg, const uint64_t s
  */
 bool drbg_rand_threshold(drbg_ctr128_t *NONNULL drbg, uint128_t *NONNULL output, uint128_t threshold);
 
-[[nodiscard("error must be checked"), gnu::nonnull(1, 2), gnu::hot, gnu::nothrow]]
 /**
- * Generate a pseudo-random number in the range `[0,bound)` from the DRBG sequence.
+ * Precomputed constants for sampling in `[0,bound)`.
+ */
+typedef struct drbg_bound {
+    /** Exclusive upper limit of the samples. */
+    uint128_t bound;
+    /** Largest multiple of `bound` in 128 bits, the rejection threshold for `DRBG_SAMPLING_COMPAT`. */
+    uint128_t threshold;
+    /** `2^64 % bound`, for bounds that fit in 64 bits. Otherwise, zero. */
+    uint64_t wrap;
+} drbg_bound_t;
+
+[[nodiscard("pure function"), gnu::const, gnu::always_inline, gnu::nothrow]]
+/**
+ * Precompute the sampling constants for `bound`. Folded at compile time when `bound` is a constant.
+ */
+static inline drbg_bound_t drbg_bound(const uint128_t bound) {
+    assume(bound != 0);
+    const bool narrow = bound <= UINT64_MAX;
+
+    return (drbg_bound_t) {
+        .bound = bound,
+        .threshold = UINT128_MAX - UINT128_MAX % bound,
+        .wrap = likely(narrow) ? (-(uint64_t) bound) % (uint64_t) bound : 0,
+    };
+}
+
+[[nodiscard("pure function"), gnu::pure, gnu::always_inline, gnu::nothrow]]
+/**
+ * Same as `value % bound->bound`, but without 128-bit divisions for bounds up to `2^32`.
+ *
+ * Splitting `value = hi * 2^64 + lo`, the result is `((hi % bound) * (2^64 % bound) + lo % bound) % bound`, where
+ * every intermediate value fits in 64 bits and each `%` by a constant becomes a multiplication.
+ */
+static inline uint128_t drbg_reduce(const uint128_t value, const drbg_bound_t *NONNULL bound) {
+    if unlikely (bound->bound > (UINT64_C(1) << 32)) {
+        return value % bound->bound;
+    }
+
+    const uint64_t b = (uint64_t) bound->bound;
+    const uint64_t hi = (uint64_t) (value >> 64);
+    const uint64_t lo = (uint64_t) value;
+    return ((hi % b) * bound->wrap + lo % b) % b;
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(1, 2, 3), gnu::always_inline, gnu::hot, gnu::nothrow]]
+/**
+ * Generate a pseudo-random number in the range `[0,bound->bound)` from the DRBG sequence.
+ *
+ * With `DRBG_SAMPLING_COMPAT`, the output is the same as `value % bound` for the first block below the threshold.
+ * With `DRBG_SAMPLING_LEMIRE`, 64-bit bounds use the multiply-shift reduction on the lower half of each block, which
+ * rejects `l < 2^64 % bound` to stay exactly uniform.
  *
  * @return `true` on success, or `false` if AES CTR failed.
  */
-static inline bool drbg_rand_bounded(drbg_ctr128_t *NONNULL drbg, uint128_t *NONNULL output, uint128_t bound) {
-    assume(bound != 0);
-    // this function is inlined so that the threshold can be constant folded,
-    // since `bound` is always a constant in out code
-    const uint128_t threshold = UINT128_MAX - UINT128_MAX % bound;
+static inline bool drbg_rand_bound(
+    drbg_ctr128_t *NONNULL drbg,
+    uint128_t *NONNULL output,
+    const drbg_bound_t *NONNULL bound
+) {
+#if DRBG_SAMPLING == DRBG_SAMPLING_LEMIRE
+    if likely (bound->bound <= UINT64_MAX) {
+        const uint64_t b = (uint64_t) bound->bound;
+        while (true) {
+            uint128_t value = UINT128_MAX;
+            const bool ok = drbg_rand(drbg, &value);
+            if unlikely (!ok) {
+                return false;
+            }
+
+            const uint128_t product = (uint128_t) (uint64_t) value * b;
+            if likely ((uint64_t) product >= bound->wrap) {
+                *output = product >> 64;
+                return true;
+            }
+            STATS_INC(drbg_rejections);
+        }
+    }
+#endif
 
     uint128_t value = UINT128_MAX;
-    const bool ok = drbg_rand_threshold(drbg, &value, threshold);
+    const bool ok = drbg_rand_threshold(drbg, &value, bound->threshold);
     if likely (ok) {
-        *output = value % bound;
+        *output = drbg_reduce(value, bound);
     }
     return ok;
 }
 
+[[nodiscard("error must be checked"), gnu::nonnull(1, 2), gnu::always_inline, gnu::hot, gnu::nothrow]]
+/**
+ * Generate a pseudo-random number in the range `[0,bound)` from the DRBG sequence.
+ *
+ * @return `true` on success, or `false` if AES CTR failed.
+ */
+static inline bool drbg_rand_bounded(drbg_ctr128_t *NONNULL drbg, uint128_t *NONNULL output, const uint128_t bound) {
+    // this function is inlined so that the constants can be folded,
+    // since `bound` is always a constant in out code
+    const drbg_bound_t constants = drbg_bound(bound);
+    return drbg_rand_bound(drbg, output, &constants);
+}
+
+/** Each 64-bit half of a block holds `k` digits, with `base^k <= 2^DRBG_DIGITS_BITS`. */
+#define DRBG_DIGITS_BITS 60
+
+/**
+ * Stream of uniformly distributed digits in `[0,base)`, extracted from DRBG blocks.
+ *
+ * Each 64-bit half of a block is used only if it's below the largest multiple of `base^k` that fits in 64 bits, and
+ * then split into `k` digits, the largest `k` with `base^k <= 2^60`. So less than 1/16 of the halves are rejected, and
+ * a block gives 74 digits in `[0,3)` or 24 digits in `[0,26)`.
+ *
+ * Note: buffered digits come from the current key, so the stream must be reinitialized after `drbg_set_stream`.
+ */
+typedef struct drbg_digits {
+    /** Digits left from the current half, least significant first. */
+    uint64_t value;
+    /** Upper half of the last block, if not used yet. */
+    uint64_t pending;
+    /** Largest accepted half: `floor(2^64 / base^k) * base^k - 1`. */
+    uint64_t max;
+    /** Exclusive upper limit for each digit. */
+    uint8_t base;
+    /** Digits per accepted half (`k`). */
+    uint8_t per_half;
+    /** Number of digits left in `value`. */
+    uint8_t count;
+    /** If `pending` holds an unused half. */
+    bool has_pending;
+} drbg_digits_t;
+
+[[nodiscard("pure function"), gnu::const, gnu::always_inline, gnu::nothrow]]
+/**
+ * Initialize an empty digit stream for `base`. Folded at compile time when `base` is a constant.
+ */
+static inline drbg_digits_t drbg_digits_init(const uint8_t base) {
+    assume(base >= 2);
+
+    uint64_t power = 1;
+    uint8_t per_half = 0;
+    while (power <= (UINT64_C(1) << DRBG_DIGITS_BITS) / base) {
+        power *= base;
+        per_half++;
+    }
+
+    return (drbg_digits_t) {
+        .value = 0,
+        .pending = 0,
+        .max = UINT64_MAX - (UINT64_MAX % power + 1) % power,
+        .base = base,
+        .per_half = per_half,
+        .count = 0,
+        .has_pending = false,
+    };
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(1, 2), gnu::nothrow]]
+/**
+ * Load the next accepted 64-bit half into `digits`, generating a new block when needed.
+ *
+ * @return `true` on success, or `false` if AES CTR failed.
+ */
+static inline bool drbg_digits_refill(drbg_ctr128_t *NONNULL drbg, drbg_digits_t *NONNULL digits) {
+    while (true) {
+        uint64_t half = UINT64_MAX;
+        if (digits->has_pending) {
+            half = digits->pending;
+            digits->has_pending = false;
+        } else {
+            uint128_t block = UINT128_MAX;
+            const bool ok = drbg_rand(drbg, &block);
+            if unlikely (!ok) {
+                return false;
+            }
+            half = (uint64_t) block;
+            digits->pending = (uint64_t) (block >> 64);
+            digits->has_pending = true;
+        }
+
+        if likely (half <= digits->max) {
+            digits->value = half;
+            digits->count = digits->per_half;
+            return true;
+        }
+        STATS_INC(drbg_rejections);
+    }
+}
+
+[[nodiscard("error must be checked"), gnu::nonnull(1, 2, 3), gnu::always_inline, gnu::hot, gnu::nothrow]]
+/**
+ * Generate a pseudo-random digit in `[0,digits->base)`, using a new block only when the buffered ones run out.
+ *
+ * @return `true` on success, or `false` if AES CTR failed.
+ */
+static inline bool drbg_rand_digit(
+    drbg_ctr128_t *NONNULL drbg,
+    drbg_digits_t *NONNULL digits,
+    uint8_t *NONNULL output
+) {
+    if unlikely (digits->count == 0) {
+        const bool ok = drbg_digits_refill(drbg, digits);
+        if unlikely (!ok) {
+            return false;
+        }
+    }
+
+    *output = (uint8_t) (digits->value % digits->base);
+    digits->value /= digits->base;
+    digits->count--;
+    return true;
+}
+
 #endif /* ENCLAVE_H */
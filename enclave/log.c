@@ -0,0 +1,114 @@
+#include <sgx_error.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "./log.h"
+#include "./stats.h"
+#include "defines.h"
+#include "enclave_config.h"
+#include "enclave_t.h"
+#include "log_format.h"
+
+static_assert(LOG_BUFFER_SIZE >= LOG_RECORD_MAX, "log buffer must fit the largest record");
+static_assert(LOG_RECORD_MAX <= UINT16_MAX, "record size must fit the header");
+
+/**
+ * Records of the current thread not yet sent to the app. Each TCS has its own buffer, so no locking is needed.
+ */
+static thread_local struct {
+    /** Bytes used in `data`. */
+    size_t used;
+    /** Packed records. */
+    uint8_t data[LOG_BUFFER_SIZE];
+} buffer = {0};
+
+[[nodiscard("pure function"), gnu::pure, gnu::nothrow]]
+/**
+ * Length of a string argument, after truncation. NULL is written as an empty string.
+ */
+static uint16_t string_length(const char *NULLABLE str) {
+    if unlikely (str == NULL) {
+        return 0;
+    }
+    return (uint16_t) strnlen(str, LOG_STRING_MAX);
+}
+
+[[nodiscard("pure function"), gnu::pure, gnu::nonnull(1), gnu::nothrow]]
+/**
+ * Number of bytes used by `args` in a record, including the header.
+ */
+static size_t record_size(const log_arg_t args[NONNULL]) {
+    size_t size = sizeof(log_record_header_t);
+    for (size_t i = 0; i < LOG_ARGS_MAX && args[i].kind != 0; i++) {
+        size += sizeof(log_arg_kind_t);
+        if (args[i].kind == LOG_ARG_STRING) {
+            size += sizeof(uint16_t) + string_length(args[i].s);
+        } else {
+            size += sizeof(uint64_t);
+        }
+    }
+    return size;
+}
+
+[[gnu::nonnull(1, 2), gnu::always_inline, gnu::nothrow]]
+/**
+ * Copy `size` bytes from `src` to `*dest`, and advance it.
+ */
+static inline void append(uint8_t *NONNULL *NONNULL dest, const void *NONNULL src, const size_t size) {
+    memcpy(*dest, src, size);
+    *dest += size;
+}
+
+/**
+ * Append a record for `format` with `args` to the thread log buffer.
+ */
+void log_record(const log_format_id_t format, const log_arg_t args[NONNULL]) {
+    const size_t size = record_size(args);
+    if unlikely (buffer.used + size > LOG_BUFFER_SIZE) {
+        (void) log_flush();
+    }
+
+    uint8_t *NONNULL pos = &(buffer.data[buffer.used]);
+    const log_record_header_t header = {.format = format, .size = (uint16_t) size};
+    append(&pos, &header, sizeof(header));
+
+    for (size_t i = 0; i < LOG_ARGS_MAX && args[i].kind != 0; i++) {
+        append(&pos, &(args[i].kind), sizeof(log_arg_kind_t));
+        if (args[i].kind == LOG_ARG_STRING) {
+            const uint16_t length = string_length(args[i].s);
+            append(&pos, &length, sizeof(length));
+            if likely (length > 0) {
+                append(&pos, args[i].s, length);
+            }
+        } else {
+            // all numeric kinds share the same 8 bytes
+            append(&pos, &(args[i].u), sizeof(uint64_t));
+        }
+    }
+
+    buffer.used += size;
+}
+
+/**
+ * Send all records in the thread log buffer to the app.
+ */
+bool log_flush(void) {
+    if likely (buffer.used == 0) {
+        return true;
+    }
+
+    STATS_INC(ocalls);
+    STATS_INC(log_flushes);
+    const sgx_status_t status = ocall_log_flush(buffer.data, buffer.used);
+    buffer.used = 0;
+    return status == SGX_SUCCESS;
+}
+
+/**
+ * Flush the thread log buffer at the end of a `LOG_FLUSH_ON_RETURN` scope.
+ */
+void log_flush_scope(const int *NONNULL scope) {
+    (void) scope;
+    (void) log_flush();
+}
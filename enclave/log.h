@@ -0,0 +1,116 @@
+#ifndef ENCLAVE_LOG_H
+/** Deferred binary logging for the enclave. */
+#define ENCLAVE_LOG_H
+
+#include <stdint.h>
+
+#include "defines.h"
+#include "log_format.h"
+
+/**
+ * An argument for a log record, tagged by its kind.
+ */
+typedef struct log_arg {
+    /** Type of the value, or zero for the end of the list. */
+    log_arg_kind_t kind;
+    union {
+        /** `LOG_ARG_INT` value. */
+        int64_t i;
+        /** `LOG_ARG_UINT` value. */
+        uint64_t u;
+        /** `LOG_ARG_DOUBLE` value. */
+        double d;
+        /** `LOG_ARG_STRING` value. Copied into the record. */
+        const char *NULLABLE s;
+    };
+} log_arg_t;
+
+[[nodiscard("pure function"), gnu::const, gnu::always_inline]]
+/** Log argument for a signed integer. */
+static inline log_arg_t log_arg_int(const int64_t value) {
+    return (log_arg_t) {.kind = LOG_ARG_INT, .i = value};
+}
+
+[[nodiscard("pure function"), gnu::const, gnu::always_inline]]
+/** Log argument for an unsigned integer. */
+static inline log_arg_t log_arg_uint(const uint64_t value) {
+    return (log_arg_t) {.kind = LOG_ARG_UINT, .u = value};
+}
+
+[[nodiscard("pure function"), gnu::const, gnu::always_inline]]
+/** Log argument for a floating point number. */
+static inline log_arg_t log_arg_double(const double value) {
+    return (log_arg_t) {.kind = LOG_ARG_DOUBLE, .d = value};
+}
+
+[[nodiscard("pure function"), gnu::const, gnu::always_inline]]
+/** Log argument for a string, which is only read when the record is written. */
+static inline log_arg_t log_arg_string(const char *NULLABLE value) {
+    return (log_arg_t) {.kind = LOG_ARG_STRING, .s = value};
+}
+
+/** Tagged log argument for any number or string `value`. */
+#define LOG_ARG(value)                    \
+    _Generic((value),                     \
+        bool: log_arg_uint,               \
+        char: log_arg_int,                \
+        signed char: log_arg_int,         \
+        short: log_arg_int,               \
+        int: log_arg_int,                 \
+        long: log_arg_int,                \
+        long long: log_arg_int,           \
+        unsigned char: log_arg_uint,      \
+        unsigned short: log_arg_uint,     \
+        unsigned int: log_arg_uint,       \
+        unsigned long: log_arg_uint,      \
+        unsigned long long: log_arg_uint, \
+        float: log_arg_double,            \
+        double: log_arg_double,           \
+        char *: log_arg_string,           \
+        const char *: log_arg_string)(value)
+
+// clang-format off
+/** Tagged arguments for up to `LOG_ARGS_MAX` values. */
+#define LOG_ARGS(...) LOG_ARGS_(__VA_ARGS__, LOG_ARGS_4, LOG_ARGS_3, LOG_ARGS_2, LOG_ARGS_1, )(__VA_ARGS__)
+#define LOG_ARGS_(_1, _2, _3, _4, N, ...) N
+#define LOG_ARGS_1(a) LOG_ARG(a)
+#define LOG_ARGS_2(a, b) LOG_ARG(a), LOG_ARG(b)
+#define LOG_ARGS_3(a, b, c) LOG_ARG(a), LOG_ARG(b), LOG_ARG(c)
+#define LOG_ARGS_4(a, b, c, d) LOG_ARG(a), LOG_ARG(b), LOG_ARG(c), LOG_ARG(d)
+// clang-format on
+
+/**
+ * Append a record for format `LOG_<name>` of `LOG_FORMATS` with the given arguments to the thread log buffer.
+ * Nothing is formatted in the enclave, and the buffer is only sent to the app when full or on `log_flush`.
+ */
+#define LOG(name, ...) \
+    log_record(LOG_##name, (const log_arg_t[]) {__VA_OPT__(LOG_ARGS(__VA_ARGS__), ) {.kind = 0}})
+
+[[gnu::nonnull(2), gnu::nothrow]]
+/**
+ * Append a record for `format` with `args`, terminated by an argument with kind zero, to the thread log buffer.
+ * Flushes the buffer first if the record doesn't fit. Use `LOG` instead.
+ */
+void log_record(log_format_id_t format, const log_arg_t args[NONNULL]);
+
+[[gnu::nothrow]]
+/**
+ * Send all records in the thread log buffer to the app, in a single OCALL.
+ *
+ * @return `false` if the OCALL failed. The records are dropped either way.
+ */
+bool log_flush(void);
+
+[[gnu::nonnull(1), gnu::nothrow]]
+/**
+ * Cleanup function for `LOG_FLUSH_ON_RETURN`.
+ */
+void log_flush_scope(const int *NONNULL scope);
+
+/**
+ * Flush the thread log buffer when the current scope exits. Used at the start of every ECALL, so the records reach
+ * the app before the ECALL returns.
+ */
+#define LOG_FLUSH_ON_RETURN [[gnu::cleanup(log_flush_scope), maybe_unused]] const int log_scope_ = 0
+
+#endif  // ENCLAVE_LOG_H
@@ -0,0 +1,127 @@
+#include <pthread.h>
+#include <sgx_thread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "./log.h"
+#include "./stats.h"
+#include "defines.h"
+#include "enclave_config.h"
+#include "enclave_stats.h"
+#include "enclave_t.h"
+
+#define STATS_CHECK_LAYOUT(name, description)                                             \
+    static_assert(offsetof(enclave_stats_t, name) == offsetof(stats_counters_t, name)); \
+    static_assert(sizeof(((enclave_stats_t *) NULL)->name) == sizeof(uint64_t));
+ENCLAVE_COUNTERS(STATS_CHECK_LAYOUT)
+#undef STATS_CHECK_LAYOUT
+
+/** Counters of each TCS. Only one thread runs on a TCS at a time, so each slot has a single writer. */
+static stats_counters_t slots[TCS_MAX_NUM] = {};
+/** TCS that owns each slot, from `sgx_thread_self`, or `0` if the slot is free. Slots are claimed in order. */
+static sgx_thread_t owners[TCS_MAX_NUM] = {};
+
+/**
+ * Counters of the current thread, found on first use. With the unbound TCS policy, the runtime resets the TLS on every
+ * root ECALL, so this only caches the slot during a single ECALL.
+ */
+thread_local stats_counters_t *NULLABLE stats_local = NULL;
+
+/**
+ * Sum of all counters at the last `ecall_reset_stats`, subtracted from the current sums. Counters are only written by
+ * their owner thread, so resetting doesn't touch them.
+ */
+static struct {
+    /** Serializes resets and reads of `counters`. */
+    pthread_mutex_t lock;
+    /** Sum of all slots at the last reset. */
+    stats_counters_t counters;
+} baseline = {.lock = PTHREAD_MUTEX_INITIALIZER, .counters = {}};
+
+/**
+ * Find the slot of the current TCS, claiming the next free one on its first ECALL.
+ */
+stats_counters_t *NONNULL stats_claim(void) {
+    const sgx_thread_t self = sgx_thread_self();
+
+    for (size_t i = 0; i < TCS_MAX_NUM; i++) {
+        sgx_thread_t owner = __atomic_load_n(&(owners[i]), __ATOMIC_ACQUIRE);
+        if (owner == 0) {
+            // on failure, `owner` is the TCS that claimed it first
+            if (__atomic_compare_exchange_n(&(owners[i]), &owner, self, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+                owner = self;
+            }
+        }
+        if (owner == self) {
+            stats_local = &(slots[i]);
+            return stats_local;
+        }
+    }
+
+    // never happens with at most `TCS_MAX_NUM` TCS, but counts are kept out of the sums
+    static thread_local stats_counters_t unregistered = {};
+    stats_local = &unregistered;
+    return stats_local;
+}
+
+[[gnu::nonnull(1), gnu::nothrow]]
+/**
+ * Sum the counters of all claimed slots into `output`.
+ */
+static void stats_sum(stats_counters_t *NONNULL output) {
+    *output = (stats_counters_t) {};
+
+    for (size_t i = 0; i < TCS_MAX_NUM; i++) {
+        if (__atomic_load_n(&(owners[i]), __ATOMIC_ACQUIRE) == 0) {
+            break;
+        }
+#define STATS_SUM_COUNTER(name, description) output->name += __atomic_load_n(&(slots[i].name), __ATOMIC_RELAXED);
+        ENCLAVE_COUNTERS(STATS_SUM_COUNTER)
+#undef STATS_SUM_COUNTER
+    }
+}
+
+[[nodiscard("error must be checked"), gnu::leaf, gnu::nothrow]]
+/**
+ * Sum of the counters of all threads, since the last reset.
+ *
+ * Returns 0 on success, or -1 if `stats` is null or the lock failed.
+ */
+int ecall_get_stats(enclave_stats_t *NULLABLE stats) {
+    LOG_FLUSH_ON_RETURN;
+
+    if unlikely (stats == NULL) {
+        return -1;
+    }
+
+    stats_counters_t current = {};
+    stats_sum(&current);
+
+    const int rv = pthread_mutex_lock(&(baseline.lock));
+    if unlikely (rv != 0) {
+        return -1;
+    }
+#define STATS_COPY_COUNTER(name, description) stats->name = current.name - baseline.counters.name;
+    ENCLAVE_COUNTERS(STATS_COPY_COUNTER)
+#undef STATS_COPY_COUNTER
+    (void) pthread_mutex_unlock(&(baseline.lock));
+    return 0;
+}
+
+[[gnu::leaf, gnu::nothrow]]
+/**
+ * Restart the counters of all threads from zero, by moving the baseline.
+ */
+void ecall_reset_stats(void) {
+    LOG_FLUSH_ON_RETURN;
+
+    stats_counters_t current = {};
+    stats_sum(&current);
+
+    const int rv = pthread_mutex_lock(&(baseline.lock));
+    if unlikely (rv != 0) {
+        return;
+    }
+    baseline.counters = current;
+    (void) pthread_mutex_unlock(&(baseline.lock));
+}
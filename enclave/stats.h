@@ -0,0 +1,55 @@
+#ifndef ENCLAVE_STATS_COUNTERS_H
+/** Per-thread performance counters for the enclave. */
+#define ENCLAVE_STATS_COUNTERS_H
+
+#include <stdint.h>
+
+#include "defines.h"
+#include "enclave_stats.h"
+
+/**
+ * Counters of a single TCS. Only the thread running on it writes to them, so increments don't need a locked
+ * instruction, and each TCS has its own cache line.
+ */
+typedef struct [[gnu::aligned(64)]] stats_counters {
+#define STATS_COUNTER_FIELD(name, description) uint64_t name;
+    ENCLAVE_COUNTERS(STATS_COUNTER_FIELD)
+#undef STATS_COUNTER_FIELD
+} stats_counters_t;
+
+/** Counters of the current thread, set on first use in each ECALL. */
+extern thread_local stats_counters_t *NULLABLE stats_local;
+
+[[nodiscard("useless call"), gnu::returns_nonnull, gnu::cold, gnu::noinline, gnu::nothrow]]
+/**
+ * Slow path of `stats_thread`: find the counters of the current TCS, which are kept across ECALLs.
+ */
+stats_counters_t *NONNULL stats_claim(void);
+
+[[nodiscard("useless call"), gnu::returns_nonnull, gnu::always_inline, gnu::hot, gnu::nothrow]]
+/**
+ * Counters of the current thread. After the first call in an ECALL, only a thread-local load.
+ */
+static inline stats_counters_t *NONNULL stats_thread(void) {
+    stats_counters_t *NULLABLE counters = stats_local;
+    if unlikely (counters == NULL) {
+        counters = stats_claim();
+    }
+    return counters;
+}
+
+/**
+ * Add `n` to `counter` of the current thread. The relaxed load and store are plain moves, but other threads still
+ * read a consistent value when summing the counters.
+ */
+#define STATS_ADD(counter, n)                                                                         \
+    do {                                                                                              \
+        stats_counters_t *NONNULL const stats_counters_ = stats_thread();                             \
+        const uint64_t stats_value_ = __atomic_load_n(&(stats_counters_->counter), __ATOMIC_RELAXED); \
+        __atomic_store_n(&(stats_counters_->counter), stats_value_ + (n), __ATOMIC_RELAXED);          \
+    } while (0)
+
+/** Increment `counter` of the current thread. */
+#define STATS_INC(counter) STATS_ADD(counter, 1)
+
+#endif  // ENCLAVE_STATS_COUNTERS_H
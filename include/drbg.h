@@ -0,0 +1,23 @@
+#ifndef DRBG_H
+/** DRBG definitions shared by the enclave and the benchmarks. */
+#define DRBG_H
+
+/**
+ * Implementations for the enclave DRBG. All of them generate the same stream.
+ */
+typedef enum [[gnu::packed]] drbg_backend_id {
+    /** Generic SGX SDK `sgx_aes_ctr_encrypt`, which expands the AES key on every call. */
+    DRBG_BACKEND_TCRYPTO = 0,
+    /** AES-NI instructions, with the key schedule expanded once per key. */
+    DRBG_BACKEND_AESNI = 1,
+} drbg_backend_id_t;
+
+/** Number of available DRBG backends. */
+#define DRBG_BACKENDS 2
+
+/** Bounded sampling with 128-bit rejection and modulo, reproducing the original sequences. */
+#define DRBG_SAMPLING_COMPAT 0
+/** Bounded sampling with Lemire's multiply-shift reduction. Faster, but generates different sequences. */
+#define DRBG_SAMPLING_LEMIRE 1
+
+#endif  // DRBG_H
@@ -0,0 +1,19 @@
+#ifndef ENCLAVE_STATS_H
+/** Enclave performance counters, shared by the enclave and the app. */
+#define ENCLAVE_STATS_H
+
+/**
+ * All counters of `enclave_stats_t`, in declaration order, with a description for reports.
+ *
+ * Must match `struct enclave_stats_t` in `enclave/stats.edl`.
+ */
+#define ENCLAVE_COUNTERS(X)                                               \
+    X(drbg_refills, "DRBG refills (AES backend calls)")                   \
+    X(drbg_blocks, "AES blocks generated by the DRBG")                    \
+    X(drbg_rejections, "DRBG samples rejected for a bounded value")       \
+    X(seed_reads, "reads of the DRBG seed")                               \
+    X(lazy_locks, "locks taken for lazy initialization, including seed")  \
+    X(ocalls, "OCALLs issued")                                            \
+    X(log_flushes, "OCALLs flushing log records")
+
+#endif  // ENCLAVE_STATS_H
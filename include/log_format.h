@@ -0,0 +1,91 @@
+#ifndef LOG_FORMAT_H
+/** Deferred log records, shared by the enclave and the app. */
+#define LOG_FORMAT_H
+
+#include <inttypes.h>  // IWYU pragma: keep
+#include <stdint.h>
+
+/**
+ * Format strings of all enclave log messages, as `X(NAME, "format")`. The enclave only stores the ID `LOG_NAME` and
+ * the raw arguments, and the app formats them with `printf` rules.
+ *
+ * Supported conversions are integers (`d`, `i`, `u`, `x`, `X`, `o`, `c`), floats (`f`, `e`, `g`, `a`) and strings
+ * (`s`), with any flags, width, precision or length modifier. `*` widths and `%n` are not supported.
+ */
+#define LOG_FORMATS(X)                                                                                             \
+    X(LAZY_LOCK_FAILED, "[DEBUG] lazy_init: failed to acquire lock: %d\n")                                         \
+    X(LAZY_UNLOCK_FAILED, "[DEBUG] lazy_init: failed to release lock: %d\n")                                       \
+    X(SEED_RAND_FAILED, "[DEBUG] drbg_seed: failed read rand: %04x\n")                                             \
+    X(SEED_GENERATED, "[DEBUG] drbg_seed: generated %016" PRIx64 "\n")                                             \
+    X(SEED_PREDEFINED, "[DEBUG] drbg_seed: predefined %016" PRIx64 "\n")                                           \
+    X(DRBG_RAND_FAILED, "[ENCLAVE] drbg_rand failed: status=0x%04x\n")                                             \
+    X(DRBG_MISMATCH, "[ENCLAVE] drbg check: %s mismatch, bound=%" PRIu64 ", stream=%" PRIx64 ", i=%" PRIu64 "\n")  \
+    X(WHITESPACE_STOP, "[DEBUG] skip_whitespace: stop reached\n")                                                  \
+    X(NAME_NOT_UPPERCASE, "[DEBUG] consume_name: does not start with uppercase letter, str=%s\n")                  \
+    X(NAME_STOP, "[DEBUG] consume_name: stop reached\n")                                                           \
+    X(NAME_SINGLE_LETTER, "[DEBUG] consume_name: single letter name, start=%s\n")                                  \
+    X(POSITION_NOTHING, "[DEBUG] name_matches_position: nothing to match at i=%zu: str=%s\n")                      \
+    X(POSITION_MISMATCH, "[DEBUG] name_matches_position: does not match i=%zu: expected=%s, str=%s\n")             \
+    X(POSITION_LENGTH, "[DEBUG] name_matches_position: length does not match i=%zu: longer than %zu\n")            \
+    X(MATCH_NULL, "[DEBUG] match_name: string is null\n")                                                          \
+    X(MATCH_TOO_LONG, "[DEBUG] match_name: string is too long\n")                                                  \
+    X(MATCH_UNMATCHED, "[DEBUG] match_name: unmatched content: str=%s\n")                                          \
+    X(MATCH_MISMATCH, "[DEBUG] match_name: does not match expected name: i=%zu, n=%zu\n")                          \
+    X(PASSWORD_FAILED, "[ENCLAVE] %s: failed to generate password\n")                                              \
+    X(PASSWORD_INVALID, "[DEBUG] ecall_verificar_senha: invalid password=%u\n")                                    \
+    X(PASSWORDS_INVALID, "[DEBUG] ecall_verificar_senhas: invalid input, n=%zu\n")                                 \
+    X(WORD_FAILED, "[ENCLAVE] %s: failed to generate secret word\n")                                               \
+    X(WORD_NULL, "[DEBUG] ecall_palavra_secreta: input is null\n")                                                 \
+    X(WORDS_INVALID, "[DEBUG] ecall_palavras_secretas: invalid input, k=%zu\n")                                    \
+    X(POLYNOMIAL_FAILED, "[DEBUG] %s: failed to generate coefficients\n")                                          \
+    X(POLYNOMIAL_INVALID_X, "[DEBUG] %s: invalid x=%d\n")                                                          \
+    X(POLYNOMIAL_INVALID_INPUT, "[DEBUG] %s: invalid input, n=%zu\n")                                              \
+    X(RPS_OCALL_FAILED, "[ENCLAVE] ocall_pedra_papel_tesoura failed: status=0x%04x\n")                             \
+    X(RPS_INVALID_ANSWER, "[DEBUG] ocall_pedra_papel_tesoura: invalid answer=%u\n")                                \
+    X(RPS_INVALID_INPUT, "[DEBUG] ecall_pedra_papel_tesoura_lote: invalid input, n=%zu\n")                         \
+    X(RPS_GAME_FAILED, "[DEBUG] ecall_pedra_papel_tesoura_lote: game %zu failed with %d\n")
+
+/** ID of each format string in `LOG_FORMATS`. */
+typedef enum [[gnu::packed]] log_format_id {
+#define LOG_FORMAT_ID(name, format) LOG_##name,
+    LOG_FORMATS(LOG_FORMAT_ID)
+#undef LOG_FORMAT_ID
+    /** Number of format strings. */
+    LOG_FORMAT_COUNT
+} log_format_id_t;
+
+/**
+ * Record header, followed by the arguments, in order. Records are packed without alignment.
+ */
+typedef struct [[gnu::packed]] log_record_header {
+    /** A `log_format_id_t`. */
+    uint16_t format;
+    /** Total record size in bytes, including this header. */
+    uint16_t size;
+} log_record_header_t;
+
+/**
+ * Type tag of each argument. Numbers are followed by 8 bytes in native endianness, and strings by an `uint16_t`
+ * length and the bytes, without the NUL terminator.
+ */
+typedef enum [[gnu::packed]] log_arg_kind {
+    /** Signed integer, sign-extended to `int64_t`. */
+    LOG_ARG_INT = 1,
+    /** Unsigned integer, zero-extended to `uint64_t`. */
+    LOG_ARG_UINT = 2,
+    /** Floating point, as `double`. */
+    LOG_ARG_DOUBLE = 3,
+    /** NUL-terminated string, truncated to `LOG_STRING_MAX` bytes. */
+    LOG_ARG_STRING = 4,
+} log_arg_kind_t;
+
+/** Maximum number of bytes kept for each string argument. */
+#define LOG_STRING_MAX 128
+
+/** Maximum number of arguments in a record. */
+#define LOG_ARGS_MAX 4
+
+/** Upper bound for the size of any record. */
+#define LOG_RECORD_MAX (sizeof(log_record_header_t) + LOG_ARGS_MAX * (1 + sizeof(uint16_t) + LOG_STRING_MAX))
+
+#endif  // LOG_FORMAT_H